@@ -0,0 +1,571 @@
+/*
+ * apex.c
+ * Contains the libapex library implementation
+ *
+ * A simulator is a configuration plus the APEX_CPU it is running. Loading
+ * a program resets the CPU and applies the configuration again, so every
+ * program starts from the same reset state without the simulator
+ * allocating a new CPU.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex.h"
+#include "apex_checkpoint.h"
+#include "apex_cpu.h"
+#include "apex_loop.h"
+
+struct APEX_Sim
+{
+    APEX_Config config;
+    APEX_CPU *cpu; /* CPU with no program until one is loaded */
+    int status;    /* APEX_* result of the last step */
+};
+
+struct APEX_Code
+{
+    APEX_Program program;
+    APEX_Decoded_Insn *decoded; /* Pre-decoded program.code */
+};
+
+/* Sets the timing model apex_sim runs without options */
+void
+apex_config_default(APEX_Config *config)
+{
+    config->forwarding = APEX_DEFAULT_FORWARDING;
+    config->predictor = BPRED_NONE;
+    config->btb_entries = BPRED_DEFAULT_BTB_ENTRIES;
+    config->bht_entries = BPRED_DEFAULT_BHT_ENTRIES;
+    config->branch_stage = STAGE_EXECUTE;
+    config->mul_latency = FU_DEFAULT_MUL_LATENCY;
+    config->div_latency = FU_DEFAULT_DIV_LATENCY;
+    APEX_cache_default_config(&config->dcache);
+    config->dcache.size = 0;
+    APEX_cache_default_config(&config->icache);
+    config->icache.size = 0;
+    config->mem_limit = MEM_ADDRESS_SPACE;
+    config->loop_accel = TRUE;
+    config->block_memo = TRUE;
+}
+
+/*
+ * Sets one timing model option, named as the apex_sim option that sets it
+ * (--forwarding, --predictor, --btb-entries, --bht-entries,
+ * --branch-resolve, --mul-latency, --div-latency, --dcache, --icache,
+ * --mem-limit, --loop-accel or --block-memo), from its command line
+ * value. Returns APEX_OK, APEX_ERR_OPTION for an unknown option or
+ * APEX_ERR_VALUE for a value it cannot take. Numbers are only range
+ * checked once the configuration is applied
+ */
+int
+apex_config_option(APEX_Config *config, const char *name, const char *value)
+{
+    if (strcmp(name, "--forwarding") == 0)
+    {
+        config->forwarding = scoreboard_forwarding_parse(value);
+        return config->forwarding < 0 ? APEX_ERR_VALUE : APEX_OK;
+    }
+    if (strcmp(name, "--predictor") == 0)
+    {
+        config->predictor = APEX_bpred_parse(value);
+        return config->predictor < 0 ? APEX_ERR_VALUE : APEX_OK;
+    }
+    if (strcmp(name, "--btb-entries") == 0)
+    {
+        config->btb_entries = atoi(value);
+        return APEX_OK;
+    }
+    if (strcmp(name, "--bht-entries") == 0)
+    {
+        config->bht_entries = atoi(value);
+        return APEX_OK;
+    }
+    if (strcmp(name, "--branch-resolve") == 0)
+    {
+        if (strcmp(value, "ex") == 0)
+        {
+            config->branch_stage = STAGE_EXECUTE;
+        }
+        else if (strcmp(value, "decode") == 0)
+        {
+            config->branch_stage = STAGE_DECODE;
+        }
+        else
+        {
+            return APEX_ERR_VALUE;
+        }
+        return APEX_OK;
+    }
+    if (strcmp(name, "--mul-latency") == 0)
+    {
+        config->mul_latency = atoi(value);
+        return APEX_OK;
+    }
+    if (strcmp(name, "--div-latency") == 0)
+    {
+        config->div_latency = atoi(value);
+        return APEX_OK;
+    }
+    if (strcmp(name, "--dcache") == 0)
+    {
+        config->dcache.size = CACHE_DEFAULT_SIZE;
+        return APEX_cache_parse(value, &config->dcache) ? APEX_OK : APEX_ERR_VALUE;
+    }
+    if (strcmp(name, "--icache") == 0)
+    {
+        config->icache.size = CACHE_DEFAULT_SIZE;
+        return APEX_cache_parse(value, &config->icache) ? APEX_OK : APEX_ERR_VALUE;
+    }
+    if (strcmp(name, "--mem-limit") == 0)
+    {
+        config->mem_limit = strtoull(value, NULL, 0);
+        if (config->mem_limit == 0 || config->mem_limit > MEM_ADDRESS_SPACE
+            || config->mem_limit % MEM_PAGE_WORDS)
+        {
+            return APEX_ERR_VALUE;
+        }
+        return APEX_OK;
+    }
+    if (strcmp(name, "--block-memo") == 0)
+    {
+        if (strcmp(value, "on") == 0)
+        {
+            config->block_memo = TRUE;
+        }
+        else if (strcmp(value, "off") == 0)
+        {
+            config->block_memo = FALSE;
+        }
+        else
+        {
+            return APEX_ERR_VALUE;
+        }
+        return APEX_OK;
+    }
+    if (strcmp(name, "--loop-accel") == 0)
+    {
+        if (strcmp(value, "on") == 0)
+        {
+            config->loop_accel = TRUE;
+        }
+        else if (strcmp(value, "off") == 0)
+        {
+            config->loop_accel = FALSE;
+        }
+        else
+        {
+            return APEX_ERR_VALUE;
+        }
+        return APEX_OK;
+    }
+
+    return APEX_ERR_OPTION;
+}
+
+/*
+ * Applies a timing model to a CPU, allocating the lines of its caches.
+ * Returns APEX_OK, APEX_ERR_NO_MEMORY, or the APEX_ERR_* of the first
+ * invalid setting
+ */
+int
+APEX_cpu_configure(APEX_CPU *cpu, const APEX_Config *config)
+{
+    cpu->forwarding = config->forwarding;
+    cpu->branch_stage = config->branch_stage;
+    if (!APEX_bpred_configure(&cpu->bpred, config->predictor,
+                              config->btb_entries, config->bht_entries))
+    {
+        return APEX_ERR_BPRED;
+    }
+    if (!APEX_fu_configure(&cpu->fu, config->mul_latency, config->div_latency))
+    {
+        return APEX_ERR_FU;
+    }
+    if (!APEX_cache_valid(&config->dcache))
+    {
+        return APEX_ERR_DCACHE;
+    }
+    if (!APEX_cache_valid(&config->icache))
+    {
+        return APEX_ERR_ICACHE;
+    }
+    if (!APEX_cache_configure(&cpu->dcache, &config->dcache)
+        || !APEX_cache_configure(&cpu->icache, &config->icache))
+    {
+        return APEX_ERR_NO_MEMORY;
+    }
+    if (!APEX_mem_set_limit(&cpu->data_memory, config->mem_limit))
+    {
+        return APEX_ERR_MEM_LIMIT;
+    }
+
+    /* Loops and blocks seen under another timing model take other cycles */
+    cpu->loop_accel = config->loop_accel && APEX_loop_supported(cpu);
+    cpu->block_memo = config->block_memo && APEX_loop_supported(cpu);
+    APEX_loop_reset(cpu);
+    return APEX_OK;
+}
+
+/* Creates a CPU with the simulator's timing model and no program */
+static int
+new_cpu(const APEX_Config *config, APEX_CPU **cpu)
+{
+    int err;
+
+    *cpu = APEX_cpu_create();
+    if (!*cpu)
+    {
+        return APEX_ERR_NO_MEMORY;
+    }
+
+    err = APEX_cpu_configure(*cpu, config);
+    if (err != APEX_OK)
+    {
+        APEX_cpu_free(*cpu);
+        *cpu = NULL;
+    }
+
+    return err;
+}
+
+/*
+ * Creates a simulator with no program loaded. Returns NULL if the
+ * configuration is invalid or memory runs out
+ */
+APEX_Sim *
+apex_create(const APEX_Config *config)
+{
+    APEX_Sim *sim = calloc(1, sizeof(*sim));
+
+    if (!sim)
+    {
+        return NULL;
+    }
+
+    sim->config = *config;
+    sim->status = APEX_NO_PROGRAM;
+    if (new_cpu(config, &sim->cpu) != APEX_OK)
+    {
+        free(sim);
+        return NULL;
+    }
+
+    return sim;
+}
+
+/* Drops the program and puts the CPU back in reset, with the simulator's
+ * configuration */
+static int
+reset_cpu(APEX_Sim *sim)
+{
+    sim->status = APEX_NO_PROGRAM;
+    APEX_cpu_reset(sim->cpu);
+    return APEX_cpu_configure(sim->cpu, &sim->config);
+}
+
+/*
+ * Replaces the configuration of a simulator and unloads its program, so
+ * the next program loaded runs with it. Returns APEX_OK, or the
+ * APEX_ERR_* of the first invalid setting
+ */
+int
+apex_set_config(APEX_Sim *sim, const APEX_Config *config)
+{
+    sim->config = *config;
+    return reset_cpu(sim);
+}
+
+/*
+ * Loads a program from memory, an .asm listing or an .apexbin image, and
+ * resets the simulator to run it: cycle 0, PC 4000, zeroed registers and
+ * counters, and data memory holding only the image's data. The buffer is
+ * not referenced once this returns. On an error the simulator is left
+ * with no program
+ */
+int
+apex_load_program(APEX_Sim *sim, const void *buf, size_t len)
+{
+    int err = reset_cpu(sim);
+
+    if (err != APEX_OK)
+    {
+        return err;
+    }
+
+    if (!APEX_program_load_buffer(buf, len, &sim->cpu->program))
+    {
+        return APEX_ERR_PROGRAM;
+    }
+
+    if (!APEX_cpu_load_program(sim->cpu))
+    {
+        reset_cpu(sim);
+        return APEX_ERR_NO_MEMORY;
+    }
+
+    sim->status = APEX_RUNNING;
+    return APEX_OK;
+}
+
+/* Parsed and pre-decoded program, or NULL if prog holds no valid one */
+static APEX_Code *
+new_code(APEX_Code *code, int loaded)
+{
+    if (!loaded)
+    {
+        free(code);
+        return NULL;
+    }
+
+    code->decoded = APEX_predecode(code->program.code, code->program.code_size);
+    if (!code->decoded)
+    {
+        apex_code_destroy(code);
+        return NULL;
+    }
+
+    return code;
+}
+
+/*
+ * Parses and pre-decodes a program held in memory, as apex_load_program
+ * takes it, once for any number of simulators to run. Returns NULL if it
+ * is not a valid program or memory runs out
+ */
+APEX_Code *
+apex_code_create(const void *buf, size_t len)
+{
+    APEX_Code *code = calloc(1, sizeof(*code));
+
+    if (!code)
+    {
+        return NULL;
+    }
+
+    return new_code(code, APEX_program_load_buffer(buf, len, &code->program));
+}
+
+/* As apex_code_create, from an .asm listing or .apexbin image file */
+APEX_Code *
+apex_code_load(const char *path)
+{
+    APEX_Code *code = calloc(1, sizeof(*code));
+
+    if (!code)
+    {
+        return NULL;
+    }
+
+    return new_code(code, APEX_program_load(path, &code->program));
+}
+
+/* Releases a program. No simulator may still be running it */
+void
+apex_code_destroy(APEX_Code *code)
+{
+    if (code)
+    {
+        APEX_program_unload(&code->program);
+        free(code->decoded);
+        free(code);
+    }
+}
+
+/*
+ * Resets the simulator to run a program from apex_code_create, as
+ * apex_load_program does. The program is only read, never copied, so
+ * simulators on any number of threads can run it at once
+ */
+int
+apex_load_code(APEX_Sim *sim, const APEX_Code *code)
+{
+    int err = reset_cpu(sim);
+
+    if (err != APEX_OK)
+    {
+        return err;
+    }
+
+    if (!APEX_cpu_share_program(sim->cpu, &code->program, code->decoded))
+    {
+        reset_cpu(sim);
+        return APEX_ERR_NO_MEMORY;
+    }
+
+    sim->status = APEX_RUNNING;
+    return APEX_OK;
+}
+
+/*
+ * Simulates at most cycles more cycles. Returns APEX_RUNNING if the budget
+ * ran out first, in which case the next call continues exactly where this
+ * one stopped, or why the program can run no further
+ */
+int
+apex_step(APEX_Sim *sim, int cycles)
+{
+    if (sim->status != APEX_RUNNING)
+    {
+        return sim->status;
+    }
+
+    switch (APEX_cpu_step(sim->cpu, cycles))
+    {
+    case STOP_BUDGET:
+        break;
+
+    case STOP_FAULT:
+        sim->status = APEX_FAULTED;
+        break;
+
+    default:
+        sim->status = APEX_HALTED;
+        break;
+    }
+
+    return sim->status;
+}
+
+/*
+ * Saves the complete state of the simulator, as apex_sim --checkpoint
+ * does, to path. Returns FALSE if there is no program or the file cannot
+ * be written
+ */
+int
+apex_checkpoint(const APEX_Sim *sim, const char *path)
+{
+    return sim->status != APEX_NO_PROGRAM && APEX_cpu_checkpoint(sim->cpu, path);
+}
+
+/*
+ * Restores a checkpoint taken from the program the simulator has loaded,
+ * then applies the simulator's configuration to it: caches it leaves
+ * unchanged stay warm, resized ones start empty, and the predictor keeps
+ * its tables. Returns
+ * FALSE, leaving the simulator as it was, if the checkpoint cannot be read
+ * or belongs to another program, or with no program if the configuration
+ * cannot be applied to it
+ */
+int
+apex_restore(APEX_Sim *sim, const char *path)
+{
+    if (sim->status == APEX_NO_PROGRAM || !APEX_cpu_restore(sim->cpu, path))
+    {
+        return FALSE;
+    }
+
+    if (APEX_cpu_configure(sim->cpu, &sim->config) != APEX_OK)
+    {
+        reset_cpu(sim);
+        return FALSE;
+    }
+    sim->status = sim->cpu->fault ? APEX_FAULTED : APEX_RUNNING;
+    return TRUE;
+}
+
+/* Releases a simulator and everything it holds */
+void
+apex_destroy(APEX_Sim *sim)
+{
+    if (sim)
+    {
+        APEX_cpu_free(sim->cpu);
+        free(sim);
+    }
+}
+
+/* Value of register reg, 0 for a register that does not exist */
+int
+apex_reg(const APEX_Sim *sim, int reg)
+{
+    return reg >= 0 && reg < REG_FILE_SIZE ? sim->cpu->regs[reg] : 0;
+}
+
+int
+apex_zero_flag(const APEX_Sim *sim)
+{
+    return sim->cpu->zero_flag;
+}
+
+int
+apex_pos_flag(const APEX_Sim *sim)
+{
+    return sim->cpu->pos_flag;
+}
+
+/* Address fetch reads next */
+int
+apex_pc(const APEX_Sim *sim)
+{
+    return sim->cpu->pc;
+}
+
+/* Cycles simulated since the program was loaded */
+int
+apex_cycles(const APEX_Sim *sim)
+{
+    return sim->cpu->clock;
+}
+
+/* Instructions retired since the program was loaded */
+int
+apex_instructions(const APEX_Sim *sim)
+{
+    return sim->cpu->insn_completed;
+}
+
+/*
+ * Reads the data word at addr into value. Returns FALSE, leaving value
+ * alone, if addr is beyond the memory limit
+ */
+int
+apex_read_mem(const APEX_Sim *sim, uint32_t addr, int32_t *value)
+{
+    const APEX_Memory *mem = &sim->cpu->data_memory;
+    const int32_t *words;
+
+    if (addr >= mem->limit)
+    {
+        return FALSE;
+    }
+
+    words = APEX_mem_page(mem, addr >> MEM_PAGE_BITS);
+    *value = words ? words[addr & (MEM_PAGE_WORDS - 1)] : 0;
+    return TRUE;
+}
+
+/*
+ * Writes value to the data word at addr, typically program input before
+ * the first step. Returns FALSE if addr is beyond the memory limit or
+ * memory runs out
+ */
+int
+apex_write_mem(APEX_Sim *sim, uint32_t addr, int32_t value)
+{
+    return APEX_mem_write(&sim->cpu->data_memory, addr, value);
+}
+
+/*
+ * Returns TRUE if the last step stopped on a memory fault, with the
+ * faulting address and the PC of the instruction that made the access. A
+ * fetch from outside code memory faults too, with that PC as both
+ */
+int
+apex_fault(const APEX_Sim *sim, uint32_t *addr, int *pc)
+{
+    if (!sim->cpu->fault)
+    {
+        return FALSE;
+    }
+
+    *addr = sim->cpu->fault_address;
+    *pc = sim->cpu->fault_pc;
+    return TRUE;
+}
+
+/* Performance counters of the run so far */
+const APEX_Counters *
+apex_counters(const APEX_Sim *sim)
+{
+    return &sim->cpu->counters;
+}
@@ -0,0 +1,106 @@
+/*
+ * apex.h
+ * Contains the libapex library interface
+ *
+ * libapex runs APEX simulations in-process. A simulator is created from a
+ * configuration, given a program held in memory (an .asm listing or an
+ * .apexbin image) and stepped a budget of cycles at a time; between steps
+ * the caller reads registers, memory and performance counters directly.
+ * Every simulator owns all of its state and the library keeps none of its
+ * own, so simulators on different threads never interfere. Nothing is
+ * printed: results and errors are returned to the caller.
+ *
+ *   APEX_Config config;
+ *   APEX_Sim *sim;
+ *
+ *   apex_config_default(&config);
+ *   sim = apex_create(&config);
+ *   apex_load_program(sim, text, strlen(text));
+ *   while (apex_step(sim, 10000) == APEX_RUNNING)
+ *       ;
+ *   printf("%d cycles, R1 = %d\n", apex_cycles(sim), apex_reg(sim, 1));
+ *   apex_destroy(sim);
+ *
+ * A program run many times, or by many simulators at once, can be parsed
+ * once with apex_code_create() and given to each with apex_load_code().
+ */
+#ifndef _APEX_H_
+#define _APEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "apex_bpred.h"
+#include "apex_cache.h"
+#include "apex_counters.h"
+#include "apex_fu.h"
+#include "apex_macros.h"
+
+/* Results of apex_load_program, and the invalid setting of a configuration */
+#define APEX_OK 0x0
+#define APEX_ERR_BPRED 0x1     /* BTB or BHT entries not powers of two within the limits */
+#define APEX_ERR_FU 0x2        /* MUL or DIV latency not 1 to FU_MAX_LATENCY cycles */
+#define APEX_ERR_DCACHE 0x3    /* Invalid D-cache geometry or latencies */
+#define APEX_ERR_ICACHE 0x4    /* Invalid I-cache geometry or latencies */
+#define APEX_ERR_MEM_LIMIT 0x5 /* Memory limit not a whole number of pages */
+#define APEX_ERR_PROGRAM 0x6   /* Program is not a valid listing or image, or names a register past R15 */
+#define APEX_ERR_NO_MEMORY 0x7 /* Host memory ran out */
+#define APEX_ERR_OPTION 0x8    /* apex_config_option: unknown option */
+#define APEX_ERR_VALUE 0x9     /* apex_config_option: invalid value */
+
+/* Results of apex_step */
+#define APEX_RUNNING 0x0    /* Cycle budget used up, the next step carries on */
+#define APEX_HALTED 0x1     /* HALT retired */
+#define APEX_FAULTED 0x2    /* A data access was beyond the memory limit, or a fetch outside code memory */
+#define APEX_NO_PROGRAM 0x3 /* No program loaded */
+
+/* Timing model of a simulator */
+typedef struct APEX_Config
+{
+    int forwarding;   /* FWD_* */
+    int predictor;    /* BPRED_* */
+    int btb_entries;
+    int bht_entries;
+    int branch_stage; /* STAGE_EXECUTE or STAGE_DECODE */
+    int mul_latency;
+    int div_latency;
+    APEX_Cache_Config dcache; /* size 0 for none */
+    APEX_Cache_Config icache; /* size 0 for none */
+    uint64_t mem_limit;       /* Data addresses from here up fault */
+    int loop_accel;           /* Extrapolate steady-state loops, same cycles either way */
+    int block_memo;           /* Replay the timing of blocks run before, likewise */
+} APEX_Config;
+
+/* A simulator, opaque to the caller */
+typedef struct APEX_Sim APEX_Sim;
+
+/* A parsed program that simulators share read-only, opaque to the caller */
+typedef struct APEX_Code APEX_Code;
+
+void apex_config_default(APEX_Config *config);
+int apex_config_option(APEX_Config *config, const char *name, const char *value);
+
+APEX_Sim *apex_create(const APEX_Config *config);
+int apex_set_config(APEX_Sim *sim, const APEX_Config *config);
+int apex_load_program(APEX_Sim *sim, const void *buf, size_t len);
+int apex_load_code(APEX_Sim *sim, const APEX_Code *code);
+int apex_step(APEX_Sim *sim, int cycles);
+int apex_checkpoint(const APEX_Sim *sim, const char *path);
+int apex_restore(APEX_Sim *sim, const char *path);
+void apex_destroy(APEX_Sim *sim);
+
+int apex_reg(const APEX_Sim *sim, int reg);
+int apex_zero_flag(const APEX_Sim *sim);
+int apex_pos_flag(const APEX_Sim *sim);
+int apex_pc(const APEX_Sim *sim);
+int apex_cycles(const APEX_Sim *sim);
+int apex_instructions(const APEX_Sim *sim);
+int apex_read_mem(const APEX_Sim *sim, uint32_t addr, int32_t *value);
+int apex_write_mem(APEX_Sim *sim, uint32_t addr, int32_t value);
+int apex_fault(const APEX_Sim *sim, uint32_t *addr, int *pc);
+const APEX_Counters *apex_counters(const APEX_Sim *sim);
+
+APEX_Code *apex_code_create(const void *buf, size_t len);
+APEX_Code *apex_code_load(const char *path);
+void apex_code_destroy(APEX_Code *code);
+#endif
@@ -0,0 +1,100 @@
+/*
+ * apex_asm.c
+ * Assembles an .asm listing into a .apexbin program image that apex_sim
+ * can map and run without parsing
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "apex_cpu.h"
+#include "apex_image.h"
+
+/* Reads a raw file of 32-bit data words into a newly allocated buffer */
+static int32_t *
+read_data_words(const char *filename, int *size)
+{
+    FILE *fp;
+    long len;
+    int32_t *data;
+
+    fp = fopen(filename, "rb");
+    if (!fp)
+    {
+        return NULL;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    rewind(fp);
+
+    *size = len / sizeof(int32_t);
+    data = calloc(*size ? *size : 1, sizeof(int32_t));
+    if (data && fread(data, sizeof(int32_t), *size, fp) != (size_t)*size)
+    {
+        free(data);
+        data = NULL;
+    }
+
+    fclose(fp);
+    return data;
+}
+
+int
+main(int argc, char const *argv[])
+{
+    APEX_Program prog;
+    int32_t *data = NULL;
+    uint32_t data_base = 0;
+    unsigned long long base;
+    char *end;
+    int data_size = 0, ok;
+
+    if (argc < 3 || argc > 5)
+    {
+        fprintf(stderr, "APEX_Help: Usage %s <input.asm> <output.apexbin> "
+                        "[<data_words_file> [<data_base_address>]]\n", argv[0]);
+        exit(1);
+    }
+
+    if (!APEX_program_load(argv[1], &prog))
+    {
+        fprintf(stderr, "APEX_Error: Unable to load %s\n", argv[1]);
+        exit(1);
+    }
+
+    if (argc >= 4)
+    {
+        data = read_data_words(argv[3], &data_size);
+        if (!data)
+        {
+            fprintf(stderr, "APEX_Error: Unable to read %s\n", argv[3]);
+            exit(1);
+        }
+        if (argc == 5)
+        {
+            /* Any address of the 32-bit data address space */
+            base = strtoull(argv[4], &end, 0);
+            if (*argv[4] == '-' || *end != '\0' || end == argv[4] || base > UINT32_MAX)
+            {
+                fprintf(stderr, "APEX_Error: Invalid data base address %s\n", argv[4]);
+                exit(1);
+            }
+            data_base = base;
+        }
+    }
+
+    ok = APEX_image_write(argv[2], prog.code, prog.code_size, data, data_base,
+                          data_size);
+    if (!ok)
+    {
+        fprintf(stderr, "APEX_Error: Unable to write %s\n", argv[2]);
+        exit(1);
+    }
+
+    printf("APEX_ASM: Wrote %d instructions and %d data words to %s\n",
+           prog.code_size, data_size, argv[2]);
+
+    free(data);
+    APEX_program_unload(&prog);
+    return 0;
+}
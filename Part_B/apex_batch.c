@@ -0,0 +1,482 @@
+/*
+ * apex_batch.c
+ * Runs a manifest of simulation jobs on a pool of threads
+ *
+ * Every line of the manifest is a job: a program, a cycle limit and any
+ * timing model options apex_sim takes, e.g.
+ *
+ *   # program      cycles  options
+ *   input.asm      1000    --forwarding full
+ *   input.asm      1000    --predictor gshare --dcache size=1024
+ *
+ * Each program is parsed once and shared read-only by every job that runs
+ * it. The jobs run on the work-stealing pool of apex_pool.h, each worker
+ * reusing one simulator from job to job. The results go to one CSV or JSON
+ * file in manifest order, whatever order the jobs finished in. A job whose
+ * program cannot be loaded or whose timing model is invalid is reported as
+ * an error row, and one that faults as a fault row, without stopping the
+ * others.
+ */
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex.h"
+#include "apex_pool.h"
+
+#define BATCH_MAX_LINE 1024
+
+/* A program the manifest names, loaded once */
+typedef struct Batch_Program
+{
+    char *path;
+    APEX_Code *code; /* NULL if it could not be loaded */
+} Batch_Program;
+
+/* One line of the manifest and, once it has run, its result */
+typedef struct Batch_Job
+{
+    int line;               /* Manifest line number */
+    int program;            /* Index in Batch.programs */
+    char *options;          /* Timing model options as written */
+    APEX_Config config;
+    int cycle_limit;
+    int status;             /* APEX_HALTED, APEX_RUNNING at the cycle limit, APEX_FAULTED, or -1 if it could not run */
+    int cycles;
+    int instructions;
+    APEX_Counters counters;
+} Batch_Job;
+
+typedef struct Batch
+{
+    Batch_Program *programs;
+    int program_count;
+    Batch_Job *jobs;
+    int job_count;
+} Batch;
+
+/* Counters written out for every job, by name */
+static const struct
+{
+    const char *name;
+    size_t offset;
+} counter_fields[] = {
+    {"data_stalls", offsetof(APEX_Counters, data_stalls)},
+    {"flag_stalls", offsetof(APEX_Counters, flag_stalls)},
+    {"fu_result_stalls", offsetof(APEX_Counters, fu_result_stalls)},
+    {"fu_busy_stalls", offsetof(APEX_Counters, fu_busy_stalls)},
+    {"dcache_stalls", offsetof(APEX_Counters, dcache_stalls)},
+    {"branch_flushes", offsetof(APEX_Counters, branch_flushes)},
+    {"fetch_bubbles", offsetof(APEX_Counters, fetch_bubbles)},
+    {"icache_stalls", offsetof(APEX_Counters, icache_stalls)},
+    {"halt_drain", offsetof(APEX_Counters, halt_drain)},
+    {"forwarded_operands", offsetof(APEX_Counters, forwarded_operands)},
+    {"branches", offsetof(APEX_Counters, branches)},
+    {"branches_taken", offsetof(APEX_Counters, branches_taken)},
+    {"mispredicts", offsetof(APEX_Counters, mispredicts)},
+};
+
+#define COUNTER_FIELDS (int)(sizeof(counter_fields) / sizeof(counter_fields[0]))
+
+static uint64_t
+counter_value(const APEX_Counters *counters, int field)
+{
+    return *(const uint64_t *)((const char *)counters + counter_fields[field].offset);
+}
+
+static const char *
+status_name(int status)
+{
+    switch (status)
+    {
+    case APEX_HALTED:
+        return "halted";
+
+    case APEX_RUNNING:
+        return "cycle_limit";
+
+    case APEX_FAULTED:
+        return "fault";
+
+    default:
+        return "error";
+    }
+}
+
+static void *
+xmalloc(size_t size)
+{
+    void *p = malloc(size);
+
+    if (!p)
+    {
+        fprintf(stderr, "APEX_Error: Out of memory\n");
+        exit(1);
+    }
+
+    return p;
+}
+
+static char *
+xstrdup(const char *s)
+{
+    return strcpy(xmalloc(strlen(s) + 1), s);
+}
+
+/* Returns the index of the program at path, loading it the first time;
+ * a program that does not load fails its jobs alone */
+static int
+find_program(Batch *batch, const char *path, int line)
+{
+    Batch_Program *prog;
+    int i;
+
+    for (i = 0; i < batch->program_count; ++i)
+    {
+        if (strcmp(batch->programs[i].path, path) == 0)
+        {
+            return i;
+        }
+    }
+
+    batch->programs = realloc(batch->programs,
+                              (batch->program_count + 1) * sizeof(Batch_Program));
+    if (!batch->programs)
+    {
+        fprintf(stderr, "APEX_Error: Out of memory\n");
+        exit(1);
+    }
+
+    prog = &batch->programs[batch->program_count++];
+    prog->path = xstrdup(path);
+    prog->code = apex_code_load(path);
+    if (!prog->code)
+    {
+        fprintf(stderr, "APEX_Error: Line %d: Unable to load program %s\n", line, path);
+    }
+
+    return batch->program_count - 1;
+}
+
+/*
+ * Reads the manifest, loading every program it names and checking every
+ * configuration, so a job that cannot run is reported before any runs
+ */
+static void
+read_manifest(Batch *batch, const char *path)
+{
+    char buf[BATCH_MAX_LINE], *tok, *name, *save, *options;
+    APEX_Config config;
+    APEX_Sim *check;
+    Batch_Job *job;
+    FILE *fp;
+    int line = 0, err;
+
+    fp = fopen(path, "r");
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open manifest %s\n", path);
+        exit(1);
+    }
+
+    apex_config_default(&config);
+    check = apex_create(&config);
+    if (!check)
+    {
+        fprintf(stderr, "APEX_Error: Out of memory\n");
+        exit(1);
+    }
+
+    while (fgets(buf, sizeof(buf), fp))
+    {
+        ++line;
+        /* The rest of a longer line would be read as another job */
+        if (!strchr(buf, '\n') && !feof(fp))
+        {
+            fprintf(stderr, "APEX_Error: Line %d: Longer than %d characters\n",
+                    line, BATCH_MAX_LINE - 2);
+            exit(1);
+        }
+        buf[strcspn(buf, "\r\n")] = '\0';
+        tok = buf + strspn(buf, " \t");
+        if (*tok == '\0' || *tok == '#')
+        {
+            continue;
+        }
+
+        batch->jobs = realloc(batch->jobs, (batch->job_count + 1) * sizeof(Batch_Job));
+        if (!batch->jobs)
+        {
+            fprintf(stderr, "APEX_Error: Out of memory\n");
+            exit(1);
+        }
+        job = &batch->jobs[batch->job_count++];
+        memset(job, 0, sizeof(*job));
+        job->line = line;
+        job->status = -1;
+        apex_config_default(&job->config);
+
+        /* Program and cycle limit, then the options as written */
+        name = strtok_r(tok, " \t", &save);
+        tok = strtok_r(NULL, " \t", &save);
+        if (!tok || (job->cycle_limit = atoi(tok)) <= 0)
+        {
+            fprintf(stderr, "APEX_Error: Line %d: Expected <program> <cycles> [options]\n", line);
+            exit(1);
+        }
+        options = save + strspn(save, " \t");
+        job->options = xstrdup(options);
+        job->program = find_program(batch, name, line);
+
+        for (tok = strtok_r(options, " \t", &save); tok;
+             tok = strtok_r(NULL, " \t", &save))
+        {
+            name = tok;
+            tok = strtok_r(NULL, " \t", &save);
+            err = tok ? apex_config_option(&job->config, name, tok) : APEX_ERR_OPTION;
+            if (err == APEX_ERR_OPTION)
+            {
+                fprintf(stderr, "APEX_Error: Line %d: Unknown option %s\n", line, name);
+                exit(1);
+            }
+            if (err == APEX_ERR_VALUE)
+            {
+                fprintf(stderr, "APEX_Error: Line %d: Invalid %s value %s\n", line, name, tok);
+                exit(1);
+            }
+        }
+
+        if (apex_set_config(check, &job->config) != APEX_OK)
+        {
+            fprintf(stderr, "APEX_Error: Line %d: Invalid timing model\n", line);
+        }
+    }
+
+    apex_destroy(check);
+    fclose(fp);
+}
+
+/* Runs one job to its cycle limit on the worker's simulator */
+static void
+run_job(APEX_Sim *sim, int index, void *arg)
+{
+    const Batch *batch = arg;
+    Batch_Job *job = &batch->jobs[index];
+    const APEX_Code *code = batch->programs[job->program].code;
+
+    if (!code || apex_set_config(sim, &job->config) != APEX_OK
+        || apex_load_code(sim, code) != APEX_OK)
+    {
+        return;
+    }
+
+    job->status = apex_step(sim, job->cycle_limit);
+    job->cycles = apex_cycles(sim);
+    job->instructions = apex_instructions(sim);
+    job->counters = *apex_counters(sim);
+}
+
+/* Writes s as a CSV field, quoted if it needs to be */
+static void
+write_csv_string(FILE *out, const char *s)
+{
+    if (!strpbrk(s, ",\"\n"))
+    {
+        fputs(s, out);
+        return;
+    }
+
+    fputc('"', out);
+    for (; *s; ++s)
+    {
+        if (*s == '"')
+        {
+            fputc('"', out);
+        }
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+/* Writes s as a JSON string */
+static void
+write_json_string(FILE *out, const char *s)
+{
+    fputc('"', out);
+    for (; *s; ++s)
+    {
+        if (*s == '"' || *s == '\\')
+        {
+            fputc('\\', out);
+            fputc(*s, out);
+        }
+        else if ((unsigned char)*s < 0x20)
+        {
+            fprintf(out, "\\u%04x", *s);
+        }
+        else
+        {
+            fputc(*s, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static double
+job_cpi(const Batch_Job *job)
+{
+    return job->instructions ? (double)job->cycles / job->instructions : 0.0;
+}
+
+static void
+write_csv(const Batch *batch, FILE *out)
+{
+    const Batch_Job *job;
+    int i, f;
+
+    fprintf(out, "line,program,options,cycle_limit,status,cycles,instructions,cpi");
+    for (f = 0; f < COUNTER_FIELDS; ++f)
+    {
+        fprintf(out, ",%s", counter_fields[f].name);
+    }
+    fputc('\n', out);
+
+    for (i = 0; i < batch->job_count; ++i)
+    {
+        job = &batch->jobs[i];
+        fprintf(out, "%d,", job->line);
+        write_csv_string(out, batch->programs[job->program].path);
+        fputc(',', out);
+        write_csv_string(out, job->options);
+        fprintf(out, ",%d,%s,%d,%d,%.4f", job->cycle_limit,
+                status_name(job->status), job->cycles, job->instructions,
+                job_cpi(job));
+        for (f = 0; f < COUNTER_FIELDS; ++f)
+        {
+            fprintf(out, ",%llu", (unsigned long long)counter_value(&job->counters, f));
+        }
+        fputc('\n', out);
+    }
+}
+
+static void
+write_json(const Batch *batch, FILE *out)
+{
+    const Batch_Job *job;
+    int i, f;
+
+    fprintf(out, "[\n");
+    for (i = 0; i < batch->job_count; ++i)
+    {
+        job = &batch->jobs[i];
+        fprintf(out, "  {\"line\": %d, \"program\": ", job->line);
+        write_json_string(out, batch->programs[job->program].path);
+        fprintf(out, ", \"options\": ");
+        write_json_string(out, job->options);
+        fprintf(out, ", \"cycle_limit\": %d, \"status\": \"%s\", \"cycles\": %d, "
+                     "\"instructions\": %d, \"cpi\": %.4f",
+                job->cycle_limit, status_name(job->status), job->cycles,
+                job->instructions, job_cpi(job));
+        for (f = 0; f < COUNTER_FIELDS; ++f)
+        {
+            fprintf(out, ", \"%s\": %llu", counter_fields[f].name,
+                    (unsigned long long)counter_value(&job->counters, f));
+        }
+        fprintf(out, "}%s\n", i + 1 < batch->job_count ? "," : "");
+    }
+    fprintf(out, "]\n");
+}
+
+int
+main(int argc, char const *argv[])
+{
+    const char *manifest = NULL, *out_path = NULL;
+    int threads = 0, json = FALSE, failed = 0, i;
+    Batch batch;
+    FILE *out;
+
+    for (i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            threads = atoi(argv[++i]);
+            if (threads < 1 || threads > POOL_MAX_THREADS)
+            {
+                fprintf(stderr, "APEX_Error: Threads must be 1 to %d\n", POOL_MAX_THREADS);
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            out_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--json") == 0)
+        {
+            json = TRUE;
+        }
+        else if (!manifest && argv[i][0] != '-')
+        {
+            manifest = argv[i];
+        }
+        else
+        {
+            manifest = NULL;
+            break;
+        }
+    }
+
+    if (!manifest)
+    {
+        fprintf(stderr, "APEX_Help: Usage %s <manifest> [-j <threads>] [-o <file>] [--json]\n",
+                argv[0]);
+        exit(1);
+    }
+
+    memset(&batch, 0, sizeof(batch));
+    read_manifest(&batch, manifest);
+
+    threads = APEX_pool_threads(threads, batch.job_count);
+    if (!APEX_pool_run(batch.job_count, threads, run_job, &batch))
+    {
+        fprintf(stderr, "APEX_Error: Unable to start worker threads or simulators\n");
+        exit(1);
+    }
+
+    out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out)
+    {
+        fprintf(stderr, "APEX_Error: Unable to create %s\n", out_path);
+        exit(1);
+    }
+    if (json)
+    {
+        write_json(&batch, out);
+    }
+    else
+    {
+        write_csv(&batch, out);
+    }
+    if (out != stdout && fclose(out) != 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to write %s\n", out_path);
+        exit(1);
+    }
+
+    for (i = 0; i < batch.job_count; ++i)
+    {
+        failed += batch.jobs[i].status < 0;
+        free(batch.jobs[i].options);
+    }
+    for (i = 0; i < batch.program_count; ++i)
+    {
+        apex_code_destroy(batch.programs[i].code);
+        free(batch.programs[i].path);
+    }
+    free(batch.jobs);
+    free(batch.programs);
+
+    fprintf(stderr, "APEX_Batch: %d jobs on %d threads, %d failed\n",
+            batch.job_count, threads, failed);
+    return failed ? 1 : 0;
+}
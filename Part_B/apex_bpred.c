@@ -0,0 +1,179 @@
+/*
+ * apex_bpred.c
+ * Contains APEX branch prediction unit implementation
+ */
+#include <string.h>
+
+#include "apex_bpred.h"
+#include "apex_macros.h"
+
+/* Option names of the predictors, indexed by BPRED_* */
+static const char *const bpred_names[BPRED_COUNT] = {
+    [BPRED_NONE] = "none",
+    [BPRED_STATIC] = "static",
+    [BPRED_BIMODAL] = "bimodal",
+    [BPRED_GSHARE] = "gshare",
+};
+
+/* Counter value from which a 2-bit counter predicts taken */
+#define BHT_TAKEN 2
+
+/* Returns TRUE if n is a power of two no larger than max */
+static int
+valid_table_size(int n, int max)
+{
+    return n > 0 && n <= max && (n & (n - 1)) == 0;
+}
+
+/* BTB slot of a branch PC */
+static inline int
+btb_index(const APEX_Bpred *bp, int pc)
+{
+    return (pc >> 2) & (bp->btb_entries - 1);
+}
+
+/* Direction counter of a branch PC */
+static inline int
+bht_index(const APEX_Bpred *bp, int pc)
+{
+    int index = pc >> 2;
+
+    if (bp->kind == BPRED_GSHARE)
+    {
+        index ^= bp->state.history;
+    }
+
+    return index & (bp->bht_entries - 1);
+}
+
+/* Empties the BTB and sets every counter to weakly not taken */
+void
+APEX_bpred_reset(APEX_Bpred *bp)
+{
+    memset(&bp->state, 0, sizeof(bp->state));
+    memset(bp->state.bht, BHT_TAKEN - 1, sizeof(bp->state.bht));
+}
+
+/*
+ * Selects the predictor and its table sizes, keeping whatever state the
+ * tables hold. Returns FALSE if a size is not a power of two within the
+ * table
+ */
+int
+APEX_bpred_configure(APEX_Bpred *bp, int kind, int btb_entries,
+                     int bht_entries)
+{
+    if (kind < 0 || kind >= BPRED_COUNT
+        || !valid_table_size(btb_entries, BPRED_MAX_BTB_ENTRIES)
+        || !valid_table_size(bht_entries, BPRED_MAX_BHT_ENTRIES))
+    {
+        return FALSE;
+    }
+
+    bp->kind = kind;
+    bp->btb_entries = btb_entries;
+    bp->bht_entries = bht_entries;
+    return TRUE;
+}
+
+/* Returns the PC fetch goes to after the instruction at pc */
+int
+APEX_bpred_predict(const APEX_Bpred *bp, int pc)
+{
+    const APEX_BTB_Entry *entry;
+    int taken;
+
+    entry = &bp->state.btb[btb_index(bp, pc)];
+    if (bp->kind == BPRED_NONE || entry->pc != pc)
+    {
+        return pc + 4;
+    }
+
+    if (!entry->conditional || bp->kind == BPRED_STATIC)
+    {
+        taken = !entry->conditional || entry->target <= pc;
+    }
+    else
+    {
+        taken = bp->state.bht[bht_index(bp, pc)] >= BHT_TAKEN;
+    }
+
+    return taken ? entry->target : pc + 4;
+}
+
+/*
+ * Trains the predictor with a control transfer resolved in EX. Only taken
+ * transfers allocate a BTB entry, since fetch falls through on a miss
+ * anyway
+ */
+void
+APEX_bpred_train(APEX_Bpred *bp, int pc, int conditional, int taken,
+                 int target)
+{
+    APEX_BTB_Entry *entry;
+    uint8_t *counter;
+
+    if (bp->kind == BPRED_NONE)
+    {
+        return;
+    }
+
+    if (conditional)
+    {
+        counter = &bp->state.bht[bht_index(bp, pc)];
+        if (taken && *counter < 3)
+        {
+            (*counter)++;
+            bp->version++;
+        }
+        else if (!taken && *counter > 0)
+        {
+            (*counter)--;
+            bp->version++;
+        }
+        bp->state.history = ((bp->state.history << 1) | taken)
+                            & (bp->bht_entries - 1);
+    }
+
+    if (taken)
+    {
+        entry = &bp->state.btb[btb_index(bp, pc)];
+        if (entry->pc != pc || entry->target != target
+            || entry->conditional != conditional)
+        {
+            entry->pc = pc;
+            entry->target = target;
+            entry->conditional = conditional;
+            bp->version++;
+        }
+    }
+}
+
+/* Returns the option name of a predictor */
+const char *
+APEX_bpred_name(int kind)
+{
+    if (kind < 0 || kind >= BPRED_COUNT)
+    {
+        return "???";
+    }
+
+    return bpred_names[kind];
+}
+
+/* Returns the predictor named by an option, or -1 if there is none */
+int
+APEX_bpred_parse(const char *name)
+{
+    int kind;
+
+    for (kind = 0; kind < BPRED_COUNT; ++kind)
+    {
+        if (strcmp(name, bpred_names[kind]) == 0)
+        {
+            return kind;
+        }
+    }
+
+    return -1;
+}
@@ -0,0 +1,65 @@
+/*
+ * apex_bpred.h
+ * Contains APEX branch prediction unit declarations
+ *
+ * Fetch looks its PC up in a direct-mapped branch target buffer (BTB). On a
+ * hit, unconditional transfers go to the stored target and conditional
+ * branches ask the direction predictor. EX resolves every control transfer
+ * against the PC fetch went to next, redirects fetch when that was wrong
+ * and trains the BTB and the direction predictor with the outcome, so the
+ * tables only ever hold resolved (non-speculative) history. BPRED_NONE is
+ * the original always-not-taken fetch with no BTB.
+ */
+#ifndef _APEX_BPRED_H_
+#define _APEX_BPRED_H_
+
+#include <stdint.h>
+
+/* Direction predictors */
+#define BPRED_NONE 0x0    /* Always not taken */
+#define BPRED_STATIC 0x1  /* Backward taken, forward not taken */
+#define BPRED_BIMODAL 0x2 /* 2-bit counters indexed by PC */
+#define BPRED_GSHARE 0x3  /* 2-bit counters indexed by PC xor global history */
+#define BPRED_COUNT 0x4
+
+/* Table sizes, powers of two */
+#define BPRED_MAX_BTB_ENTRIES 1024
+#define BPRED_MAX_BHT_ENTRIES 4096
+#define BPRED_DEFAULT_BTB_ENTRIES 64
+#define BPRED_DEFAULT_BHT_ENTRIES 256
+
+/* Branch target buffer entry */
+typedef struct APEX_BTB_Entry
+{
+    int pc;              /* Branch PC, 0 for an empty entry */
+    int target;          /* Target of its last taken resolution */
+    uint8_t conditional; /* BZ/BNZ/BP/BNP rather than JUMP */
+} APEX_BTB_Entry;
+
+/* Trained state of the predictor, saved in checkpoints */
+typedef struct APEX_Bpred_State
+{
+    uint32_t history;                         /* Global outcome history, newest in bit 0 */
+    APEX_BTB_Entry btb[BPRED_MAX_BTB_ENTRIES];
+    uint8_t bht[BPRED_MAX_BHT_ENTRIES];       /* 2-bit saturating counters */
+} APEX_Bpred_State;
+
+/* Branch prediction unit */
+typedef struct APEX_Bpred
+{
+    int kind;        /* BPRED_* */
+    int btb_entries; /* Entries of btb[] in use */
+    int bht_entries; /* Counters of bht[] in use */
+    unsigned version; /* Changes whenever training changes btb[] or bht[] */
+    APEX_Bpred_State state;
+} APEX_Bpred;
+
+void APEX_bpred_reset(APEX_Bpred *bp);
+int APEX_bpred_configure(APEX_Bpred *bp, int kind, int btb_entries,
+                         int bht_entries);
+int APEX_bpred_predict(const APEX_Bpred *bp, int pc);
+void APEX_bpred_train(APEX_Bpred *bp, int pc, int conditional, int taken,
+                      int target);
+const char *APEX_bpred_name(int kind);
+int APEX_bpred_parse(const char *name);
+#endif
@@ -0,0 +1,403 @@
+/*
+ * apex_cache.c
+ * Contains APEX cache model implementation
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cache.h"
+#include "apex_macros.h"
+
+/* Bytes of the per-line arrays for one line */
+#define CACHE_LINE_BYTES (2 * sizeof(uint32_t) + 2 * sizeof(uint8_t))
+
+/* Returns TRUE if n is a power of two */
+static int
+power_of_two(int n)
+{
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+/* Sets the geometry and timing a cache option starts from */
+void
+APEX_cache_default_config(APEX_Cache_Config *config)
+{
+    config->size = CACHE_DEFAULT_SIZE;
+    config->assoc = 2;
+    config->line = 16;
+    config->repl = CACHE_REPL_LRU;
+    config->write_policy = CACHE_WRITE_BACK;
+    config->prefetch = CACHE_PREFETCH_NONE;
+    config->hit_latency = 1;
+    config->miss_latency = 10;
+}
+
+/*
+ * Updates config from a comma separated list of key=value settings: size,
+ * assoc, line, hit and miss take a number, repl lru or random, write back
+ * or through and prefetch none or next. Returns FALSE on an unknown key or
+ * value
+ */
+int
+APEX_cache_parse(const char *spec, APEX_Cache_Config *config)
+{
+    char buf[256], *key, *value, *save = NULL;
+
+    if (strlen(spec) >= sizeof(buf))
+    {
+        return FALSE;
+    }
+    strcpy(buf, spec);
+
+    for (key = strtok_r(buf, ",", &save); key; key = strtok_r(NULL, ",", &save))
+    {
+        value = strchr(key, '=');
+        if (!value)
+        {
+            return FALSE;
+        }
+        *value++ = '\0';
+
+        if (strcmp(key, "size") == 0)
+        {
+            config->size = atoi(value);
+        }
+        else if (strcmp(key, "assoc") == 0)
+        {
+            config->assoc = atoi(value);
+        }
+        else if (strcmp(key, "line") == 0)
+        {
+            config->line = atoi(value);
+        }
+        else if (strcmp(key, "hit") == 0)
+        {
+            config->hit_latency = atoi(value);
+        }
+        else if (strcmp(key, "miss") == 0)
+        {
+            config->miss_latency = atoi(value);
+        }
+        else if (strcmp(key, "repl") == 0 && strcmp(value, "lru") == 0)
+        {
+            config->repl = CACHE_REPL_LRU;
+        }
+        else if (strcmp(key, "repl") == 0 && strcmp(value, "random") == 0)
+        {
+            config->repl = CACHE_REPL_RANDOM;
+        }
+        else if (strcmp(key, "write") == 0 && strcmp(value, "back") == 0)
+        {
+            config->write_policy = CACHE_WRITE_BACK;
+        }
+        else if (strcmp(key, "write") == 0 && strcmp(value, "through") == 0)
+        {
+            config->write_policy = CACHE_WRITE_THROUGH;
+        }
+        else if (strcmp(key, "prefetch") == 0 && strcmp(value, "none") == 0)
+        {
+            config->prefetch = CACHE_PREFETCH_NONE;
+        }
+        else if (strcmp(key, "prefetch") == 0 && strcmp(value, "next") == 0)
+        {
+            config->prefetch = CACHE_PREFETCH_NEXT;
+        }
+        else
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/*
+ * Returns TRUE if a configuration has no cache, or a geometry made of
+ * powers of two within CACHE_MAX_LINES lines and latencies in range
+ */
+int
+APEX_cache_valid(const APEX_Cache_Config *config)
+{
+    int lines;
+
+    if (config->size == 0)
+    {
+        return TRUE;
+    }
+
+    if (!power_of_two(config->size) || !power_of_two(config->assoc)
+        || !power_of_two(config->line) || config->line > config->size)
+    {
+        return FALSE;
+    }
+
+    lines = config->size / config->line;
+    return lines <= CACHE_MAX_LINES && config->assoc <= lines
+           && config->hit_latency >= 1
+           && config->miss_latency >= config->hit_latency
+           && config->miss_latency <= CACHE_MAX_LATENCY;
+}
+
+/*
+ * Selects the geometry and timing of a cache, allocating its lines. A
+ * cache keeps its contents when the configuration does not change, so a
+ * restored checkpoint stays warm. Returns FALSE, leaving the cache as it
+ * was, if the configuration is invalid or memory runs out
+ */
+int
+APEX_cache_configure(APEX_Cache *cache, const APEX_Cache_Config *config)
+{
+    int lines;
+    void *block = NULL;
+
+    if (!APEX_cache_valid(config))
+    {
+        return FALSE;
+    }
+
+    if (memcmp(&cache->config, config, sizeof(*config)) == 0)
+    {
+        return TRUE;
+    }
+
+    lines = config->size ? config->size / config->line : 0;
+    if (lines != cache->lines)
+    {
+        if (lines)
+        {
+            block = malloc(lines * CACHE_LINE_BYTES);
+            if (!block)
+            {
+                return FALSE;
+            }
+        }
+        APEX_cache_free(cache);
+        if (block)
+        {
+            cache->lines = lines;
+            cache->state.tag = block;
+            cache->state.stamp = cache->state.tag + lines;
+            cache->state.dirty = (uint8_t *)(cache->state.stamp + lines);
+            cache->state.prefetched = cache->state.dirty + lines;
+        }
+    }
+
+    cache->config = *config;
+    cache->line_shift = config->size ? __builtin_ctz(config->line) : 0;
+    cache->set_mask = config->size
+                          ? config->size / config->line / config->assoc - 1
+                          : 0;
+    APEX_cache_reset(cache);
+    return TRUE;
+}
+
+/* Empties the cache and clears its counts */
+void
+APEX_cache_reset(APEX_Cache *cache)
+{
+    APEX_Cache_State *s = &cache->state;
+
+    if (cache->lines)
+    {
+        memset(s->tag, 0, cache->lines * CACHE_LINE_BYTES);
+    }
+    s->tick = 0;
+    s->rng = 0x2545f491;
+    memset(&s->stats, 0, sizeof(s->stats));
+}
+
+/* Releases the lines of a cache, leaving it with none */
+void
+APEX_cache_free(APEX_Cache *cache)
+{
+    free(cache->state.tag);
+    cache->lines = 0;
+    cache->state.tag = NULL;
+    cache->state.stamp = NULL;
+    cache->state.dirty = NULL;
+    cache->state.prefetched = NULL;
+}
+
+/* Line of the set starting at base that a miss replaces */
+static int
+choose_victim(APEX_Cache *cache, int base)
+{
+    APEX_Cache_State *s = &cache->state;
+    int assoc = cache->config.assoc;
+    int way, victim = base;
+
+    for (way = base; way < base + assoc; ++way)
+    {
+        if (!s->tag[way])
+        {
+            return way;
+        }
+    }
+
+    if (cache->config.repl == CACHE_REPL_RANDOM)
+    {
+        s->rng ^= s->rng << 13;
+        s->rng ^= s->rng >> 17;
+        s->rng ^= s->rng << 5;
+        return base + (s->rng & (assoc - 1));
+    }
+
+    /* Oldest stamp, compared as ages so the tick may wrap */
+    for (way = base + 1; way < base + assoc; ++way)
+    {
+        if (s->tick - s->stamp[way] > s->tick - s->stamp[victim])
+        {
+            victim = way;
+        }
+    }
+
+    return victim;
+}
+
+/* Index of the first line of the set holding tag */
+static inline int
+set_base(const APEX_Cache *cache, uint32_t tag)
+{
+    return ((tag - 1) & cache->set_mask) * cache->config.assoc;
+}
+
+/* Puts the line with tag in the way a miss replaces, writing back the
+ * dirty line it evicts */
+static int
+fill_line(APEX_Cache *cache, uint32_t tag, int write)
+{
+    APEX_Cache_State *s = &cache->state;
+    int way = choose_victim(cache, set_base(cache, tag));
+
+    if (s->dirty[way])
+    {
+        s->stats.writebacks++;
+        s->stats.memory_bytes += cache->config.line;
+    }
+    s->tag[way] = tag;
+    s->stamp[way] = s->tick;
+    s->dirty[way] = write;
+    s->prefetched[way] = FALSE;
+    return way;
+}
+
+/* Brings in the line with tag unless the cache holds it already */
+static void
+prefetch_line(APEX_Cache *cache, uint32_t tag)
+{
+    APEX_Cache_State *s = &cache->state;
+    int base = set_base(cache, tag);
+    int way;
+
+    for (way = base; way < base + cache->config.assoc; ++way)
+    {
+        if (s->tag[way] == tag)
+        {
+            return;
+        }
+    }
+
+    s->prefetched[fill_line(cache, tag, FALSE)] = TRUE;
+    s->stats.prefetches++;
+}
+
+/* Looks address up, updates the cache and returns the cycles it takes */
+int
+APEX_cache_access(APEX_Cache *cache, uint32_t address, int write)
+{
+    APEX_Cache_State *s = &cache->state;
+    uint32_t tag = (address >> cache->line_shift) + 1;
+    int base = set_base(cache, tag);
+    int write_through = cache->config.write_policy == CACHE_WRITE_THROUGH;
+    int way;
+
+    s->tick++;
+    for (way = base; way < base + cache->config.assoc; ++way)
+    {
+        if (s->tag[way] == tag)
+        {
+            s->stamp[way] = s->tick;
+            if (s->prefetched[way])
+            {
+                s->prefetched[way] = FALSE;
+                s->stats.useful_prefetches++;
+            }
+            if (!write)
+            {
+                s->stats.read_hits++;
+            }
+            else
+            {
+                s->stats.write_hits++;
+                s->stats.memory_bytes += write_through ? 4 : 0;
+                s->dirty[way] |= !write_through;
+            }
+            return cache->config.hit_latency;
+        }
+    }
+
+    if (write)
+    {
+        s->stats.write_misses++;
+        if (write_through)
+        {
+            /* No allocation, the store goes straight on to memory */
+            s->stats.memory_bytes += 4;
+            return cache->config.hit_latency;
+        }
+    }
+    else
+    {
+        s->stats.read_misses++;
+    }
+
+    fill_line(cache, tag, write);
+    if (!write && cache->config.prefetch == CACHE_PREFETCH_NEXT)
+    {
+        prefetch_line(cache, tag + 1);
+    }
+    return cache->config.miss_latency;
+}
+
+/* Prints one line of hit and miss counts */
+static void
+report_accesses(FILE *out, const char *name, uint64_t hits, uint64_t misses)
+{
+    fprintf(out, "|\t%-7s|\tHits = %llu\t|\tMisses = %llu\t|\tHit rate = %5.1f%%\n",
+            name, (unsigned long long)hits, (unsigned long long)misses,
+            hits + misses ? 100.0 * hits / (hits + misses) : 0.0);
+}
+
+/* Prints the configuration and hit rates of a cache in use */
+void
+APEX_cache_report(const APEX_Cache *cache, const char *name, FILE *out)
+{
+    const APEX_Cache_Config *c = &cache->config;
+    const APEX_Cache_Stats *st = &cache->state.stats;
+
+    if (!c->size)
+    {
+        return;
+    }
+
+    fprintf(out, "%s = %d bytes, %d-way, %d-byte lines, %s, %s%s, hit %d, miss %d cycles\n",
+            name, c->size, c->assoc, c->line,
+            c->repl == CACHE_REPL_RANDOM ? "random" : "LRU",
+            c->write_policy == CACHE_WRITE_THROUGH ? "write-through" : "write-back",
+            c->prefetch == CACHE_PREFETCH_NEXT ? ", next-line prefetch" : "",
+            c->hit_latency, c->miss_latency);
+    report_accesses(out, "Reads", st->read_hits, st->read_misses);
+    if (c->prefetch != CACHE_PREFETCH_NONE)
+    {
+        fprintf(out, "Prefetches = %llu (%llu useful)\n",
+                (unsigned long long)st->prefetches,
+                (unsigned long long)st->useful_prefetches);
+    }
+    if (st->write_hits || st->write_misses)
+    {
+        report_accesses(out, "Writes", st->write_hits, st->write_misses);
+        fprintf(out, "Writebacks = %llu\nMemory bytes written = %llu\n",
+                (unsigned long long)st->writebacks,
+                (unsigned long long)st->memory_bytes);
+    }
+}
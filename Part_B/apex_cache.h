@@ -0,0 +1,100 @@
+/*
+ * apex_cache.h
+ * Contains APEX cache model declarations
+ *
+ * The cache is a timing model only: data memory stays the one copy of the
+ * data, and the cache keeps the tags, dirty bits and replacement state of
+ * the lines it would hold, each in its own array (one entry per line, set
+ * after set), so a lookup only touches the tags of one set. The arrays are
+ * allocated for the configured geometry, and a CPU without a cache has
+ * none. An access
+ * returns the cycles it takes. Sizes are in bytes, the unit APEX addresses
+ * count, so a 4-byte word takes one address step of 4. A write-back cache allocates on a store miss and
+ * writes a dirty line back when it is evicted; a write-through cache sends
+ * every store on to memory and does not allocate on a store miss. With
+ * next-line prefetch a read miss also brings in the following line, which
+ * is assumed to arrive together with the missing one.
+ */
+#ifndef _APEX_CACHE_H_
+#define _APEX_CACHE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Replacement policies */
+#define CACHE_REPL_LRU 0x0
+#define CACHE_REPL_RANDOM 0x1
+
+/* Write policies */
+#define CACHE_WRITE_BACK 0x0
+#define CACHE_WRITE_THROUGH 0x1
+
+/* Prefetchers */
+#define CACHE_PREFETCH_NONE 0x0
+#define CACHE_PREFETCH_NEXT 0x1 /* Next line on a read miss */
+
+/* Most lines a cache can have, and longest miss latency */
+#define CACHE_MAX_LINES 4096
+#define CACHE_MAX_LATENCY 1000
+
+/* Capacity of a cache enabled without a size */
+#define CACHE_DEFAULT_SIZE 1024
+
+/* Cache geometry and timing, size 0 for no cache */
+typedef struct APEX_Cache_Config
+{
+    int size;         /* Capacity in bytes, a power of two */
+    int assoc;        /* Ways per set, a power of two */
+    int line;         /* Bytes per line, a power of two */
+    int repl;         /* CACHE_REPL_* */
+    int write_policy; /* CACHE_WRITE_* */
+    int prefetch;     /* CACHE_PREFETCH_* */
+    int hit_latency;  /* Cycles of an access that hits */
+    int miss_latency; /* Cycles of an access that misses */
+} APEX_Cache_Config;
+
+/* Access counts */
+typedef struct APEX_Cache_Stats
+{
+    uint64_t read_hits;
+    uint64_t read_misses;
+    uint64_t write_hits;
+    uint64_t write_misses;
+    uint64_t writebacks;   /* Dirty lines written back on eviction */
+    uint64_t memory_bytes; /* Bytes written to memory by writebacks and write-through */
+    uint64_t prefetches;   /* Lines brought in by the prefetcher */
+    uint64_t useful_prefetches; /* Of which later hit by a demand access */
+} APEX_Cache_Stats;
+
+/* Contents of the cache, saved in checkpoints; the per-line arrays have
+ * APEX_Cache.lines entries and share one allocation starting at tag */
+typedef struct APEX_Cache_State
+{
+    uint32_t *tag;       /* Line address plus one, 0 for an empty line */
+    uint32_t *stamp;     /* Tick of the last access, for LRU */
+    uint8_t *dirty;
+    uint8_t *prefetched; /* Prefetched line not used yet */
+    uint32_t tick;       /* Accesses so far */
+    uint32_t rng;        /* Random replacement generator state */
+    APEX_Cache_Stats stats;
+} APEX_Cache_State;
+
+/* Cache model */
+typedef struct APEX_Cache
+{
+    APEX_Cache_Config config;
+    int line_shift;   /* log2 of the line size */
+    int set_mask;     /* Sets minus one */
+    int lines;        /* Lines, 0 for no cache */
+    APEX_Cache_State state;
+} APEX_Cache;
+
+void APEX_cache_default_config(APEX_Cache_Config *config);
+int APEX_cache_parse(const char *spec, APEX_Cache_Config *config);
+int APEX_cache_valid(const APEX_Cache_Config *config);
+int APEX_cache_configure(APEX_Cache *cache, const APEX_Cache_Config *config);
+void APEX_cache_reset(APEX_Cache *cache);
+void APEX_cache_free(APEX_Cache *cache);
+int APEX_cache_access(APEX_Cache *cache, uint32_t address, int write);
+void APEX_cache_report(const APEX_Cache *cache, const char *name, FILE *out);
+#endif
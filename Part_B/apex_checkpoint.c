@@ -0,0 +1,414 @@
+/*
+ * apex_checkpoint.c
+ * Contains APEX cpu checkpoint and restore implementation
+ *
+ * The file is the header, the core state in the order listed by
+ * transfer_state(), then one (page index, words) record per non-zero
+ * data memory page. Tables are stored only as far as they are configured.
+ * A restored state is checked against the program and the ISA before it
+ * replaces the CPU's, so a corrupt file cannot make the pipeline index
+ * past its tables.
+ */
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_checkpoint.h"
+#include "apex_loop.h"
+
+/* Stage latch bytes stored in a checkpoint; the execute handler is a host
+ * pointer and is resolved again from code memory on restore */
+#define CKPT_STAGE_BYTES offsetof(CPU_Stage, exec)
+
+/* FNV-1a hash identifying the program a checkpoint belongs to */
+static uint32_t
+hash_code_memory(const APEX_CPU *cpu)
+{
+    const unsigned char *p = (const unsigned char *)cpu->code_memory;
+    size_t i, len = cpu->code_memory_size * sizeof(APEX_Instruction);
+    uint32_t hash = 2166136261u;
+
+    for (i = 0; i < len; ++i)
+    {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+/* Writes or reads one field, depending on the direction */
+static int
+transfer(FILE *fp, void *field, size_t size, int saving)
+{
+    if (saving)
+    {
+        return fwrite(field, size, 1, fp) == 1;
+    }
+
+    return fread(field, size, 1, fp) == 1;
+}
+
+#define XFER(field) transfer(fp, &(field), sizeof(field), saving)
+
+/*
+ * Writes or reads a cache: its configuration, its counts and the state of
+ * the lines that configuration has, so a CPU without caches stores none.
+ * A cache read back is configured, and its lines allocated, from the file
+ */
+static int
+transfer_cache(FILE *fp, APEX_Cache *cache, int saving)
+{
+    APEX_Cache_Config config = cache->config;
+    APEX_Cache_State *s = &cache->state;
+    size_t lines;
+
+    if (!XFER(config) || (!saving && !APEX_cache_configure(cache, &config)))
+    {
+        return FALSE;
+    }
+
+    lines = cache->lines;
+    if (!(XFER(s->tick) && XFER(s->rng) && XFER(s->stats)))
+    {
+        return FALSE;
+    }
+
+    return !lines
+           || (transfer(fp, s->tag, lines * sizeof(*s->tag), saving)
+               && transfer(fp, s->stamp, lines * sizeof(*s->stamp), saving)
+               && transfer(fp, s->dirty, lines * sizeof(*s->dirty), saving)
+               && transfer(fp, s->prefetched, lines * sizeof(*s->prefetched), saving));
+}
+
+/*
+ * Writes or reads the predictor history and the table entries in use. A
+ * predictor read back keeps its own sizes, and its entries past those in
+ * the file start from reset
+ */
+static int
+transfer_bpred(FILE *fp, APEX_Bpred *bp, int saving)
+{
+    APEX_Bpred_State *s = &bp->state;
+    int btb_entries = bp->btb_entries, bht_entries = bp->bht_entries;
+
+    if (!(XFER(btb_entries) && XFER(bht_entries)))
+    {
+        return FALSE;
+    }
+
+    if (!saving)
+    {
+        if (btb_entries < 1 || btb_entries > BPRED_MAX_BTB_ENTRIES
+            || bht_entries < 1 || bht_entries > BPRED_MAX_BHT_ENTRIES)
+        {
+            return FALSE;
+        }
+        APEX_bpred_reset(bp);
+    }
+
+    return XFER(s->history)
+           && transfer(fp, s->btb, btb_entries * sizeof(*s->btb), saving)
+           && transfer(fp, s->bht, bht_entries * sizeof(*s->bht), saving);
+}
+
+/*
+ * Writes or reads everything except data memory. Checkpoint and restore
+ * both go through this one list, so the two can never disagree on the
+ * order of fields
+ */
+static int
+transfer_state(FILE *fp, APEX_CPU *cpu, int saving)
+{
+    CPU_Stage *stages[] = {&cpu->fetch, &cpu->decode, &cpu->execute,
+                           &cpu->memory, &cpu->writeback};
+    size_t i;
+
+    if (!(XFER(cpu->pc) && XFER(cpu->clock) && XFER(cpu->pipe_clock)
+          && XFER(cpu->insn_completed)
+          && XFER(cpu->regs) && XFER(cpu->valid_bit) && XFER(cpu->pos_flag)
+          && XFER(cpu->zero_flag) && XFER(cpu->fetch_from_next_cycle)
+          && XFER(cpu->forwardedDataBuffer) && XFER(cpu->fdata)
+          && XFER(cpu->scoreboard) && XFER(cpu->issue_tag)
+          && XFER(cpu->counters) && transfer_bpred(fp, &cpu->bpred, saving)
+          && XFER(cpu->fu) && transfer_cache(fp, &cpu->dcache, saving)
+          && XFER(cpu->mem_wait) && transfer_cache(fp, &cpu->icache, saving)
+          && XFER(cpu->fetch_wait)
+          && XFER(cpu->fault) && XFER(cpu->fault_fetch)
+          && XFER(cpu->fault_address) && XFER(cpu->fault_pc)
+          && XFER(cpu->fault_cycle)))
+    {
+        return FALSE;
+    }
+
+    for (i = 0; i < sizeof(stages) / sizeof(stages[0]); ++i)
+    {
+        if (!transfer(fp, stages[i], CKPT_STAGE_BYTES, saving))
+        {
+            return FALSE;
+        }
+    }
+
+    for (i = 0; i < FU_MAX_LATENCY; ++i)
+    {
+        if (!transfer(fp, &cpu->fu_ring[i], CKPT_STAGE_BYTES, saving))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Returns TRUE if a data memory page holds a non-zero word */
+static int
+page_in_use(const int32_t *page)
+{
+    uint32_t i;
+
+    for (i = 0; i < MEM_PAGE_WORDS; ++i)
+    {
+        if (page[i])
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/* Pre-decoded instruction at pc, NULL if pc is outside code memory */
+static const APEX_Decoded_Insn *
+decoded_at(const APEX_CPU *cpu, int pc)
+{
+    if (pc < 4000 || (pc - 4000) % 4 != 0 || (pc - 4000) / 4 >= cpu->code_memory_size)
+    {
+        return NULL;
+    }
+
+    return &cpu->decoded_code[(pc - 4000) / 4];
+}
+
+/* Execute handler of the instruction held by a restored latch */
+static APEX_Exec_Handler
+stage_exec(const APEX_CPU *cpu, const CPU_Stage *stage)
+{
+    const APEX_Decoded_Insn *insn = decoded_at(cpu, stage->pc);
+
+    return insn ? insn->exec : NULL;
+}
+
+/*
+ * Returns TRUE if a restored latch names a known opcode and registers of
+ * the register file, and, if it holds an instruction, holds the one the
+ * program has at its PC
+ */
+static int
+valid_stage(const APEX_CPU *cpu, const CPU_Stage *stage, int holds)
+{
+    const uint32_t all_regs = REG_BIT(REG_FILE_SIZE) - 1;
+    const APEX_Decoded_Insn *insn;
+
+    if (stage->opcode >= OPCODE_COUNT || stage->rd >= REG_FILE_SIZE
+        || stage->rs1 >= REG_FILE_SIZE || stage->rs2 >= REG_FILE_SIZE
+        || ((stage->src_mask | stage->dst_mask | stage->late_mask) & ~all_regs))
+    {
+        return FALSE;
+    }
+
+    if (!holds)
+    {
+        return TRUE;
+    }
+
+    insn = decoded_at(cpu, stage->pc);
+    return insn && stage->opcode == insn->insn.opcode
+           && stage->rd == insn->insn.rd && stage->rs1 == insn->insn.rs1
+           && stage->rs2 == insn->insn.rs2 && stage->imm == insn->insn.imm
+           && stage->operands == insn->operands
+           && stage->src_mask == insn->src_mask
+           && stage->dst_mask == insn->dst_mask
+           && stage->late_mask == insn->late_mask;
+}
+
+/*
+ * Returns TRUE if a restored state is one the pipeline can run: every
+ * latch valid, register masks within the register file, the completion
+ * slots matching the count in flight, and clocks and waits in range
+ */
+static int
+valid_state(const APEX_CPU *cpu)
+{
+    const uint32_t all_regs = REG_BIT(REG_FILE_SIZE) - 1;
+    int i, in_flight = 0;
+
+    if (cpu->clock < 0 || cpu->pipe_clock < 0 || cpu->pipe_clock > cpu->clock
+        || cpu->insn_completed < 0
+        || ((cpu->scoreboard.pending | cpu->scoreboard.not_ready) & ~all_regs)
+        || cpu->mem_wait < 0 || cpu->mem_wait > CACHE_MAX_LATENCY
+        || cpu->fetch_wait < 0 || cpu->fetch_wait > CACHE_MAX_LATENCY
+        || cpu->fu.mul_latency < 1 || cpu->fu.mul_latency > FU_MAX_LATENCY
+        || cpu->fu.div_latency < 1 || cpu->fu.div_latency > FU_MAX_LATENCY)
+    {
+        return FALSE;
+    }
+
+    if (!valid_stage(cpu, &cpu->fetch, cpu->fetch.has_insn && cpu->fetch.isStalled)
+        || !valid_stage(cpu, &cpu->decode, cpu->decode.has_insn)
+        || !valid_stage(cpu, &cpu->execute, cpu->execute.has_insn)
+        || !valid_stage(cpu, &cpu->memory, cpu->memory.has_insn)
+        || !valid_stage(cpu, &cpu->writeback, cpu->writeback.has_insn))
+    {
+        return FALSE;
+    }
+
+    for (i = 0; i < FU_MAX_LATENCY; ++i)
+    {
+        if (!valid_stage(cpu, &cpu->fu_ring[i], cpu->fu_ring[i].has_insn))
+        {
+            return FALSE;
+        }
+        in_flight += cpu->fu_ring[i].has_insn != 0;
+    }
+
+    return cpu->fu.in_flight == in_flight;
+}
+
+/*
+ * Saves the complete state of the CPU to path. Returns FALSE if the file
+ * could not be written
+ */
+int
+APEX_cpu_checkpoint(APEX_CPU *cpu, const char *path)
+{
+    APEX_Checkpoint_Header hdr;
+    uint32_t page;
+    FILE *fp;
+    int ok;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, APEX_CKPT_MAGIC, sizeof(APEX_CKPT_MAGIC));
+    hdr.version = APEX_CKPT_VERSION;
+    hdr.stage_size = CKPT_STAGE_BYTES;
+    hdr.code_size = cpu->code_memory_size;
+    hdr.code_hash = hash_code_memory(cpu);
+    hdr.page_words = MEM_PAGE_WORDS;
+    for (page = APEX_mem_next_page(&cpu->data_memory, 0); page != MEM_NO_PAGE;
+         page = APEX_mem_next_page(&cpu->data_memory, page + 1))
+    {
+        hdr.num_pages += page_in_use(APEX_mem_page(&cpu->data_memory, page));
+    }
+
+    fp = fopen(path, "wb");
+    if (!fp)
+    {
+        return FALSE;
+    }
+
+    ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1 && transfer_state(fp, cpu, TRUE);
+    for (page = APEX_mem_next_page(&cpu->data_memory, 0);
+         ok && page != MEM_NO_PAGE;
+         page = APEX_mem_next_page(&cpu->data_memory, page + 1))
+    {
+        const int32_t *words = APEX_mem_page(&cpu->data_memory, page);
+
+        if (page_in_use(words))
+        {
+            ok = fwrite(&page, sizeof(page), 1, fp) == 1
+                 && fwrite(words, sizeof(int32_t), MEM_PAGE_WORDS, fp)
+                        == MEM_PAGE_WORDS;
+        }
+    }
+
+    if (fclose(fp) != 0)
+    {
+        ok = FALSE;
+    }
+
+    return ok;
+}
+
+/*
+ * Restores a checkpoint into a CPU that has loaded the same program.
+ * Returns FALSE, leaving the CPU untouched, if the file is unreadable,
+ * from another version or build, taken from a different program, or
+ * holds a state the pipeline could not run
+ */
+int
+APEX_cpu_restore(APEX_CPU *cpu, const char *path)
+{
+    APEX_Checkpoint_Header hdr;
+    APEX_CPU *saved;
+    int32_t *words;
+    uint32_t i, page;
+    FILE *fp;
+    int ok;
+
+    fp = fopen(path, "rb");
+    if (!fp)
+    {
+        return FALSE;
+    }
+
+    ok = fread(&hdr, sizeof(hdr), 1, fp) == 1
+         && memcmp(hdr.magic, APEX_CKPT_MAGIC, sizeof(hdr.magic)) == 0
+         && hdr.version == APEX_CKPT_VERSION
+         && hdr.stage_size == CKPT_STAGE_BYTES
+         && hdr.page_words == MEM_PAGE_WORDS
+         && hdr.code_size == (uint32_t)cpu->code_memory_size
+         && hdr.code_hash == hash_code_memory(cpu);
+
+    /* Build the restored state in a copy so a short file changes nothing */
+    saved = ok ? malloc(sizeof(*saved)) : NULL;
+    if (!saved)
+    {
+        fclose(fp);
+        return FALSE;
+    }
+    *saved = *cpu;
+    APEX_mem_init(&saved->data_memory);
+    saved->data_memory.limit = cpu->data_memory.limit;
+    memset(&saved->dcache, 0, sizeof(saved->dcache));
+    memset(&saved->icache, 0, sizeof(saved->icache));
+
+    ok = transfer_state(fp, saved, FALSE);
+    for (i = 0; ok && i < hdr.num_pages; ++i)
+    {
+        ok = fread(&page, sizeof(page), 1, fp) == 1
+             && (words = APEX_mem_page_for_write(&saved->data_memory, page))
+             && fread(words, sizeof(int32_t), MEM_PAGE_WORDS, fp)
+                    == MEM_PAGE_WORDS;
+    }
+    fclose(fp);
+
+    ok = ok && valid_state(saved);
+    if (ok)
+    {
+        saved->fetch.exec = stage_exec(saved, &saved->fetch);
+        saved->decode.exec = stage_exec(saved, &saved->decode);
+        saved->execute.exec = stage_exec(saved, &saved->execute);
+        saved->memory.exec = stage_exec(saved, &saved->memory);
+        saved->writeback.exec = stage_exec(saved, &saved->writeback);
+        for (i = 0; i < FU_MAX_LATENCY; ++i)
+        {
+            saved->fu_ring[i].exec = stage_exec(saved, &saved->fu_ring[i]);
+        }
+        APEX_mem_free(&cpu->data_memory);
+        APEX_cache_free(&cpu->dcache);
+        APEX_cache_free(&cpu->icache);
+        *cpu = *saved;
+
+        /* Loops seen before belong to another run */
+        APEX_loop_reset(cpu);
+    }
+    else
+    {
+        APEX_mem_free(&saved->data_memory);
+        APEX_cache_free(&saved->dcache);
+        APEX_cache_free(&saved->icache);
+    }
+
+    free(saved);
+    return ok;
+}
@@ -0,0 +1,38 @@
+/*
+ * apex_checkpoint.h
+ * Contains APEX cpu checkpoint file declarations
+ *
+ * A checkpoint (.apexckpt) holds the complete simulation state of an
+ * APEX_CPU: PC, clock, register file, valid bits, scoreboard, forwarding
+ * buffer, flags, performance counters, the branch predictor entries and
+ * cache lines it is configured with, the fault record, the five stage
+ * latches with the completion slots and data memory. Only data memory pages with a non-zero word are stored. All fields are stored in host
+ * byte order. Code memory is not stored; the checkpoint records the size
+ * and a hash of the program it was taken from and is restored into a CPU
+ * that has loaded the same program.
+ */
+#ifndef _APEX_CHECKPOINT_H_
+#define _APEX_CHECKPOINT_H_
+
+#include <stdint.h>
+
+#define APEX_CKPT_MAGIC "APEXCKP"
+#define APEX_CKPT_VERSION 10
+
+/* Header at offset 0 of a checkpoint file */
+typedef struct APEX_Checkpoint_Header
+{
+    char magic[8];       /* APEX_CKPT_MAGIC, NUL terminated */
+    uint32_t version;    /* APEX_CKPT_VERSION */
+    uint32_t stage_size; /* Bytes stored per stage latch */
+    uint32_t code_size;  /* Instructions in the program */
+    uint32_t code_hash;  /* FNV-1a hash of the program's code memory */
+    uint32_t page_words; /* MEM_PAGE_WORDS */
+    uint32_t num_pages;  /* Non-zero data memory pages that follow the state */
+} APEX_Checkpoint_Header;
+
+struct APEX_CPU;
+
+int APEX_cpu_checkpoint(struct APEX_CPU *cpu, const char *path);
+int APEX_cpu_restore(struct APEX_CPU *cpu, const char *path);
+#endif
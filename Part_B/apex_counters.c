@@ -0,0 +1,73 @@
+/*
+ * apex_counters.c
+ * Contains APEX pipeline performance counter reporting
+ */
+#include <stdio.h>
+
+#include "apex_cpu.h"
+#include "apex_counters.h"
+
+
+/* Prints one line of the cycle breakdown */
+static void
+report_cycles(FILE *out, const char *name, uint64_t count, int clock)
+{
+    fprintf(out, "|\t%-22s|\t%llu\t|\t%5.1f%%\n", name,
+            (unsigned long long)count, clock ? 100.0 * count / clock : 0.0);
+}
+
+/* Prints CPI, the cycle breakdown and the per-opcode retire counts */
+void
+APEX_counters_report(const APEX_CPU *cpu, FILE *out)
+{
+    const APEX_Counters *c = &cpu->counters;
+    int op;
+
+    fprintf(out, "-------------------------------------------\n%s\n-------------------------------------------\n",
+            " PIPELINE PERFORMANCE COUNTERS:");
+    fprintf(out, "Forwarding = %s\n", scoreboard_forwarding_name(cpu->forwarding));
+    fprintf(out, "Cycles = %d\nInstructions = %d\nCPI = %.3f\n", cpu->clock,
+            cpu->insn_completed,
+            cpu->insn_completed ? (double)cpu->clock / cpu->insn_completed : 0.0);
+
+    report_cycles(out, "Data hazard stalls", c->data_stalls, cpu->clock);
+    report_cycles(out, "Branch flag stalls", c->flag_stalls, cpu->clock);
+    report_cycles(out, "MUL/DIV result stalls", c->fu_result_stalls, cpu->clock);
+    report_cycles(out, "Functional unit busy", c->fu_busy_stalls, cpu->clock);
+    report_cycles(out, "D-cache stalls", c->dcache_stalls, cpu->clock);
+    report_cycles(out, "Branch flushes", c->branch_flushes, cpu->clock);
+    report_cycles(out, "Fetch bubbles", c->fetch_bubbles, cpu->clock);
+    report_cycles(out, "I-cache stalls", c->icache_stalls, cpu->clock);
+    report_cycles(out, "HALT drain", c->halt_drain, cpu->clock);
+    fprintf(out, "Forwarded operands = %llu\n",
+            (unsigned long long)c->forwarded_operands);
+    fprintf(out, "Functional units = ALU 1, MUL %d (pipelined), DIV %d\n",
+            cpu->fu.mul_latency, cpu->fu.div_latency);
+    APEX_cache_report(&cpu->icache, "I-cache", out);
+    APEX_cache_report(&cpu->dcache, "D-cache", out);
+
+    /* Always-not-taken fetch is redirected by every taken branch, losing
+     * the fetch slots between F and the stage branches resolve in */
+    fprintf(out, "Branch predictor = %s\n", APEX_bpred_name(cpu->bpred.kind));
+    fprintf(out, "Branches resolve in = %s\n",
+            cpu->branch_stage == STAGE_DECODE ? "D/RF" : "EX");
+    fprintf(out, "Branches = %llu (%llu taken)\nMispredictions = %llu\n",
+            (unsigned long long)c->branches,
+            (unsigned long long)c->branches_taken,
+            (unsigned long long)c->mispredicts);
+    fprintf(out, "Prediction accuracy = %.1f%%\n",
+            c->branches ? 100.0 * (c->branches - c->mispredicts) / c->branches : 0.0);
+    fprintf(out, "Cycles saved vs not taken = %lld\n",
+            ((long long)c->branches_taken - (long long)c->mispredicts)
+                * (cpu->branch_stage - STAGE_FETCH));
+
+    fprintf(out, "Retired by opcode:\n");
+    for (op = 0; op < OPCODE_COUNT; ++op)
+    {
+        if (c->retired[op])
+        {
+            fprintf(out, "|\t%-6s|\t%llu\n", get_opcode_str(op),
+                    (unsigned long long)c->retired[op]);
+        }
+    }
+}
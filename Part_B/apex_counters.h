@@ -0,0 +1,39 @@
+/*
+ * apex_counters.h
+ * Contains APEX pipeline performance counter declarations
+ *
+ * The counters are plain increments done by the stages as events happen;
+ * APEX_counters_report() turns them into CPI and a breakdown of where the
+ * cycles went.
+ */
+#ifndef _APEX_COUNTERS_H_
+#define _APEX_COUNTERS_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "apex_macros.h"
+
+struct APEX_CPU;
+
+/* Pipeline performance counters */
+typedef struct APEX_Counters
+{
+    uint64_t data_stalls;        /* D/RF stalled on a source it cannot read yet */
+    uint64_t flag_stalls;        /* Early-resolved branch waited for the flags from EX */
+    uint64_t fu_result_stalls;   /* D/RF stalled on the result of a MUL or DIV still in EX */
+    uint64_t fu_busy_stalls;     /* D/RF held back by the divider or an older, slower instruction */
+    uint64_t dcache_stalls;      /* Pipeline frozen while MEM waits for the D-cache */
+    uint64_t branch_flushes;     /* D/RF slots squashed by taken branches */
+    uint64_t fetch_bubbles;      /* Fetch idle while the branch target is redirected */
+    uint64_t icache_stalls;      /* Fetch waiting for the I-cache */
+    uint64_t halt_drain;         /* Fetch idle after HALT while the pipeline drains */
+    uint64_t forwarded_operands; /* Source operands read from the forwarding buffer */
+    uint64_t branches;           /* Control transfers resolved */
+    uint64_t branches_taken;     /* Of which taken */
+    uint64_t mispredicts;        /* Of which fetch went the wrong way */
+    uint64_t retired[OPCODE_COUNT]; /* Instructions retired per opcode */
+} APEX_Counters;
+
+void APEX_counters_report(const struct APEX_CPU *cpu, FILE *out);
+#endif
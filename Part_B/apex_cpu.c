@@ -6,6 +6,7 @@
  * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
  * State University of New York at Binghamton
  */
+#include <limits.h>
 #include <stdio.h>
 
 #include <stdlib.h>
@@ -16,6 +17,16 @@
 
 #include "apex_macros.h"
 
+#include "apex_cache.h"
+#include "apex_checkpoint.h"
+#include "apex_fu.h"
+#include "apex_image.h"
+#include "apex_loop.h"
+#include "apex_memo.h"
+#include "apex_scoreboard.h"
+#include "apex_timeline.h"
+#include "apex_trace.h"
+
 /* Converts the PC(4000 series) into array index for code memory
  *
  * Note: You are not supposed to edit this function
@@ -26,138 +37,70 @@ get_code_memory_index_from_pc(const int pc)
   return (pc - 4000) / 4;
 }
 
+/* Returns TRUE if pc addresses an instruction of code memory */
+static inline int
+pc_in_code(const APEX_CPU *cpu, const int pc)
+{
+  return pc >= 4000 && (pc - 4000) % 4 == 0
+         && get_code_memory_index_from_pc(pc) < cpu->code_memory_size;
+}
+
+/* Records a fetch from outside code memory that nothing left in the
+ * pipeline can redirect; the run stops once the cycle is over */
 static void
-print_instruction(const CPU_Stage *stage)
+fetch_fault(APEX_CPU *cpu)
 {
-  switch (stage->opcode)
-  {
-  case OPCODE_ADD:
-  {
-    printf("%s,R%d,R%d,R%d ", stage->opcode_str, stage->rd, stage->rs1,
-           stage->rs2);
-    break;
-  }
-  case OPCODE_ADDL:
-  {
-    printf("%s,R%d,R%d,#%d ", stage->opcode_str, stage->rd, stage->rs1,
-           stage->imm);
-    break;
-  }
-  case OPCODE_SUBL:
-  {
-    printf("%s,R%d,R%d,#%d ", stage->opcode_str, stage->rd, stage->rs1,
-           stage->imm);
-    break;
-  }
-  case OPCODE_SUB:
-  {
-    printf("%s,R%d,R%d,R%d ", stage->opcode_str, stage->rd, stage->rs1,
-           stage->rs2);
-    break;
-  }
-  case OPCODE_MUL:
-  case OPCODE_DIV:
-  {
-    printf("%s,R%d,R%d,R%d ", stage->opcode_str, stage->rd, stage->rs1,
-           stage->rs2);
-    break;
-  }
-  case OPCODE_LDI:
-  {
-    printf("%s,R%d,R%d,#%d ", stage->opcode_str, stage->rd, stage->rs1, stage->imm);
-    break;
-  }
-  case OPCODE_STI:
-  {
-    printf("%s,R%d,R%d,#%d ", stage->opcode_str, stage->rs2, stage->rs1, stage->imm);
-    break;
-  }
-  case OPCODE_CMP:
-  {
-    printf("%s,R%d,R%d ", stage->opcode_str, stage->rs1, stage->rs2);
-    break;
-  }
-  case OPCODE_OR:
-  case OPCODE_AND:
-  {
-    printf("%s,R%d,R%d,R%d ", stage->opcode_str, stage->rd, stage->rs1,
-           stage->rs2);
-    break;
-  }
-  case OPCODE_EXOR:
-  {
-    printf("%s,R%d,R%d,R%d ", stage->opcode_str, stage->rd, stage->rs1,
-           stage->rs2);
-    break;
-  }
-  case OPCODE_NOP:
-  case OPCODE_HALT:
-  {
-    printf("%s", stage->opcode_str);
-    break;
-  }
-  case OPCODE_MOVC:
-  {
-    printf("%s,R%d,#%d ", stage->opcode_str, stage->rd, stage->imm);
-    break;
-  }
-  case OPCODE_LOAD:
-  {
-    printf("%s,R%d,R%d,#%d ", stage->opcode_str, stage->rd, stage->rs1,
-           stage->imm);
-    break;
-  }
-  case OPCODE_STORE:
-  {
-    printf("%s,R%d,R%d,#%d ", stage->opcode_str, stage->rs1, stage->rs2,
-           stage->imm);
-    break;
-  }
-  case OPCODE_BZ:
-  {
-    printf("%s,#%d ", stage->opcode_str, stage->imm);
-    break;
-  }
-  case OPCODE_BNZ:
-  {
-    printf("%s,#%d ", stage->opcode_str, stage->imm);
-    break;
-  }
-  case OPCODE_BP:
-  {
-    printf("%s,#%d ", stage->opcode_str, stage->imm);
-    break;
-  }
-  case OPCODE_BNP:
-  {
-    printf("%s,#%d ", stage->opcode_str, stage->imm);
-    break;
-  }
-  case OPCODE_JUMP:
+  cpu->fault = TRUE;
+  cpu->fault_fetch = TRUE;
+  cpu->fault_address = cpu->pc;
+  cpu->fault_pc = cpu->pc;
+  cpu->fault_cycle = cpu->clock;
+}
+
+/* Profile entry of the instruction at pc; the spare entry past the last
+ * instruction takes a PC outside code memory, and is never reported */
+static inline APEX_Profile_Entry *
+profile_at(APEX_CPU *cpu, const int pc)
+{
+  if (!pc_in_code(cpu, pc))
   {
-    printf("%s,R%d,#%d ", stage->opcode_str, stage->rs1, stage->imm);
-    break;
-  }
+    return &cpu->profile[cpu->code_memory_size];
   }
+  return &cpu->profile[get_code_memory_index_from_pc(pc)];
 }
 
-/* Debug function which prints the CPU stage content
- *
- * Note: You can edit this function to print in more detail
+/*
+ * The stages and the run loop take the run loop variant (RUN_*) and the
+ * forwarding network (FWD_*) as constants and are always inlined into one
+ * run function per pair, so each variant is compiled with only the output
+ * it produces and the hazard checks of its network, and the quiet loop has
+ * no per-cycle checks on output at all
  */
-static void
-print_stage_content(const char *name,
-                    const CPU_Stage *stage)
+#define APEX_STAGE static inline __attribute__((always_inline))
+
+/* Reports the content of a stage latch, as a trace record when tracing
+ * and as text otherwise. Both come from the same record, so a decoded
+ * trace reads exactly like the live output */
+APEX_STAGE void
+report_stage(APEX_CPU *cpu, const int out, const int stage_id,
+             const CPU_Stage *stage)
 {
-  printf("%-15s: I%d pc(%d)", name, (stage->pc - 4000) / 4, stage->pc);
-  print_instruction(stage);
-  printf("\t R%d=%d\tR%d=%d \t R%d=%d", stage->rs1, stage->rs1_value, stage->rs2, stage->rs2_value, stage->rd, stage->result_buffer);
-  if (stage->isStalled)
+  APEX_Trace_Record rec;
+
+  if (out == RUN_TIMELINE)
   {
-    printf(" Stalled");
+    APEX_timeline_stage(cpu->timeline, cpu->clock, stage_id, stage);
+    return;
   }
 
-  printf("\n");
+  if (out == RUN_TRACE)
+  {
+    trace_stage(cpu->trace, cpu->clock, stage_id, stage);
+    return;
+  }
+
+  trace_fill_stage(&rec, cpu->clock, stage_id, stage);
+  APEX_trace_format(stdout, &rec);
 }
 
 /* Debug function which prints the register file
@@ -177,10 +120,16 @@ print_reg_file(const APEX_CPU *cpu)
   printf("\n");
 
   printf("-------------------------------------------\n%s\n-------------------------------------------\n", " STATE OF DATA MEMORY:");
-  for (int i = 0; i < DATA_MEMORY_SIZE; ++i)
+  for (uint32_t page = APEX_mem_next_page(&cpu->data_memory, 0);
+       page != MEM_NO_PAGE; page = APEX_mem_next_page(&cpu->data_memory, page + 1))
   {
-    if (cpu->data_memory[i])
-      printf("|\tMEM[%d]\t|\tData Value=%d\n", i, cpu->data_memory[i]);
+    const int32_t *words = APEX_mem_page(&cpu->data_memory, page);
+
+    for (uint32_t i = 0; i < MEM_PAGE_WORDS; ++i)
+    {
+      if (words[i])
+        printf("|\tMEM[%u]\t|\tData Value=%d\n", page * MEM_PAGE_WORDS + i, words[i]);
+    }
   }
 
   printf("\n");
@@ -195,10 +144,10 @@ print_reg_file(const APEX_CPU *cpu)
  *
  * Note: You are free to edit this function according to your implementation
  */
-static void
-APEX_fetch(APEX_CPU *cpu)
+APEX_STAGE void
+APEX_fetch(APEX_CPU *cpu, const int out)
 {
-  APEX_Instruction *current_ins;
+  const APEX_Decoded_Insn *current_ins;
 
   // Checking if fetch stage has instruction and is isStalled or not!
   if (cpu->fetch.has_insn)
@@ -209,23 +158,84 @@ APEX_fetch(APEX_CPU *cpu)
       if (cpu->fetch_from_next_cycle == TRUE)
       {
         cpu->fetch_from_next_cycle = FALSE;
+        cpu->counters.fetch_bubbles++;
 
         /* Skip this cycle*/
         return;
       }
 
+      /* A PC outside code memory holds fetch. On a wrong path a branch
+       * still in the pipeline redirects it; once the pipeline has drained
+       * nothing can, and the run faults */
+      if (!pc_in_code(cpu, cpu->pc))
+      {
+        if (!cpu->decode.has_insn && !cpu->execute.has_insn && !cpu->memory.has_insn
+            && !cpu->writeback.has_insn && !cpu->fu.in_flight)
+        {
+          fetch_fault(cpu);
+        }
+        return;
+      }
+
+      /* An I-cache access longer than a cycle holds fetch until the line
+       * arrives; the instruction is then fetched without another lookup */
+      if (cpu->fetch_wait)
+      {
+        if (--cpu->fetch_wait)
+        {
+          cpu->counters.icache_stalls++;
+          return;
+        }
+      }
+      else if (cpu->icache.config.size)
+      {
+        cpu->fetch_wait = APEX_cache_access(&cpu->icache, cpu->pc, FALSE) - 1;
+        if (cpu->fetch_wait)
+        {
+          cpu->counters.icache_stalls++;
+          profile_at(cpu, cpu->pc)->stage_cycles[STAGE_FETCH] += cpu->fetch_wait;
+          return;
+        }
+      }
+
       /* Store current PC in fetch latch */
       cpu->fetch.pc = cpu->pc;
+      if (out == RUN_QUIET && cpu->memo_recording)
+      {
+        APEX_memo_fetched(cpu->memo, cpu->pc);
+      }
 
       /* Index into code memory using this pc and copy all instruction fields
        * into fetch latch  */
-      current_ins = &cpu->code_memory[get_code_memory_index_from_pc(cpu->pc)];
-      strcpy(cpu->fetch.opcode_str, current_ins->opcode_str);
-      cpu->fetch.opcode = current_ins->opcode;
-      cpu->fetch.rd = current_ins->rd;
-      cpu->fetch.rs1 = current_ins->rs1;
-      cpu->fetch.rs2 = current_ins->rs2;
-      cpu->fetch.imm = current_ins->imm;
+      current_ins = &cpu->decoded_code[get_code_memory_index_from_pc(cpu->pc)];
+      cpu->fetch.opcode = current_ins->insn.opcode;
+      cpu->fetch.rd = current_ins->insn.rd;
+      cpu->fetch.rs1 = current_ins->insn.rs1;
+      cpu->fetch.rs2 = current_ins->insn.rs2;
+      cpu->fetch.imm = current_ins->insn.imm;
+      cpu->fetch.operands = current_ins->operands;
+      cpu->fetch.src_mask = current_ins->src_mask;
+      cpu->fetch.dst_mask = current_ins->dst_mask;
+      cpu->fetch.late_mask = current_ins->late_mask;
+      cpu->fetch.exec = current_ins->exec;
+      cpu->fetch.tag = ++cpu->issue_tag;
+      cpu->fetch.resolved = FALSE;
+
+      /* Next PC, the BTB target when the predictor says taken */
+      if (cpu->bpred.kind == BPRED_NONE)
+      {
+        cpu->fetch.pred_pc = cpu->pc + 4;
+      }
+      else
+      {
+        cpu->fetch.pred_pc = APEX_bpred_predict(&cpu->bpred, cpu->pc);
+      }
+
+      /* A loop may be about to go round again */
+      if (out == RUN_QUIET && cpu->fetch.pred_pc <= cpu->fetch.pc)
+      {
+        cpu->loop_probe = cpu->loop_accel || cpu->block_memo;
+      }
 
       /*to check whether D/RF stage is isStalled or not! */
       if (cpu->decode.isStalled)
@@ -235,7 +245,7 @@ APEX_fetch(APEX_CPU *cpu)
       else
       {
         /* if not isStalled then update the PC for next instruction*/
-        cpu->pc += 4;
+        cpu->pc = cpu->fetch.pred_pc;
         /* and copy data from fetch to D/RF */
         cpu->decode = cpu->fetch;
       }
@@ -245,789 +255,687 @@ APEX_fetch(APEX_CPU *cpu)
       if (!cpu->decode.isStalled)
       {
         cpu->fetch.isStalled = 0;
-        cpu->pc += 4;
+        cpu->pc = cpu->fetch.pred_pc;
         cpu->decode = cpu->fetch;
       }
     }
 
-    if (ENABLE_DEBUG_MESSAGES && cpu->fetch.has_insn)
+    profile_at(cpu, cpu->fetch.pc)->stage_cycles[STAGE_FETCH]++;
+
+    if (out != RUN_QUIET && cpu->fetch.has_insn)
     {
-      print_stage_content("Instrn at Fetch_Stage-->", &cpu->fetch);
+      report_stage(cpu, out, STAGE_FETCH, &cpu->fetch);
     }
 
-    // Upon encountering HALT stop fetching new instructions
-    if ((cpu->fetch.opcode == OPCODE_HALT) || (cpu->fetch.opcode == OPCODE_HALT && !cpu->fetch.isStalled))
+    /* Upon encountering HALT stop fetching new instructions, once HALT has
+     * made it into D/RF; a stalled fetch still holds it */
+    if (cpu->fetch.opcode == OPCODE_HALT && !cpu->fetch.isStalled)
     {
       cpu->fetch.has_insn = FALSE;
     }
   }
+  else
+  {
+    /* Fetch only goes idle once HALT has been fetched */
+    cpu->counters.halt_drain++;
+  }
 }
 
 /*
- * Decode Stage of APEX Pipeline
- *
- * Note: You are free to edit this function according to your implementation
+ * Redirects fetch to the resolved target and squashes the wrong-path
+ * instruction behind the branch: the one in D/RF when the branch resolved
+ * in EX, a fetch held back by a stall when it resolved in D/RF
  */
 static void
-APEX_decode(APEX_CPU *cpu)
+take_branch(APEX_CPU *cpu, const CPU_Stage *branch, const int target)
 {
-  if (cpu->decode.has_insn)
+  CPU_Stage *wrong_path;
+
+  profile_at(cpu, branch->pc)->flushes++;
+
+  /* Calculate new PC, and send it to fetch unit */
+  cpu->pc = target;
+  if (target <= branch->pc)
   {
-    int New_rs1 = 0;
-    int New_rs2 = 0;
-    //Read operands from register file based on the instruction type
-    switch (cpu->decode.opcode)
-    {
-    case OPCODE_ADD:
-    case OPCODE_SUB:
-    case OPCODE_MUL:
-    case OPCODE_DIV:
-    case OPCODE_OR:
-    case OPCODE_AND:
-    case OPCODE_EXOR:
+    cpu->loop_probe = cpu->loop_accel || cpu->block_memo;
+  }
+
+  /* Since we are using reverse callbacks for pipeline stages,
+   * this will prevent the new instruction from being fetched in the current cycle*/
+  cpu->fetch_from_next_cycle = TRUE;
+
+  /* A wrong-path I-cache miss no longer holds fetch; its line stays filled */
+  cpu->fetch_wait = 0;
+
+  /* Flush previous stages */
+  if (branch == &cpu->execute)
+  {
+    wrong_path = cpu->decode.has_insn ? &cpu->decode : NULL;
+    cpu->decode.has_insn = FALSE;
+  }
+  else
+  {
+    wrong_path = cpu->fetch.isStalled ? &cpu->fetch : NULL;
+    cpu->fetch.isStalled = 0;
+  }
+
+  if (wrong_path)
+  {
+    cpu->counters.branch_flushes++;
+    if (cpu->timeline)
     {
-      // if we dont find sr/dest register and if we have load prior to the current ins then we stall the current ins
-      if(cpu->valid_bit[cpu->decode.rs1]){ //if src1 not avaiable then
-        New_rs1=1;
-      }else{New_rs1=0;}
+      APEX_timeline_flush(cpu->timeline, cpu->clock,
+                          wrong_path == &cpu->fetch ? STAGE_FETCH : STAGE_DECODE,
+                          wrong_path);
+    }
+  }
 
-      if(cpu->valid_bit[cpu->decode.rs2]){ //if src2 not avaiable then
-        New_rs2=1;
-      } else{New_rs2=0;}
+  /* Make sure fetch stage is enabled to start fetching from new PC */
+  cpu->fetch.has_insn = TRUE;
+}
 
-      // Default unisStalled
-      cpu->decode.isStalled = 0;
+/*
+ * Resolves a control transfer: fetch is redirected only when it went
+ * anywhere but the resolved next PC, and the predictor learns the outcome
+ * either way
+ */
+static void
+resolve_branch(APEX_CPU *cpu, const CPU_Stage *branch, const int conditional,
+               const int taken, const int target)
+{
+  const int next_pc = taken ? target : branch->pc + 4;
 
-      // if some previos instruction has marked the destination register invalid there is a posibility that you can get the value in the forwarded register
-      // if there is any forwarded sourse register in the file
-      if (New_rs1)  //if src1 is not avaiable then
-      {
-        //if your previous intruction was load and your current instruction is dependent on load then you stall
-        // because load cannot produce result until mem stage. So, you stall and send 1 cycle bubble in the pipeline
-        if ((strcmp(cpu->execute.opcode_str, "LOAD") == 0 || strcmp(cpu->execute.opcode_str, "LDI") == 0) && cpu->execute.rd == cpu->decode.rs1)
-        {
+  cpu->counters.branches++;
+  cpu->counters.branches_taken += taken;
+  APEX_bpred_train(&cpu->bpred, branch->pc, conditional, taken, target);
 
-          cpu->decode.isStalled = 1; //If yes to above conditions then stall the decode
-        }
-        else //if src1 is avilable
-        {
-          // if not then you pick from the data from forward register file
-          cpu->decode.rs1_value = cpu->forwardedDataBuffer[cpu->decode.rs1];
-          if (!strcmp(cpu->decode.opcode_str, "STORE")!= 0  && strcmp(cpu->decode.opcode_str, "CMP") != 0)
-          {
-            cpu->valid_bit[cpu->decode.rd] = 1;
-            cpu->fdata[cpu->decode.rd] = cpu->decode.pc;
-            cpu->execute = cpu->decode;
-          }
-        }
-      }
-      else
-      {
-        // if there is no forwarded register than you can pick from register file
-        cpu->decode.rs1_value = cpu->regs[cpu->decode.rs1];
-        if (strcmp(cpu->decode.opcode_str, "STORE") != 0 && strcmp(cpu->decode.opcode_str, "CMP") != 0)
-        {
-          cpu->valid_bit[cpu->decode.rd] = 1;
-          cpu->fdata[cpu->decode.rd] = cpu->decode.pc;
-          cpu->execute = cpu->decode;
-        }
-      }
+  if (next_pc != branch->pred_pc)
+  {
+    cpu->counters.mispredicts++;
+    take_branch(cpu, branch, next_pc);
+  }
+}
 
-      // Same comments for src2
-      if (New_rs2)
-      {
-        if ((strcmp(cpu->execute.opcode_str, "LOAD") == 0 || strcmp(cpu->execute.opcode_str, "LDI") == 0) && cpu->execute.rd == cpu->decode.rs2)
-        {
+/* Resolves the branch or JUMP held by a stage latch, in EX or D/RF */
+static void
+resolve_control(APEX_CPU *cpu, const CPU_Stage *branch)
+{
+  const int target = branch->pc + branch->imm;
 
-          cpu->decode.isStalled = 1;
-        }
-        else
-        {
-          cpu->decode.rs2_value = cpu->forwardedDataBuffer[cpu->decode.rs2];
-          if (!cpu->decode.isStalled && strcmp(cpu->decode.opcode_str, "STORE") != 0 && strcmp(cpu->decode.opcode_str, "CMP") != 0)
-          {
-            cpu->valid_bit[cpu->decode.rd] = 1;
-            cpu->fdata[cpu->decode.rd] = cpu->decode.pc;
-            cpu->execute = cpu->decode;
-          }
-        }
-      }
-      else
-      {
-        cpu->decode.rs2_value = cpu->regs[cpu->decode.rs2];
-        if (!cpu->decode.isStalled && strcmp(cpu->decode.opcode_str, "STORE") != 0 && strcmp(cpu->decode.opcode_str, "CMP") != 0)
-        {
-          cpu->valid_bit[cpu->decode.rd] = 1;
-          cpu->fdata[cpu->decode.rd] = cpu->decode.pc;
-          cpu->execute = cpu->decode;
-        }
-      }
-      cpu->execute = cpu->decode; /* Copy data from decode latch to execute latch*/
-      break;
-    }
+  switch (branch->opcode)
+  {
+  case OPCODE_BZ: //Branch if Zero
+    resolve_branch(cpu, branch, TRUE, cpu->zero_flag == TRUE, target);
+    break;
 
-    case OPCODE_ADDL: //1 src and 1dest and 1 literal
-    case OPCODE_SUBL:
-    {
+  case OPCODE_BNZ: //Branch if not Zero
+    resolve_branch(cpu, branch, TRUE, cpu->zero_flag == FALSE, target);
+    break;
 
-      // if we dont find sr/dest register and if we have load prior to the current ins then we stall the current ins
-      if(cpu->valid_bit[cpu->decode.rs1]){ //if src1 not avaiable then
-        New_rs1=1;
-      }else{New_rs1=0;}
+  case OPCODE_BP: //Branch if Positive
+    resolve_branch(cpu, branch, TRUE, cpu->pos_flag == TRUE, target);
+    break;
 
-      // Default unisStalled
-      cpu->decode.isStalled = 0;
+  case OPCODE_BNP: //Branch if not Positive
+    resolve_branch(cpu, branch, TRUE, cpu->pos_flag == FALSE, target);
+    break;
 
-      if (New_rs1)
-      {
-        if ((strcmp(cpu->execute.opcode_str, "LOAD") == 0 || strcmp(cpu->execute.opcode_str, "LDI") == 0) && cpu->execute.rd == cpu->decode.rs1)
-        {
-          cpu->decode.isStalled = 1;
-        }
-        else
-        {
-          cpu->decode.rs1_value = cpu->forwardedDataBuffer[cpu->decode.rs1];
-          cpu->valid_bit[cpu->decode.rd] = 1;
-          cpu->fdata[cpu->decode.rd] = cpu->decode.pc;
-          cpu->execute = cpu->decode;
-        }
-      }
-      else
-      {
-        cpu->decode.rs1_value = cpu->regs[cpu->decode.rs1];
-        cpu->valid_bit[cpu->decode.rd] = 1;
-        cpu->fdata[cpu->decode.rd] = cpu->decode.pc;
-        cpu->execute = cpu->decode;
-      }
-      break;
-    }
+  case OPCODE_JUMP: //It adds the literal to the source register address and then flushes out all other instruction in pipeline and fetches instruction to thw address where jump jumped to
+    resolve_branch(cpu, branch, FALSE, TRUE, branch->rs1_value + branch->imm);
+    break;
+  }
+}
 
-    case OPCODE_LOAD:
+/*
+ * With early resolution a conditional branch in D/RF takes the flags
+ * forwarded from EX, which has them only at the end of the cycle, so it
+ * waits while the flag producer is in EX. EX has already run this cycle
+ * and moved that instruction into the memory latch
+ */
+static inline int
+flags_in_execute(const APEX_CPU *cpu)
+{
+  return cpu->memory.has_insn && (cpu->memory.operands & OPND_SETS_FLAGS);
+}
+
+/* Registers written by the MUL and DIV instructions still in EX */
+static uint32_t
+fu_pending_dst(const APEX_CPU *cpu)
+{
+  uint32_t dst_mask = 0;
+  int i;
+
+  for (i = 0; i < FU_MAX_LATENCY; ++i)
+  {
+    if (cpu->fu_ring[i].has_insn)
     {
+      dst_mask |= cpu->fu_ring[i].dst_mask;
+    }
+  }
 
-      // if we dont find sr/dest register and if we have load prior to the current ins then we stall the current ins
-      if(cpu->valid_bit[cpu->decode.rs1]){ //if src1 not avaiable then
-        New_rs1=1;
-      }else{New_rs1=0;}
+  return dst_mask;
+}
 
-      // Default unisStalled
-      cpu->decode.isStalled = 0;
+/* Reads a source operand from the forwarding buffer when it has an
+ * in-flight writer, from the register file otherwise */
+static int
+read_source(APEX_CPU *cpu, const int reg)
+{
+  if (scoreboard_source(cpu, reg) == SB_SRC_REGFILE)
+  {
+    return cpu->regs[reg];
+  }
 
-      if (New_rs1)
+  cpu->counters.forwarded_operands++;
+  return cpu->forwardedDataBuffer[reg];
+}
+
+/*
+ * Decode Stage of APEX Pipeline
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+APEX_STAGE void
+APEX_decode(APEX_CPU *cpu, const int out, const int fwd)
+{
+  int stalled = FALSE;
+  uint32_t blocked;
+
+  if (cpu->decode.has_insn)
+  {
+    profile_at(cpu, cpu->decode.pc)->stage_cycles[STAGE_DECODE]++;
+
+    /* A source whose value the forwarding network cannot deliver yet (with
+     * full bypass, a load that just left EX or a MUL or DIV still in it)
+     * stalls for a cycle */
+    blocked = scoreboard_must_stall(&cpu->scoreboard, cpu->decode.src_mask,
+                                    cpu->pipe_clock, fwd);
+    if (blocked)
+    {
+      stalled = TRUE;
+      if (cpu->fu.in_flight && (blocked & fu_pending_dst(cpu)))
       {
-        if ((strcmp(cpu->execute.opcode_str, "LOAD") == 0 || strcmp(cpu->execute.opcode_str, "LDI") == 0) && cpu->execute.rd == cpu->decode.rs1)
-        {
-          cpu->decode.isStalled = 1;
-        }
-        else
-        {
-          cpu->decode.rs1_value = cpu->forwardedDataBuffer[cpu->decode.rs1];
-          cpu->valid_bit[cpu->decode.rd] = 1;
-          cpu->fdata[cpu->decode.rd] = cpu->decode.pc;
-          cpu->execute = cpu->decode;
-        }
+        cpu->counters.fu_result_stalls++;
       }
       else
       {
-        cpu->decode.rs1_value = cpu->regs[cpu->decode.rs1];
-        cpu->valid_bit[cpu->decode.rd] = 1;
-        cpu->fdata[cpu->decode.rd] = cpu->decode.pc;
-        cpu->execute = cpu->decode;
+        cpu->counters.data_stalls++;
       }
-      break;
     }
-
-    case OPCODE_CMP:
-    case OPCODE_STORE:
+    else if (cpu->branch_stage == STAGE_DECODE
+             && (cpu->decode.operands & OPND_READS_FLAGS)
+             && flags_in_execute(cpu))
     {
-      // if we dont find sr/dest register and if we have load prior to the current ins then we stall the current ins
-      if(cpu->valid_bit[cpu->decode.rs1]){ //if src1 not avaiable then
-        New_rs1=1;
-      }else{New_rs1=0;}
+      stalled = TRUE;
+      cpu->counters.flag_stalls++;
+    }
+    else if (fu_must_stall(&cpu->fu, cpu->decode.opcode, cpu->pipe_clock))
+    {
+      stalled = TRUE;
+      cpu->counters.fu_busy_stalls++;
+    }
 
-      if(cpu->valid_bit[cpu->decode.rs2]){ //if src2 not avaiable then
-        New_rs2=1;
-      } else{New_rs2=0;}
+    if (stalled)
+    {
+      cpu->decode.isStalled = 1;
+      profile_at(cpu, cpu->decode.pc)->stall_cycles++;
 
-      cpu->decode.isStalled = 0; //Default un Stalled
+      /* Send a bubble to EX */
+      cpu->execute.has_insn = FALSE;
+    }
+    else
+    {
+      cpu->decode.isStalled = 0;
 
-      if (New_rs1)
+      //Read operands from register file or forwarding buffer
+      if (cpu->decode.operands & OPND_RS1)
       {
-        if ((strcmp(cpu->execute.opcode_str, "LOAD") == 0 || strcmp(cpu->execute.opcode_str, "LDI") == 0) && cpu->execute.rd == cpu->decode.rs1)
-        {
-          cpu->decode.isStalled = 1;
-        }
-        else
-        {
-          cpu->decode.rs1_value = cpu->forwardedDataBuffer[cpu->decode.rs1];
-          cpu->execute = cpu->decode;
-        }
+        cpu->decode.rs1_value = read_source(cpu, cpu->decode.rs1);
       }
-      else
+      if (cpu->decode.operands & OPND_RS2)
       {
-        cpu->decode.rs1_value = cpu->regs[cpu->decode.rs1];
-        cpu->execute = cpu->decode;
+        cpu->decode.rs2_value = read_source(cpu, cpu->decode.rs2);
       }
 
-      if (New_rs2)
+      /* Early resolution: the branch or JUMP is done once it leaves D/RF
+       * and flows through EX without doing anything */
+      if (cpu->branch_stage == STAGE_DECODE
+          && (cpu->decode.operands & OPND_CONTROL))
       {
-        if ((strcmp(cpu->execute.opcode_str, "LOAD") == 0 || strcmp(cpu->execute.opcode_str, "LDI") == 0) && cpu->execute.rd == cpu->decode.rs2)
-        {
-          cpu->decode.isStalled = 1;
-        }
-        else
-        {
-          cpu->decode.rs2_value = cpu->forwardedDataBuffer[cpu->decode.rs2];
-          cpu->execute = cpu->decode;
-        }
+        resolve_control(cpu, &cpu->decode);
+        cpu->decode.resolved = TRUE;
       }
-      else
+
+      /* Become the youngest writer of the destination registers */
+      if (cpu->decode.dst_mask)
       {
-        cpu->decode.rs2_value = cpu->regs[cpu->decode.rs2];
-        cpu->execute = cpu->decode;
+        scoreboard_issue(cpu, cpu->decode.dst_mask, cpu->decode.tag);
       }
+      fu_issue(&cpu->fu, cpu->decode.opcode, cpu->pipe_clock);
 
+      /* Copy data from decode latch to execute latch*/
+      cpu->execute = cpu->decode;
+      cpu->decode.has_insn = FALSE;
+    }
 
-      break;
+    if (out != RUN_QUIET)
+    {
+      report_stage(cpu, out, STAGE_DECODE, &cpu->decode);
     }
+  }
+}
 
-    case OPCODE_BP:
-    case OPCODE_BNP:
-    case OPCODE_BZ:
-    case OPCODE_BNZ:
-    case OPCODE_NOP:
-    {
-      /* above instructions doesn't have register operands */
-      cpu->execute = cpu->decode;
-      break;
-    }
-
-    case OPCODE_LDI:
-    {
-      // if we dont find sr/dest register and if we have load prior to the current ins then we stall the current ins
-      if(cpu->valid_bit[cpu->decode.rs1]){ //if src1 not avaiable then
-        New_rs1=1;
-      }else{New_rs1=0;}
-
-      if(cpu->valid_bit[cpu->decode.rs2]){ //if src2 not avaiable then
-        New_rs2=1;
-      } else{New_rs2=0;}
-
-      // by default un Stalled
-      cpu->decode.isStalled = 0;
+/* Sets the zero flag based on the result buffer of the instruction in EX */
+static void
+set_zero_flag(APEX_CPU *cpu)
+{
+  if (cpu->execute.result_buffer == 0)
+  {
+    cpu->zero_flag = TRUE;
+  }
+  else
+  {
+    cpu->zero_flag = FALSE;
+  }
+}
 
-      if (New_rs1)
-      {
-        if ((strcmp(cpu->execute.opcode_str, "LOAD") == 0 || strcmp(cpu->execute.opcode_str, "LDI") == 0) && cpu->execute.rd == cpu->decode.rs1)
-        {
-          cpu->decode.isStalled = 1;
-        }
-        else
-        {
-          cpu->decode.rs1_value = cpu->forwardedDataBuffer[cpu->decode.rs1];
-          cpu->valid_bit[cpu->decode.rd] = 1;
-          cpu->fdata[cpu->decode.rd] = cpu->decode.pc;
-          cpu->execute = cpu->decode;
-        }
-      }
-      else
-      {
-        cpu->decode.rs1_value = cpu->regs[cpu->decode.rs1];
-        cpu->valid_bit[cpu->decode.rd] = 1;
-        cpu->fdata[cpu->decode.rd] = cpu->decode.pc;
-        cpu->execute = cpu->decode;
-      }
-      break;
-    }
+/*
+ * Execute handlers, one per opcode. The pre-decode pass in APEX_cpu_init
+ * stores the matching handler with every instruction, so EX calls it
+ * directly instead of switching on the opcode every cycle.
+ */
+static void
+exec_add(APEX_CPU *cpu)
+{ //Setting flag as its execution takes place in in EX stage
+  cpu->execute.result_buffer = cpu->execute.rs1_value + cpu->execute.rs2_value;
+  cpu->forwardedDataBuffer[cpu->execute.rd] = cpu->execute.result_buffer;
+  set_zero_flag(cpu);
+}
 
-    case OPCODE_STI:
-    {
-      // if we dont find sr/dest register and if we have load prior to the current ins then we stall the current ins
-      if(cpu->valid_bit[cpu->decode.rs1]){ //if src1 not avaiable then
-        New_rs1=1;
-      }else{New_rs1=0;}
+static void
+exec_addl(APEX_CPU *cpu)
+{
+  cpu->execute.result_buffer = cpu->execute.rs1_value + cpu->execute.imm;
+  cpu->forwardedDataBuffer[cpu->execute.rd] = cpu->execute.result_buffer;
+  set_zero_flag(cpu);
+}
 
-      if(cpu->valid_bit[cpu->decode.rs2]){ //if src2 not avaiable then
-        New_rs2=1;
-      } else{New_rs2=0;}
+static void
+exec_sub(APEX_CPU *cpu)
+{
+  cpu->execute.result_buffer = cpu->execute.rs1_value - cpu->execute.rs2_value;
+  cpu->forwardedDataBuffer[cpu->execute.rd] = cpu->execute.result_buffer;
+  set_zero_flag(cpu);
+}
 
-      // Default unisStalled
-      cpu->decode.isStalled = 0;
+static void
+exec_subl(APEX_CPU *cpu)
+{
+  cpu->execute.result_buffer = cpu->execute.rs1_value - cpu->execute.imm;
+  cpu->forwardedDataBuffer[cpu->execute.rd] = cpu->execute.result_buffer;
+  set_zero_flag(cpu);
+}
 
-      if (New_rs1)
-      {
-        if ((strcmp(cpu->execute.opcode_str, "LOAD") == 0 || strcmp(cpu->execute.opcode_str, "LDI") == 0) && cpu->execute.rd == cpu->decode.rs1)
-        {
-          cpu->decode.isStalled = 1;
-        }
-        else
-        {
-          cpu->decode.rs1_value = cpu->forwardedDataBuffer[cpu->decode.rs1];
-          cpu->valid_bit[cpu->decode.rs1] = 1; //setting dirty bit for 1st source register
-          //cpu->valid_bit[cpu->decode.rs2] = 1; //setting dirty bit for 2nd source register
-          cpu->fdata[cpu->decode.rs1] = cpu->decode.pc;
-          //cpu->fdata[cpu->decode.rs2] = cpu->decode.pc;
-          cpu->execute = cpu->decode;
-        }
-      }
-      else
-      {
-        cpu->decode.rs1_value = cpu->regs[cpu->decode.rs1];
-        cpu->valid_bit[cpu->decode.rs1] = 1; //setting dirty bit for 1st source register
-        //cpu->valid_bit[cpu->decode.rs2] = 1; //setting dirty bit for 2nd source register
-        cpu->fdata[cpu->decode.rs1] = cpu->decode.pc;
-        //cpu->fdata[cpu->decode.rs2] = cpu->decode.pc;
-        cpu->execute = cpu->decode;
-      }
+static void
+exec_mul(APEX_CPU *cpu)
+{
+  cpu->execute.result_buffer = cpu->execute.rs1_value * cpu->execute.rs2_value;
+  cpu->forwardedDataBuffer[cpu->execute.rd] = cpu->execute.result_buffer;
+  set_zero_flag(cpu);
+}
 
-      if (New_rs2)
-      {
-        if ((strcmp(cpu->execute.opcode_str, "LOAD") == 0 || strcmp(cpu->execute.opcode_str, "LDI") == 0) && cpu->execute.rd == cpu->decode.rs2)
-        {
-          cpu->decode.isStalled = 1;
-        }
-        else
-        {
-          cpu->decode.rs2_value = cpu->forwardedDataBuffer[cpu->decode.rs2];
-          cpu->valid_bit[cpu->decode.rs2] = 1; //setting dirty bit for 2nd source register
-          cpu->fdata[cpu->decode.rs2] = cpu->decode.pc;          
-          cpu->execute = cpu->decode;
-        }
-      }
-      else
-      {
-        cpu->decode.rs2_value = cpu->regs[cpu->decode.rs2];
-        cpu->valid_bit[cpu->decode.rs2] = 1; //setting dirty bit for 2nd source register
-        cpu->fdata[cpu->decode.rs2] = cpu->decode.pc;
-        cpu->execute = cpu->decode;
-      }
-      break;
-    }
+static void
+exec_div(APEX_CPU *cpu)
+{
+  cpu->execute.result_buffer = fu_divide(cpu->execute.rs1_value,
+                                         cpu->execute.rs2_value);
+  cpu->forwardedDataBuffer[cpu->execute.rd] = cpu->execute.result_buffer;
+  set_zero_flag(cpu);
+}
 
-  case OPCODE_MOVC: //dest but no source
-    {
-      if (!cpu->decode.isStalled) //if decode is not stalled
-      { 
-        cpu->valid_bit[cpu->decode.rd] = 1;
-        cpu->fdata[cpu->decode.rd] = cpu->decode.pc;
-        //cpu->decode.isStalled = 1; //stall decode
-
-        /* Copy data from decode latch to execute latch*/
-        cpu->execute = cpu->decode;
-      }
-     else {
-      cpu->decode.isStalled=1;  
-        }
-    break;
-    }
+static void
+exec_and(APEX_CPU *cpu)
+{
+  cpu->execute.result_buffer = cpu->execute.rs1_value & cpu->execute.rs2_value;
+  cpu->forwardedDataBuffer[cpu->execute.rd] = cpu->execute.result_buffer;
+  set_zero_flag(cpu);
+}
 
-    case OPCODE_JUMP:
-    {
-      // if we dont find sr/dest register and if we have load prior to the current ins then we stall the current ins
-      if(cpu->valid_bit[cpu->decode.rs1]){ //if src1 not avaiable then
-        New_rs1=1;
-      }else{New_rs1=0;}
+static void
+exec_or(APEX_CPU *cpu)
+{
+  cpu->execute.result_buffer = cpu->execute.rs1_value | cpu->execute.rs2_value;
+  cpu->forwardedDataBuffer[cpu->execute.rd] = cpu->execute.result_buffer;
+  set_zero_flag(cpu);
+}
 
-      if (New_rs1)
-      {
-        if ((strcmp(cpu->execute.opcode_str, "LOAD") == 0 || strcmp(cpu->execute.opcode_str, "LDI") == 0) && cpu->execute.rd == cpu->decode.rs1)
-        {
-          cpu->decode.isStalled = 1;
-        }
-        else
-        {
-          cpu->decode.rs1_value = cpu->forwardedDataBuffer[cpu->decode.rs1];
-          cpu->execute = cpu->decode;
-        }
-      }
-      else
-      {
-        cpu->decode.rs1_value = cpu->regs[cpu->decode.rs1];
-        cpu->execute = cpu->decode; 
-      }
-      break;
-    }
+static void
+exec_exor(APEX_CPU *cpu)
+{
+  cpu->execute.result_buffer = cpu->execute.rs1_value ^ cpu->execute.rs2_value;
+  cpu->forwardedDataBuffer[cpu->execute.rd] = cpu->execute.result_buffer;
+  set_zero_flag(cpu);
+}
 
-    case OPCODE_HALT:
-    {
-      cpu->decode.isStalled = 0; //If remains in stall then un stall
-      /* Copy data from decode latch to execute latch*/
-      cpu->execute = cpu->decode;
-      cpu->decode.has_insn = FALSE;
-      break;
-    }
+static void
+exec_movc(APEX_CPU *cpu)
+{
+  //It does not execute anything just move literal to specified destination
+  cpu->execute.result_buffer = cpu->execute.imm;
+  cpu->forwardedDataBuffer[cpu->execute.rd] = cpu->execute.result_buffer;
+  set_zero_flag(cpu);
+}
 
-      //Switch case ends
-    }
+static void
+exec_load(APEX_CPU *cpu)
+{
+  //As its execution takes place in memeory and not in EX stage
+  cpu->execute.memory_address = cpu->execute.rs1_value + cpu->execute.imm;
+}
 
-    if (!cpu->decode.isStalled) //when decode is not stalled
-    {
-      /* Copy data from decode latch to execute latch*/
-      cpu->decode.has_insn = TRUE;
-      cpu->execute = cpu->decode;
-      cpu->decode.has_insn = FALSE;
-    }
-    else //when decode is stalled
-    {
-      cpu->execute = cpu->decode;
-      //cpu->execute.opcode = NOP;
-      //strcpy(cpu->execute.opcode_str, " ");
-    }
+static void
+exec_store(APEX_CPU *cpu)
+{ //Store will store the addition of src register and lietral in mem
+  cpu->execute.memory_address = cpu->execute.rs2_value + cpu->execute.imm;
+}
 
-    if (ENABLE_DEBUG_MESSAGES)
-    {
-      print_stage_content("Instrn at Decode/RF_Stage-->", &cpu->decode);
-    }
-  }
+static void
+exec_ldi(APEX_CPU *cpu)
+{
+  cpu->execute.result_buffer = cpu->execute.rs1_value + cpu->execute.imm;
+  cpu->execute.memory_address = cpu->execute.result_buffer;
+  cpu->execute.resetting_buffer = cpu->execute.rs1_value + 4;
+  cpu->forwardedDataBuffer[cpu->execute.rs1] = cpu->execute.resetting_buffer;
+  set_zero_flag(cpu);
 }
 
-/*
-     * Execute Stage of APEX Pipeline
-     *
-     * Note: You are free to edit this function according to your implementation
-     */
 static void
-APEX_execute(APEX_CPU *cpu)
+exec_sti(APEX_CPU *cpu)
 {
-  if (cpu->execute.has_insn)
+  cpu->execute.result_buffer = cpu->execute.rs1_value + cpu->execute.imm;
+  cpu->execute.memory_address = cpu->execute.result_buffer;
+  cpu->execute.resetting_buffer = cpu->execute.rs1_value + 4;
+  cpu->forwardedDataBuffer[cpu->execute.rs1] = cpu->execute.resetting_buffer;
+  /* Set the zero flag based on the result buffer */
+  if (cpu->execute.result_buffer == 0)
   {
-    /* Execute logic based on instruction type */
-    switch (cpu->execute.opcode)
-    {
-    case OPCODE_ADD:
-    { //Setting flag as its execution takes place in in EX stage
-      cpu->execute.result_buffer = cpu->execute.rs1_value + cpu->execute.rs2_value;
-      cpu->forwardedDataBuffer[cpu->execute.rd] = cpu->execute.result_buffer;
-      /* Set the zero flag based on the result buffer */
-      if (cpu->execute.result_buffer == 0)
-      {
-        cpu->zero_flag = TRUE;
-      }
-      else
-      {
-        cpu->zero_flag = FALSE;
-      }
-      break;
-    }
+    cpu->zero_flag = TRUE;
+  }
+  else
+  {
+    cpu->pos_flag = TRUE;
+  }
+}
 
-    case OPCODE_ADDL: //Setting flag as its execution takes place in in EX stage
-    {
-      cpu->execute.result_buffer = cpu->execute.rs1_value + cpu->execute.imm;
-      cpu->forwardedDataBuffer[cpu->execute.rd] = cpu->execute.result_buffer;
-      /* Set the zero flag based on the result buffer */
-      if (cpu->execute.result_buffer == 0)
-      {
-        cpu->zero_flag = TRUE;
-      }
-      else
-      {
-        cpu->zero_flag = FALSE;
-      }
-      break;
-    }
+static void
+exec_branch(APEX_CPU *cpu)
+{ //BZ, BNZ, BP, BNP and JUMP, unless D/RF has resolved it already
+  if (!cpu->execute.resolved)
+  {
+    resolve_control(cpu, &cpu->execute);
+  }
+}
 
-    case OPCODE_SUB:
-    { //Setting flag as its execution takes place in in EX stage
-      cpu->execute.result_buffer = cpu->execute.rs1_value - cpu->execute.rs2_value;
-      cpu->forwardedDataBuffer[cpu->execute.rd] = cpu->execute.result_buffer;
-      /* Set the zero flag based on the result buffer */
-      if (cpu->execute.result_buffer == 0)
-      {
-        cpu->zero_flag = TRUE;
-      }
-      else
-      {
-        cpu->zero_flag = FALSE;
-      }
-      break;
-    }
+static void
+exec_cmp(APEX_CPU *cpu)
+{ //Compares the src registers in execute stage and sets flag accordingly
+  if (cpu->execute.rs1_value == cpu->execute.rs2_value)
+  {
+    cpu->zero_flag = TRUE;
+  }
+  else
+  {
+    cpu->zero_flag = FALSE;
+  }
+  if (cpu->execute.rs1_value > cpu->execute.rs2_value)
+  {
+    cpu->pos_flag = TRUE;
+  }
+  else
+  {
+    cpu->pos_flag = FALSE;
+  }
+}
 
-    case OPCODE_SUBL:
-    { //Setting flag as its execution takes place in in EX stage
-      cpu->execute.result_buffer = cpu->execute.rs1_value - cpu->execute.imm;
-      cpu->forwardedDataBuffer[cpu->execute.rd] = cpu->execute.result_buffer;
-      /* Set the zero flag based on the result buffer */
-      if (cpu->execute.result_buffer == 0)
-      {
-        cpu->zero_flag = TRUE;
-      }
-      else
-      {
-        cpu->zero_flag = FALSE;
-      }
-      break;
-    }
+static void
+exec_nop(APEX_CPU *cpu)
+{ //no part in execution, HALT also just flows through to memory
+  (void)cpu;
+}
 
-    case OPCODE_MUL:
-    { //Setting flag as its execution takes place in in EX stage
-      cpu->execute.result_buffer = cpu->execute.rs1_value * cpu->execute.rs2_value;
-      cpu->forwardedDataBuffer[cpu->execute.rd] = cpu->execute.result_buffer;
-      /* Set the zero flag based on the result buffer */
-      if (cpu->execute.result_buffer == 0)
-      {
-        cpu->zero_flag = TRUE;
-      }
-      else
-      {
-        cpu->zero_flag = FALSE;
-      }
-      break;
-    }
+/* Execute handler for every numeric opcode, indexed by OPCODE_* */
+static const APEX_Exec_Handler exec_handlers[] = {
+    [OPCODE_ADD] = exec_add,
+    [OPCODE_SUB] = exec_sub,
+    [OPCODE_MUL] = exec_mul,
+    [OPCODE_DIV] = exec_div,
+    [OPCODE_AND] = exec_and,
+    [OPCODE_OR] = exec_or,
+    [OPCODE_EXOR] = exec_exor,
+    [OPCODE_MOVC] = exec_movc,
+    [OPCODE_LOAD] = exec_load,
+    [OPCODE_STORE] = exec_store,
+    [OPCODE_BZ] = exec_branch,
+    [OPCODE_BNZ] = exec_branch,
+    [OPCODE_HALT] = exec_nop,
+    [OPCODE_ADDL] = exec_addl,
+    [OPCODE_SUBL] = exec_subl,
+    [OPCODE_JUMP] = exec_branch,
+    [OPCODE_LDI] = exec_ldi,
+    [OPCODE_STI] = exec_sti,
+    [OPCODE_NOP] = exec_nop,
+    [OPCODE_BP] = exec_branch,
+    [OPCODE_BNP] = exec_branch,
+    [OPCODE_CMP] = exec_cmp,
+};
+
+/* Registers read and written and flag and control use of every numeric
+ * opcode, indexed by OPCODE_* */
+static const uint8_t opcode_operands[] = {
+    [OPCODE_ADD] = OPND_RS1 | OPND_RS2 | OPND_RD | OPND_SETS_FLAGS,
+    [OPCODE_SUB] = OPND_RS1 | OPND_RS2 | OPND_RD | OPND_SETS_FLAGS,
+    [OPCODE_MUL] = OPND_RS1 | OPND_RS2 | OPND_RD | OPND_SETS_FLAGS,
+    [OPCODE_DIV] = OPND_RS1 | OPND_RS2 | OPND_RD | OPND_SETS_FLAGS,
+    [OPCODE_AND] = OPND_RS1 | OPND_RS2 | OPND_RD | OPND_SETS_FLAGS,
+    [OPCODE_OR] = OPND_RS1 | OPND_RS2 | OPND_RD | OPND_SETS_FLAGS,
+    [OPCODE_EXOR] = OPND_RS1 | OPND_RS2 | OPND_RD | OPND_SETS_FLAGS,
+    [OPCODE_MOVC] = OPND_RD | OPND_SETS_FLAGS,
+    [OPCODE_LOAD] = OPND_RS1 | OPND_RD | OPND_RD_MEM,
+    [OPCODE_STORE] = OPND_RS1 | OPND_RS2,
+    [OPCODE_BZ] = OPND_READS_FLAGS | OPND_CONTROL,
+    [OPCODE_BNZ] = OPND_READS_FLAGS | OPND_CONTROL,
+    [OPCODE_ADDL] = OPND_RS1 | OPND_RD | OPND_SETS_FLAGS,
+    [OPCODE_SUBL] = OPND_RS1 | OPND_RD | OPND_SETS_FLAGS,
+    [OPCODE_JUMP] = OPND_RS1 | OPND_CONTROL,
+    [OPCODE_LDI] = OPND_RS1 | OPND_RD | OPND_RD_MEM | OPND_RS1_DST | OPND_SETS_FLAGS,
+    [OPCODE_STI] = OPND_RS1 | OPND_RS2 | OPND_RS1_DST | OPND_SETS_FLAGS,
+    [OPCODE_BP] = OPND_READS_FLAGS | OPND_CONTROL,
+    [OPCODE_BNP] = OPND_READS_FLAGS | OPND_CONTROL,
+    [OPCODE_CMP] = OPND_RS1 | OPND_RS2 | OPND_SETS_FLAGS,
+};
 
-    case OPCODE_AND:
-    { //Setting flag as its execution takes place in in EX stage
-      cpu->execute.result_buffer = cpu->execute.rs1_value & cpu->execute.rs2_value;
-      /* Set the zero flag based on the result buffer */
-      cpu->forwardedDataBuffer[cpu->execute.rd] = cpu->execute.result_buffer;
-      if (cpu->execute.result_buffer == 0)
-      {
-        cpu->zero_flag = TRUE;
-      }
-      else
-      {
-        cpu->zero_flag = FALSE;
-      }
-      break;
-    }
+/*
+ * Pre-decode pass: resolves every instruction in code memory to its execute
+ * handler, operand slots and scoreboard masks once, at load time
+ */
+APEX_Decoded_Insn *
+APEX_predecode(const APEX_Instruction *code_memory, const int size)
+{
+  int i;
+  APEX_Decoded_Insn *decoded;
 
-    case OPCODE_OR:
-    { //Setting flag as its execution takes place in in EX stage
-      cpu->execute.result_buffer = cpu->execute.rs1_value | cpu->execute.rs2_value;
-      cpu->forwardedDataBuffer[cpu->execute.rd] = cpu->execute.result_buffer;
-      /* Set the zero flag based on the result buffer */
-      if (cpu->execute.result_buffer == 0)
-      {
-        cpu->zero_flag = TRUE;
-      }
-      else
-      {
-        cpu->zero_flag = FALSE;
-      }
-      break;
-    }
+  decoded = calloc(size, sizeof(APEX_Decoded_Insn));
+  if (!decoded)
+  {
+    return NULL;
+  }
 
-    case OPCODE_EXOR:
+  for (i = 0; i < size; ++i)
+  {
+    decoded[i].insn = code_memory[i];
+    if (code_memory[i].opcode < sizeof(opcode_operands))
     {
-      //Setting flag as its execution takes place in in EX stage
-      cpu->execute.result_buffer = cpu->execute.rs1_value ^ cpu->execute.rs2_value;
-      cpu->forwardedDataBuffer[cpu->execute.rd] = cpu->execute.result_buffer;
-      /* Set the zero flag based on the result buffer */
-      if (cpu->execute.result_buffer == 0)
-      {
-        cpu->zero_flag = TRUE;
-      }
-      else
-      {
-        cpu->zero_flag = FALSE;
-      }
-      break;
+      decoded[i].operands = opcode_operands[code_memory[i].opcode];
     }
-
-    case OPCODE_LOAD:
+    if (decoded[i].operands & OPND_RS1)
     {
-      //As its execution takes place in memeory and not in EX stage
-      cpu->execute.memory_address = cpu->execute.rs1_value + cpu->execute.imm;
-      break;
+      decoded[i].src_mask |= REG_BIT(code_memory[i].rs1);
     }
-
-    case OPCODE_BZ: //set branch if not set before. Upon again encountered it will flush the instructions
-    {               //Branch if not Zero
-      if (cpu->zero_flag == TRUE)
-      {
-        /* Calculate new PC, and send it to fetch unit */
-        cpu->pc = cpu->execute.pc + cpu->execute.imm;
-
-        /* Since we are using reverse callbacks for pipeline stages, 
-             * this will prevent the new instruction from being fetched in the current cycle*/
-        cpu->fetch_from_next_cycle = TRUE;
-
-        /* Flush previous stages */
-    
-        cpu->decode.has_insn = FALSE;
-
-        /* Make sure fetch stage is enabled to start fetching from new PC */
-        cpu->fetch.has_insn = TRUE;
-      }
-      break;
+    if (decoded[i].operands & OPND_RS2)
+    {
+      decoded[i].src_mask |= REG_BIT(code_memory[i].rs2);
     }
-
-    case OPCODE_BNZ: //set branch if not set before. Upon again encountered it will flush the instructions
-    {                //Branch if not Zero
-      if (cpu->zero_flag == FALSE)
+    if (decoded[i].operands & OPND_RD)
+    {
+      decoded[i].dst_mask |= REG_BIT(code_memory[i].rd);
+      if (decoded[i].operands & OPND_RD_MEM)
       {
-        /* Calculate new PC, and send it to fetch unit */
-        cpu->pc = cpu->execute.pc + cpu->execute.imm;
-
-        /* Since we are using reverse callbacks for pipeline stages, 
-             * this will prevent the new instruction from being fetched in the current cycle*/
-        cpu->fetch_from_next_cycle = TRUE;
-
-        /* Flush previous stages */
-        cpu->decode.has_insn = FALSE;
-
-        /* Make sure fetch stage is enabled to start fetching from new PC */
-        cpu->fetch.has_insn = TRUE;
+        decoded[i].late_mask |= REG_BIT(code_memory[i].rd);
       }
-      break;
     }
-
-    case OPCODE_BP: //set branch if not set before. Upon again encountered it will flush the instructions
-    {               //Branch if Positive
-      if (cpu->pos_flag == TRUE)
-      {
-        /* Calculate new PC, and send it to fetch unit */
-        cpu->pc = cpu->execute.pc + cpu->execute.imm;
-
-        /* Since we are using reverse callbacks for pipeline stages, 
-             * this will prevent the new instruction from being fetched in the current cycle*/
-        cpu->fetch_from_next_cycle = TRUE;
-
-        /* Flush previous stages */
-        cpu->decode.has_insn = FALSE;
-
-        /* Make sure fetch stage is enabled to start fetching from new PC */
-        cpu->fetch.has_insn = TRUE;
-      }
-      break;
+    if (decoded[i].operands & OPND_RS1_DST)
+    {
+      decoded[i].dst_mask |= REG_BIT(code_memory[i].rs1);
     }
-
-    case OPCODE_BNP: //set branch if not set before. Upon again encountered it will flush the instructions
-    {                //Branch if not Positive
-      if (cpu->pos_flag == FALSE)
-      {
-        /* Calculate new PC, and send it to fetch unit */
-        cpu->pc = cpu->execute.pc + cpu->execute.imm;
-
-        /* Since we are using reverse callbacks for pipeline stages, 
-             * this will prevent the new instruction from being fetched in the current cycle*/
-        cpu->fetch_from_next_cycle = TRUE;
-
-        /* Flush previous stages */
-        cpu->decode.has_insn = FALSE;
-        /* Make sure fetch stage is enabled to start fetching from new PC */
-        cpu->fetch.has_insn = TRUE;
-      }
-      break;
+    if (code_memory[i].opcode < sizeof(exec_handlers) / sizeof(exec_handlers[0]))
+    {
+      decoded[i].exec = exec_handlers[code_memory[i].opcode];
     }
-
-    case OPCODE_MOVC:
+    if (!decoded[i].exec)
     {
-      //It does not execute anything just move literal to specified destination
-      cpu->execute.result_buffer = cpu->execute.imm;
-      cpu->forwardedDataBuffer[cpu->execute.rd] = cpu->execute.result_buffer;
-      if (cpu->execute.result_buffer == 0)
-     {   
-      cpu->zero_flag = TRUE;
-     } 
-     else 
-     {
-     cpu->zero_flag = FALSE;
-     }
-      break;
+      decoded[i].exec = exec_nop;
     }
+  }
 
-    case OPCODE_LDI:
+  return decoded;
+}
+
+/*
+     * Execute Stage of APEX Pipeline
+     *
+     * Note: You are free to edit this function according to your implementation
+     */
+APEX_STAGE void
+APEX_execute(APEX_CPU *cpu, const int out)
+{
+  CPU_Stage *slot;
+  int latency;
+
+  /* A MUL or DIV taking more than a cycle waits in the completion slot of
+   * the cycle it leaves EX in; D/RF made sure nothing else completes then */
+  if (cpu->execute.has_insn)
+  {
+    latency = fu_latency(&cpu->fu, cpu->execute.opcode);
+    if (latency > 1)
     {
-      cpu->execute.result_buffer = cpu->execute.rs1_value + cpu->execute.imm;
-      cpu->execute.resetting_buffer = cpu->execute.rs1_value + 4;
-      /* Set the zero flag based on the result buffer */
-      if (cpu->execute.result_buffer == 0)
-      {
-        cpu->zero_flag = TRUE;
-      }
-      else
-      {
-        cpu->zero_flag = FALSE;
-      }
-      break;
+      cpu->fu_ring[(cpu->pipe_clock + latency - 1) % FU_MAX_LATENCY] = cpu->execute;
+      cpu->fu.in_flight++;
+      cpu->execute.has_insn = FALSE;
     }
+  }
 
-    case OPCODE_STI:
+  if (cpu->fu.in_flight && !cpu->execute.has_insn)
+  {
+    slot = &cpu->fu_ring[cpu->pipe_clock % FU_MAX_LATENCY];
+    if (slot->has_insn)
     {
-      cpu->execute.result_buffer = cpu->execute.rs1_value + cpu->execute.imm;
-      cpu->execute.resetting_buffer = cpu->execute.rs1_value + 4;
-      /* Set the zero flag based on the result buffer */
-      if (cpu->execute.result_buffer == 0)
-      {
-        cpu->zero_flag = TRUE;
-      }
-      else
-      {
-        cpu->pos_flag = TRUE;
-      }
-      break;
+      cpu->execute = *slot;
+      slot->has_insn = FALSE;
+      cpu->fu.in_flight--;
     }
+  }
 
-    case OPCODE_NOP:
-    { //no part in execution
-      break;
-    }
+  if (cpu->execute.has_insn)
+  {
+    profile_at(cpu, cpu->execute.pc)->stage_cycles[STAGE_EXECUTE] +=
+        fu_latency(&cpu->fu, cpu->execute.opcode);
 
-    case OPCODE_JUMP:
-    { //It adds the literal to the source register address and then flushes out all other instruction in pipeline and fetches instruction to thw address where jump jumped to
-      cpu->pc = cpu->execute.rs1_value + cpu->execute.imm;
-      cpu->fetch.has_insn = TRUE;
-      cpu->fetch_from_next_cycle = TRUE;
-      cpu->decode.has_insn = FALSE;
-      break;
+    if (out == RUN_QUIET && cpu->loop_recording)
+    {
+      APEX_loop_record(cpu->loop, cpu->execute.pc);
     }
 
-    case OPCODE_CMP:
-    { //Compares the src registers in execute stage and sets flag accordingly
-      if (cpu->execute.rs1_value == cpu->execute.rs2_value)
-      {
-        cpu->zero_flag = TRUE;
-      }
-      else{
-        cpu->zero_flag = FALSE;
-      }
-      if(cpu->execute.rs1_value > cpu->execute.rs2_value)
-                        {
-                             cpu->pos_flag = TRUE;
-                        }
-                        else
-                        {
-                             cpu->pos_flag = FALSE;
-                        }
-      break;
-    }
-    
-    case OPCODE_HALT:
-    { 
-      cpu->memory = cpu->execute;
-      cpu->execute.has_insn = FALSE;
-      break;
-    }
+    /* Execute logic based on instruction type */
+    cpu->execute.exec(cpu);
+    scoreboard_produce(cpu, cpu->execute.dst_mask & ~cpu->execute.late_mask,
+                       cpu->execute.tag, STAGE_EXECUTE);
 
-    case OPCODE_STORE:
-    { //Store will store the addition of src register and lietral in mem
-      cpu->execute.memory_address = cpu->execute.rs2_value + cpu->execute.imm;
-      break;
-    }
-    }
-   
     /* Copy data from execute latch to memory latch*/
     cpu->execute.has_insn = TRUE;
     cpu->memory = cpu->execute;
     cpu->execute.has_insn = FALSE;
 
-    if (ENABLE_DEBUG_MESSAGES)
+    if (out != RUN_QUIET)
     {
-      print_stage_content("Instrn at Execute_STAGE-->", &cpu->execute);
+      report_stage(cpu, out, STAGE_EXECUTE, &cpu->execute);
     }
   }
 }
 
+/*
+ * Charges a data access to the D-cache. An access longer than a cycle
+ * freezes the whole pipeline for the rest of it, like a blocking cache
+ */
+static inline void
+dcache_access(APEX_CPU *cpu, const int address, const int write)
+{
+  if (cpu->dcache.config.size)
+  {
+    cpu->mem_wait = APEX_cache_access(&cpu->dcache, address, write) - 1;
+    profile_at(cpu, cpu->memory.pc)->stage_cycles[STAGE_MEMORY] += cpu->mem_wait;
+  }
+}
+
+/* Records an access outside the data address space; the run stops once
+ * the cycle is over */
+static void
+memory_fault(APEX_CPU *cpu)
+{
+  cpu->fault = TRUE;
+  cpu->fault_fetch = FALSE;
+  cpu->fault_address = cpu->memory.memory_address;
+  cpu->fault_pc = cpu->memory.pc;
+  cpu->fault_cycle = cpu->clock;
+}
+
+/* Reads the data word of the load in MEM and forwards it */
+static inline void
+load_word(APEX_CPU *cpu)
+{
+  if (!APEX_mem_read(&cpu->data_memory, cpu->memory.memory_address,
+                     &cpu->memory.result_buffer))
+  {
+    memory_fault(cpu);
+    return;
+  }
+  cpu->forwardedDataBuffer[cpu->memory.rd] = cpu->memory.result_buffer;
+  dcache_access(cpu, cpu->memory.memory_address, FALSE);
+}
+
+/* Writes value to the data word of the store in MEM */
+static inline void
+store_word(APEX_CPU *cpu, const int value)
+{
+  if (!APEX_mem_write(&cpu->data_memory, cpu->memory.memory_address, value))
+  {
+    memory_fault(cpu);
+    return;
+  }
+  dcache_access(cpu, cpu->memory.memory_address, TRUE);
+}
+
 /*
      * Memory Stage of APEX Pipeline
      *
      * Note: You are free to edit this function according to your implementation
      */
-static void
-APEX_memory(APEX_CPU *cpu)
+APEX_STAGE void
+APEX_memory(APEX_CPU *cpu, const int out)
 {
   if (cpu->memory.has_insn)
   {
+    profile_at(cpu, cpu->memory.pc)->stage_cycles[STAGE_MEMORY]++;
+
     switch (cpu->memory.opcode)
     {
     case OPCODE_ADD:
@@ -1055,41 +963,42 @@ APEX_memory(APEX_CPU *cpu)
     case OPCODE_LOAD:
     {
       /* Read from data memory */
-      cpu->memory.result_buffer = cpu->data_memory[cpu->memory.memory_address];
-      cpu->forwardedDataBuffer[cpu->memory.rd] = cpu->memory.result_buffer;
+      load_word(cpu);
       break;
     }
 
     case OPCODE_STORE:
     {
       /* write data to memory */
-      cpu->data_memory[cpu->memory.memory_address] = cpu->memory.rs1_value;
+      store_word(cpu, cpu->memory.rs1_value);
       break;
     }
 
     case OPCODE_LDI:
     {
       /* Read from data memory */
-      cpu->memory.result_buffer = cpu->data_memory[cpu->memory.memory_address];
-      cpu->forwardedDataBuffer[cpu->execute.rd] = cpu->execute.result_buffer;
+      load_word(cpu);
       break;
     }
 
     case OPCODE_STI:
     {
       /* write data to memory */
-      cpu->data_memory[cpu->memory.memory_address] = cpu->memory.rs2_value;
+      store_word(cpu, cpu->memory.rs2_value);
       break;
     }
     }
 
+    scoreboard_produce(cpu, cpu->memory.late_mask, cpu->memory.tag,
+                       STAGE_MEMORY);
+
     /* Copy data from memory latch to writeback latch*/
     cpu->writeback = cpu->memory;
     cpu->memory.has_insn = FALSE;
 
-    if (ENABLE_DEBUG_MESSAGES)
+    if (out != RUN_QUIET)
     {
-      print_stage_content("Instrn at MEMORY_STAGE-->", &cpu->memory);
+      report_stage(cpu, out, STAGE_MEMORY, &cpu->memory);
     }
   }
 }
@@ -1100,11 +1009,13 @@ APEX_memory(APEX_CPU *cpu)
      *
      * Note: You are free to edit this function according to your implementation
      */
-static int
-APEX_writeback(APEX_CPU *cpu)
+APEX_STAGE int
+APEX_writeback(APEX_CPU *cpu, const int out)
 {
   if (cpu->writeback.has_insn)
   {
+    profile_at(cpu, cpu->writeback.pc)->stage_cycles[STAGE_WRITEBACK]++;
+
     /* Write result to register file based on instruction type */
     switch (cpu->writeback.opcode)
     {
@@ -1113,6 +1024,7 @@ APEX_writeback(APEX_CPU *cpu)
     case OPCODE_SUB:
     case OPCODE_SUBL:
     case OPCODE_MUL:
+    case OPCODE_DIV:
     case OPCODE_AND:
     case OPCODE_OR:
     case OPCODE_EXOR:
@@ -1120,36 +1032,19 @@ APEX_writeback(APEX_CPU *cpu)
     case OPCODE_MOVC:
     {
       cpu->regs[cpu->writeback.rd] = cpu->writeback.result_buffer;
-      if (cpu->fdata[cpu->writeback.rd] == cpu->writeback.pc)
-      {
-        cpu->valid_bit[cpu->writeback.rd] = 0;
-      }
       break;
     }
 
     case OPCODE_LDI:
     {
       cpu->regs[cpu->writeback.rd] = cpu->writeback.result_buffer;
-      cpu->regs[cpu->writeback.rs1_value] = cpu->writeback.resetting_buffer;
-      if (cpu->fdata[cpu->writeback.rd] == cpu->writeback.pc)
-      {
-        cpu->valid_bit[cpu->writeback.rd] = 0;
-      }
-      if (cpu->fdata[cpu->writeback.rs1] == cpu->writeback.pc)
-      {
-        cpu->valid_bit[cpu->writeback.rs1] = 0;
-      }
+      cpu->regs[cpu->writeback.rs1] = cpu->writeback.resetting_buffer;
       break;
     }
     
     case OPCODE_STI:
     {
-     cpu->regs[cpu->writeback.rs1_value] = cpu->writeback.resetting_buffer;
-      if (cpu->fdata[cpu->writeback.rs1] == cpu->writeback.pc)
-      {
-        cpu->valid_bit[cpu->writeback.rs1] = 0;
-        cpu->valid_bit[cpu->writeback.rs2] = 0;
-      }
+      cpu->regs[cpu->writeback.rs1] = cpu->writeback.resetting_buffer;
       break;
     }
     case OPCODE_CMP:
@@ -1176,27 +1071,162 @@ APEX_writeback(APEX_CPU *cpu)
       cpu->decode.isStalled = 0; //If remains in stall then un stall and then HALT the CPU
       cpu->writeback.has_insn = FALSE;
     }
-    if (ENABLE_DEBUG_MESSAGES)
+    if (out != RUN_QUIET)
     {
-      print_stage_content("Instrn at WRITEBACK_Stage-->", &cpu->writeback);
+      report_stage(cpu, out, STAGE_WRITEBACK, &cpu->writeback);
     }
 
       return TRUE;
     }
   }
+    /* Release the destination registers unless a younger writer owns them */
+    scoreboard_retire(cpu, cpu->writeback.dst_mask, cpu->writeback.tag);
+
     cpu->insn_completed++;
+    cpu->counters.retired[cpu->writeback.opcode]++;
+    profile_at(cpu, cpu->writeback.pc)->retired++;
     cpu->writeback.has_insn = FALSE;
 
-    if (ENABLE_DEBUG_MESSAGES)
+    if (out != RUN_QUIET)
     {
-      print_stage_content("Instrn at WRITEBACK_Stage-->", &cpu->writeback);
+      report_stage(cpu, out, STAGE_WRITEBACK, &cpu->writeback);
     }
 
     /* Default */
     return 0;
   }
+
+  /* Nothing in writeback this cycle */
+  return 0;
+}
+
+
+/* Releases the program, unless it is shared, the data memory and the
+ * profile of a CPU */
+static void
+release_program(APEX_CPU *cpu)
+{
+  if (!cpu->shared_program)
+  {
+    APEX_program_unload(&cpu->program);
+    free((void *)cpu->decoded_code);
+  }
+  APEX_mem_free(&cpu->data_memory);
+  free(cpu->profile);
+  APEX_loop_reset(cpu);
+}
+
+/*
+ * Puts a CPU back in the state APEX_cpu_create leaves it in: default
+ * timing model, no program and empty data memory
+ */
+void
+APEX_cpu_reset(APEX_CPU *cpu)
+{
+  APEX_Cache_Config cache_config;
+
+  release_program(cpu);
+  APEX_cache_free(&cpu->dcache);
+  APEX_cache_free(&cpu->icache);
+  memset(cpu, 0, sizeof(*cpu));
+
+  cpu->opCycles = INT_MAX;
+  cpu->stop_clock = INT_MAX;
+  cpu->forwarding = APEX_DEFAULT_FORWARDING;
+  cpu->branch_stage = STAGE_EXECUTE;
+  APEX_bpred_reset(&cpu->bpred);
+  APEX_bpred_configure(&cpu->bpred, BPRED_NONE, BPRED_DEFAULT_BTB_ENTRIES,
+                       BPRED_DEFAULT_BHT_ENTRIES);
+  APEX_fu_reset(&cpu->fu);
+  APEX_fu_configure(&cpu->fu, FU_DEFAULT_MUL_LATENCY, FU_DEFAULT_DIV_LATENCY);
+  APEX_cache_default_config(&cache_config);
+  cache_config.size = 0;
+  APEX_cache_configure(&cpu->dcache, &cache_config);
+  APEX_cache_configure(&cpu->icache, &cache_config);
+
+  /* Initialize PC, Registers and all pipeline stages */
+  cpu->pc = 4000;
+  memset(cpu->regs, 0, sizeof(int) * REG_FILE_SIZE);
+  scoreboard_reset(cpu);
+  APEX_mem_init(&cpu->data_memory);
+}
+
+/*
+ * Creates an APEX cpu with the default timing model and no program. The
+ * program is set up by APEX_cpu_load_program() or APEX_cpu_share_program()
+ */
+APEX_CPU *
+APEX_cpu_create(void)
+{
+  APEX_CPU *cpu;
+
+  cpu = calloc(1, sizeof(APEX_CPU));
+  if (cpu)
+  {
+    APEX_cpu_reset(cpu);
+  }
+
+  return cpu;
+}
+
+/* Sets up code memory, the initial data memory and the profile for
+ * cpu->program, already pre-decoded into cpu->decoded_code */
+static int
+setup_program(APEX_CPU *cpu)
+{
+  int i;
+
+  cpu->code_memory = cpu->program.code;
+  cpu->code_memory_size = cpu->program.code_size;
+
+  /* Initial data memory carried by a program image */
+  for (i = 0; i < cpu->program.data_size; ++i)
+  {
+    if (!APEX_mem_write(&cpu->data_memory, cpu->program.data_base + (uint32_t)i,
+                        cpu->program.data[i]))
+    {
+      return FALSE;
+    }
+  }
+
+  cpu->profile = calloc(cpu->code_memory_size + 1, sizeof(APEX_Profile_Entry));
+  if (!cpu->profile)
+  {
+    return FALSE;
+  }
+
+  /* To start fetch stage */
+  cpu->fetch.has_insn = TRUE;
+  return TRUE;
+}
+
+/*
+ * Sets up the CPU to run cpu->program, which it takes over. Returns FALSE
+ * if memory runs out or the image data does not fit below the memory
+ * limit
+ */
+int
+APEX_cpu_load_program(APEX_CPU *cpu)
+{
+  /* Resolve execute handlers once so the stages never switch on opcode */
+  cpu->decoded_code = APEX_predecode(cpu->program.code, cpu->program.code_size);
+  return cpu->decoded_code && setup_program(cpu);
 }
 
+/*
+ * Sets up the CPU to run a program loaded and pre-decoded elsewhere. The
+ * CPU only reads the two and never releases them, so any number of CPUs
+ * can run one copy. Fails as APEX_cpu_load_program does
+ */
+int
+APEX_cpu_share_program(APEX_CPU *cpu, const APEX_Program *program,
+                       const APEX_Decoded_Insn *decoded)
+{
+  cpu->program = *program;
+  cpu->decoded_code = decoded;
+  cpu->shared_program = TRUE;
+  return setup_program(cpu);
+}
 
 /*
      * This function creates and initializes APEX cpu.
@@ -1214,7 +1244,7 @@ APEX_cpu_init(const char *filename, const char *op, const int no_of_cycles)
     return NULL;
   }
 
-  cpu = calloc(1, sizeof(APEX_CPU));
+  cpu = APEX_cpu_create();
 
   if (!cpu)
   {
@@ -1241,25 +1271,23 @@ APEX_cpu_init(const char *filename, const char *op, const int no_of_cycles)
     cpu->simulate = 0;
   }
 
-  /* Initialize PC, Registers and all pipeline stages */
-  cpu->pc = 4000;
-  memset(cpu->regs, 0, sizeof(int) * REG_FILE_SIZE);
-  memset(cpu->data_memory, 0, sizeof(int) * DATA_MEMORY_SIZE);
+  /* Quiet runs print the final statistics only */
+  cpu->quiet = strcmp(op, "quiet") == 0;
   cpu->single_step = 0;
   if (strcmp(op, "single_step") == 0)
   {
-    cpu->single_step = ENABLE_SINGLE_STEP;
+    cpu->single_step = 1;
   }
 
-  /* Parse input file and create code memory */
-  cpu->code_memory = create_code_memory(filename, &cpu->code_memory_size);
-  if (!cpu->code_memory)
+  /* Parse input file or map the program image and create code memory */
+  if (!APEX_program_load(filename, &cpu->program)
+      || !APEX_cpu_load_program(cpu))
   {
-    free(cpu);
+    APEX_cpu_free(cpu);
     return NULL;
   }
 
-  if (ENABLE_DEBUG_MESSAGES && !cpu->simulate)
+  if (!cpu->simulate && !cpu->quiet)
   {
     fprintf(stderr,
             "APEX_CPU: Initialized APEX CPU, loaded %d instructions\n",
@@ -1271,50 +1299,111 @@ APEX_cpu_init(const char *filename, const char *op, const int no_of_cycles)
 
     for (i = 0; i < cpu->code_memory_size; ++i)
     {
-      printf("%-9s %-9d %-9d %-9d %-9d\n", cpu->code_memory[i].opcode_str,
+      printf("%-9s %-9d %-9d %-9d %-9d\n", get_opcode_str(cpu->code_memory[i].opcode),
              cpu->code_memory[i].rd, cpu->code_memory[i].rs1,
              cpu->code_memory[i].rs2, cpu->code_memory[i].imm);
     }
   }
 
-  /* To start fetch stage */
-  cpu->fetch.has_insn = TRUE;
   return cpu;
 }
 
 /*
-     * APEX CPU simulation loop
-     *
-     * Note: You are free to edit this function according to your implementation
-     */
-void APEX_cpu_run(APEX_CPU *cpu)
+ * Simulation loop shared by all run loop variants; out is the variant's
+ * RUN_* constant and fwd its FWD_* forwarding network. Returns the STOP_*
+ * reason the run ended, leaving the reporting to the caller
+ */
+APEX_STAGE int
+run_loop(APEX_CPU *cpu, const int out, const int fwd)
 {
   char user_prompt_val;
 
   while (TRUE) //Running CPU till clock <= to code memory size*/
   {
-    if (ENABLE_DEBUG_MESSAGES && !cpu->simulate) //if not simulate
+    /* A data memory fault ends the run before the faulting instruction
+     * retires, a fetch fault once the pipeline has drained */
+    if (cpu->fault)
+    {
+      return STOP_FAULT;
+    }
+
+    /* A stepped run returns at the start of a cycle, so the next step
+     * carries on from exactly this state */
+    if (cpu->clock >= cpu->stop_clock)
+    {
+      return STOP_BUDGET;
+    }
+
+    /* A loop in its steady state is moved on by whole iterations, or a
+     * block seen before replayed, to the start of a later cycle */
+    if (out == RUN_QUIET && cpu->loop_probe)
+    {
+      cpu->loop_probe = FALSE;
+      if (APEX_loop_probe(cpu))
+      {
+        continue;
+      }
+    }
+
+    if (out != RUN_QUIET && out != RUN_TIMELINE && !cpu->simulate) //if not simulate
+    {
+      if (out == RUN_TRACE)
+      {
+        trace_cycle(cpu->trace, cpu->clock);
+      }
+      else
+      {
+        printf("--------------------------------------------\n");
+        printf("Clock Cycle #: %d\n", cpu->clock);
+        printf("--------------------------------------------\n");
+      }
+    }
+
+    /* Save the state at the start of the requested cycle */
+    if (cpu->checkpoint_path && cpu->clock == cpu->checkpoint_cycle)
     {
-      printf("--------------------------------------------\n");
-      printf("Clock Cycle #: %d\n", cpu->clock);
-      printf("--------------------------------------------\n");
+      if (APEX_cpu_checkpoint(cpu, cpu->checkpoint_path))
+      {
+        fprintf(stderr, "APEX_CPU: Checkpoint written to %s at cycle %d\n",
+                cpu->checkpoint_path, cpu->clock);
+      }
+      else
+      {
+        fprintf(stderr, "APEX_Error: Unable to write checkpoint %s\n",
+                cpu->checkpoint_path);
+      }
     }
 
-    if (APEX_writeback(cpu) || (cpu->clock == cpu->opCycles && !cpu->showMem))
     //when Halt stop instruction
+    if (!cpu->mem_wait && APEX_writeback(cpu, out))
     {
       /* Halt in writeback stage */
-      printf("APEX_CPU: Simulation Complete, cycles = %d instructions = %d\n", cpu->clock, cpu->insn_completed);
-      break;
+      return STOP_HALT;
+    }
+
+    /* Cycle counts are absolute, so a restored run may already be past it */
+    if (cpu->clock >= cpu->opCycles && !cpu->showMem)
+    {
+      return STOP_CYCLE_LIMIT;
     }
 
-    APEX_memory(cpu);
-    APEX_execute(cpu);
-    APEX_decode(cpu);
-    APEX_fetch(cpu);
+    if (cpu->mem_wait)
+    {
+      /* Every stage holds while MEM waits for the D-cache */
+      cpu->mem_wait--;
+      cpu->counters.dcache_stalls++;
+    }
+    else
+    {
+      APEX_memory(cpu, out);
+      APEX_execute(cpu, out);
+      APEX_decode(cpu, out, fwd);
+      APEX_fetch(cpu, out);
+      cpu->pipe_clock++;
+    }
 
     //to display content of register file at each stage for single_step in print_reg_file(cpu);
-    if (cpu->single_step)
+    if (out == RUN_INTERACTIVE)
     {
       print_reg_file(cpu);
       printf("Press any key to advance CPU Clock or <q> to quit:\n");
@@ -1322,8 +1411,7 @@ void APEX_cpu_run(APEX_CPU *cpu)
 
       if ((user_prompt_val == 'Q') || (user_prompt_val == 'q'))
       {
-        printf("APEX_CPU: Simulation Stopped, cycles = %d instructions = %d\n", cpu->clock, cpu->insn_completed);
-        break;
+        return STOP_QUIT;
       }
     }
 
@@ -1331,14 +1419,164 @@ void APEX_cpu_run(APEX_CPU *cpu)
   }
 }
 
+/* Expands the loop of one output once per forwarding network and runs the
+ * CPU's own */
+APEX_STAGE int
+run_forwarding(APEX_CPU *cpu, const int out)
+{
+  switch (cpu->forwarding)
+  {
+  case FWD_NONE:
+    return run_loop(cpu, out, FWD_NONE);
+
+  case FWD_EX:
+    return run_loop(cpu, out, FWD_EX);
+
+  case FWD_EX_MEM:
+    return run_loop(cpu, out, FWD_EX_MEM);
+
+  default:
+    return run_loop(cpu, out, FWD_FULL);
+  }
+}
+
+/* Run loop variants, one per RUN_* output */
+static int
+run_quiet(APEX_CPU *cpu)
+{
+  return run_forwarding(cpu, RUN_QUIET);
+}
+
+static int
+run_trace(APEX_CPU *cpu)
+{
+  return run_forwarding(cpu, RUN_TRACE);
+}
+
+static int
+run_timeline(APEX_CPU *cpu)
+{
+  return run_forwarding(cpu, RUN_TIMELINE);
+}
+
+static int
+run_text(APEX_CPU *cpu)
+{
+  return run_forwarding(cpu, RUN_TEXT);
+}
+
+static int
+run_interactive(APEX_CPU *cpu)
+{
+  return run_forwarding(cpu, RUN_INTERACTIVE);
+}
+
+/*
+     * APEX CPU simulation loop
+     *
+     * Note: You are free to edit this function according to your implementation
+     */
+void APEX_cpu_run(APEX_CPU *cpu)
+{
+  int stop;
+
+  /* Pick the variant once; a trace or timeline takes the place of the
+   * text output */
+  cpu->stop_clock = INT_MAX;
+  if (cpu->trace)
+  {
+    stop = run_trace(cpu);
+  }
+  else if (cpu->timeline)
+  {
+    stop = run_timeline(cpu);
+  }
+  else if (cpu->single_step)
+  {
+    stop = run_interactive(cpu);
+  }
+  else if (cpu->quiet)
+  {
+    stop = run_quiet(cpu);
+  }
+  else
+  {
+    stop = run_text(cpu);
+  }
+
+  if (cpu->loop && cpu->loop->iterations)
+  {
+    fprintf(stderr, "APEX_CPU: Extrapolated %lld loop iterations, %lld cycles\n",
+            cpu->loop->iterations, cpu->loop->cycles);
+  }
+  if (cpu->memo && cpu->memo->hits + cpu->memo->misses)
+  {
+    fprintf(stderr, "APEX_CPU: Block memo %lld hits, %lld misses (%.1f%% hit rate), "
+                    "%lld evictions, %lld cycles replayed\n",
+            cpu->memo->hits, cpu->memo->misses,
+            100.0 * cpu->memo->hits / (cpu->memo->hits + cpu->memo->misses),
+            cpu->memo->evictions, cpu->memo->cycles);
+  }
+
+  switch (stop)
+  {
+  case STOP_FAULT:
+    if (cpu->fault_fetch)
+    {
+      fprintf(stderr, "APEX_Error: Fetch fault, PC = %d outside code memory, cycle = %d\n",
+              cpu->fault_pc, cpu->fault_cycle);
+      printf("APEX_CPU: Simulation Stopped by a fetch fault, cycles = %d instructions = %d\n", cpu->clock, cpu->insn_completed);
+      break;
+    }
+    fprintf(stderr, "APEX_Error: Memory fault at address %u, PC = %d, cycle = %d\n",
+            cpu->fault_address, cpu->fault_pc, cpu->fault_cycle);
+    printf("APEX_CPU: Simulation Stopped by a memory fault, cycles = %d instructions = %d\n", cpu->clock, cpu->insn_completed);
+    break;
+
+  case STOP_QUIT:
+    printf("APEX_CPU: Simulation Stopped, cycles = %d instructions = %d\n", cpu->clock, cpu->insn_completed);
+    break;
+
+  default:
+    printf("APEX_CPU: Simulation Complete, cycles = %d instructions = %d\n", cpu->clock, cpu->insn_completed);
+    break;
+  }
+}
+
+/*
+ * Runs the CPU for at most cycles more cycles without any output and
+ * returns the STOP_* reason it stopped. After STOP_BUDGET the next call
+ * carries on from the same state, so a run split into steps is cycle for
+ * cycle the run made in one go
+ */
+int
+APEX_cpu_step(APEX_CPU *cpu, int cycles)
+{
+  cpu->stop_clock = cycles < INT_MAX - cpu->clock ? cpu->clock + cycles : INT_MAX;
+  return run_quiet(cpu);
+}
+
 /*
-     * This function deallocates APEX CPU.
+     * This function prints the end of run reports and deallocates APEX CPU.
      *
      * Note: You are free to edit this function according to your implementation
      */
 void APEX_cpu_stop(APEX_CPU *cpu)
 {
-  if (!cpu->single_step)
-    free(cpu->code_memory);
+  APEX_counters_report(cpu, stdout);
+  if (cpu->show_profile)
+  {
+    APEX_profile_report(cpu, stdout);
+  }
+  APEX_cpu_free(cpu);
+}
+
+/* Deallocates APEX CPU without printing any report */
+void
+APEX_cpu_free(APEX_CPU *cpu)
+{
+  release_program(cpu);
+  APEX_cache_free(&cpu->dcache);
+  APEX_cache_free(&cpu->icache);
   free(cpu);
 }
\ No newline at end of file
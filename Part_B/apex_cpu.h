@@ -9,40 +9,72 @@
 #ifndef _APEX_CPU_H_
 #define _APEX_CPU_H_
 
+#include <stdint.h>
+
 #include "apex_macros.h"
+#include "apex_bpred.h"
+#include "apex_cache.h"
+#include "apex_counters.h"
+#include "apex_fu.h"
+#include "apex_profile.h"
+#include "apex_image.h"
+#include "apex_memory.h"
+#include "apex_scoreboard.h"
+
+struct APEX_CPU;
+struct APEX_Config;
 
-/* Format of an APEX instruction  */
+/* Execute stage handler, selected once per instruction at load time */
+typedef void (*APEX_Exec_Handler)(struct APEX_CPU *cpu);
+
+/* Packed format of an APEX instruction (8 bytes). The mnemonic is not
+ * stored, get_opcode_str() looks it up from the opcode when printing */
 typedef struct APEX_Instruction
 {
-    char opcode_str[128];
-    int opcode;
-    int rd;
-    int rs1;
-    int rs2;
-    int imm;
+    uint8_t opcode;
+    uint8_t rd;
+    uint8_t rs1;
+    uint8_t rs2;
+    int32_t imm;
 } APEX_Instruction;
 
-/* Model of CPU stage latch */
+/* Pre-decoded instruction: execute handler plus operand slots, built once
+ * from code memory at load time so the stages never re-dispatch on opcode */
+typedef struct APEX_Decoded_Insn
+{
+    APEX_Exec_Handler exec;
+    APEX_Instruction insn;
+    uint8_t operands;   /* OPND_* flags of the opcode */
+    uint32_t src_mask;  /* Registers read in D/RF */
+    uint32_t dst_mask;  /* Registers written back */
+    uint32_t late_mask; /* Subset of dst_mask produced in MEM rather than EX */
+} APEX_Decoded_Insn;
+
+/* Model of CPU stage latch, packed so a latch move stays within one
+ * 64-byte cache line */
 typedef struct CPU_Stage
 {
     int pc;
-    char opcode_str[128];
-    int opcode;
-    int rs1;
-    int rs2;
-    int rd;
     int imm;
     int rs1_value;
     int rs2_value;
     int result_buffer;
     int memory_address;
-    int isStalled;      /* Gunj: added for checking stall status */
-    int has_insn;
     int resetting_buffer;
-    int New_rs1;
-    int New_rs2;
-
-    
+    int tag;                /* Sequence tag handed out at fetch, also the scoreboard tag */
+    uint8_t opcode;
+    uint8_t rs1;
+    uint8_t rs2;
+    uint8_t rd;
+    uint8_t isStalled;      /* Gunj: added for checking stall status */
+    uint8_t has_insn;
+    uint8_t operands;
+    uint8_t resolved;       /* Control transfer already resolved in D/RF */
+    uint32_t src_mask;
+    uint32_t dst_mask;
+    uint32_t late_mask;
+    int pred_pc;            /* PC fetch went to after this instruction */
+    APEX_Exec_Handler exec;  /* Execute handler from the pre-decoded store */
 } CPU_Stage;
 
 /* Model of APEX CPU */
@@ -50,18 +82,48 @@ typedef struct APEX_CPU
 {
     int pc;                        /* Current program counter */
     int clock;                     /* Clock cycles elapsed */
+    int pipe_clock;                /* Cycles the stages ran, clock less the cycles a cache miss froze them */
     int insn_completed;            /* Instructions retired */
     int regs[REG_FILE_SIZE];       /* Integer register file */ 
     int valid_bit[REG_FILE_SIZE];  /* Gunj added Valid bit indicator(0 and 1) */
     int code_memory_size;          /* Number of instruction in the input file */
-    APEX_Instruction *code_memory; /* Code Memory */
-    int data_memory[DATA_MEMORY_SIZE]; /* Data Memory */
+    const APEX_Instruction *code_memory; /* Code Memory */
+    APEX_Program program;          /* Loaded .asm listing or mapped image */
+    const APEX_Decoded_Insn *decoded_code; /* Pre-decoded Code Memory */
+    int shared_program;            /* program and decoded_code belong to someone else */
+    APEX_Memory data_memory;       /* Sparse paged Data Memory */
     int single_step;               /* Wait for user input after every cycle */
     int pos_flag;                  /* Positive flag */
     int zero_flag;                 /* Gunj added {TRUE, FALSE} Used by BZ and BNZ to branch */
     int fetch_from_next_cycle;
     int forwardedDataBuffer[REG_FILE_SIZE];
-    int fdata[REG_FILE_SIZE]; //to track pc updating bit 
+    int fdata[REG_FILE_SIZE]; /* Scoreboard tag of the youngest writer */
+    APEX_Scoreboard scoreboard;
+    int issue_tag;            /* Last sequence tag handed out */
+    APEX_Counters counters;   /* Pipeline performance counters */
+    APEX_Profile_Entry *profile; /* Per-PC profile, indexed like code memory, plus one entry for PCs outside it */
+    int show_profile;         /* Print the profile when the CPU stops */
+    int forwarding;           /* Forwarding network into D/RF, FWD_* */
+    APEX_Bpred bpred;         /* Branch prediction unit used by fetch */
+    int branch_stage;         /* Stage control transfers resolve in, STAGE_EXECUTE or STAGE_DECODE */
+    APEX_FU fu;               /* Execute stage functional units */
+    APEX_Cache dcache;        /* L1 data cache model in front of data_memory, size 0 for none */
+    int mem_wait;             /* Cycles the pipeline stays frozen for the last data access */
+    APEX_Cache icache;        /* L1 instruction cache model in front of code memory, size 0 for none */
+    int fetch_wait;           /* Cycles fetch still waits for an I-cache line */
+    int fault;                /* A data access or fetch faulted, the run stops before the next cycle */
+    int fault_fetch;          /* The fault was a fetch from outside code memory */
+    uint32_t fault_address;   /* Address, PC and cycle of the faulting access */
+    int fault_pc;
+    int fault_cycle;
+    int stop_clock;           /* A run returns at the start of this cycle, for stepping */
+    int loop_accel;           /* Extrapolate steady-state loops in quiet runs */
+    int loop_probe;           /* Fetch went backwards, probe at the start of the next cycle */
+    int loop_recording;       /* EX reports the instructions it executes to the accelerator */
+    struct APEX_Loop *loop;   /* Loop accelerator, NULL until the first probe */
+    int block_memo;           /* Replay the timing of blocks seen before in quiet runs */
+    int memo_recording;       /* Fetch reports the instructions it fetches to the block memo */
+    struct APEX_Memo *memo;   /* Block memo, NULL until the first block starts */
 
     /* Pipeline stages */
     CPU_Stage fetch;
@@ -69,17 +131,34 @@ typedef struct APEX_CPU
     CPU_Stage execute;
     CPU_Stage memory;
     CPU_Stage writeback;
+    CPU_Stage fu_ring[FU_MAX_LATENCY]; /* MUL and DIV in EX, by cycle of completion */
 
 /*Gunj added*/
     int simulate;  // for enabling simulate function*/
+    int quiet;     /* Print the final statistics only */
     int opCycles; //Opration cycles to run definite cycles*/
     int memLoc; //to show value at particular memory location*/
     int showMem; // to show value at particular memory location*/
+    const char *checkpoint_path; /* Checkpoint file written at checkpoint_cycle, or NULL */
+    int checkpoint_cycle;
+    struct APEX_Trace_Writer *trace; /* Binary trace replacing stage text, or NULL */
+    struct APEX_Timeline *timeline;  /* Timeline export replacing stage text, or NULL */
 
 } APEX_CPU;
 
 APEX_Instruction *create_code_memory(const char *filename, int *size);
+APEX_Instruction *create_code_memory_from_buffer(const char *buf, size_t len, int *size);
+const char *get_opcode_str(const int opcode);
+APEX_Decoded_Insn *APEX_predecode(const APEX_Instruction *code_memory, const int size);
+APEX_CPU *APEX_cpu_create(void);
+void APEX_cpu_reset(APEX_CPU *cpu);
+int APEX_cpu_load_program(APEX_CPU *cpu);
+int APEX_cpu_share_program(APEX_CPU *cpu, const APEX_Program *program,
+                           const APEX_Decoded_Insn *decoded);
+int APEX_cpu_configure(APEX_CPU *cpu, const struct APEX_Config *config);
 APEX_CPU *APEX_cpu_init(const char *filename, const char *op, const int no_of_cycles); //added by gunj for extra feature
 void APEX_cpu_run(APEX_CPU *cpu);
+int APEX_cpu_step(APEX_CPU *cpu, int cycles);
 void APEX_cpu_stop(APEX_CPU *cpu);
+void APEX_cpu_free(APEX_CPU *cpu);
 #endif
@@ -0,0 +1,32 @@
+/*
+ * apex_fu.c
+ * Contains APEX execute stage functional unit configuration
+ */
+#include "apex_fu.h"
+
+/* Frees every unit, keeping the configured latencies */
+void
+APEX_fu_reset(APEX_FU *fu)
+{
+    fu->last_complete = -1;
+    fu->div_free = 0;
+    fu->in_flight = 0;
+}
+
+/*
+ * Sets the multiplier and divider latencies. Returns FALSE if one is not
+ * between 1 and FU_MAX_LATENCY cycles
+ */
+int
+APEX_fu_configure(APEX_FU *fu, int mul_latency, int div_latency)
+{
+    if (mul_latency < 1 || mul_latency > FU_MAX_LATENCY
+        || div_latency < 1 || div_latency > FU_MAX_LATENCY)
+    {
+        return FALSE;
+    }
+
+    fu->mul_latency = mul_latency;
+    fu->div_latency = div_latency;
+    return TRUE;
+}
@@ -0,0 +1,97 @@
+/*
+ * apex_fu.h
+ * Contains APEX execute stage functional unit declarations
+ *
+ * EX holds three functional units: the integer ALU, which completes every
+ * instruction other than MUL and DIV in one cycle, a pipelined multiplier
+ * that accepts a MUL every cycle and completes it mul_latency cycles later,
+ * and a divider that completes a DIV after div_latency cycles and accepts
+ * no other DIV meanwhile. Instructions still leave EX in program order, at
+ * most one per cycle, so D/RF only issues an instruction once it would
+ * complete after every older one and, for a DIV, once the divider is free.
+ * A multi-cycle result is produced to the scoreboard when it completes, so
+ * dependent instructions wait on it like on any other in-flight value.
+ */
+#ifndef _APEX_FU_H_
+#define _APEX_FU_H_
+
+#include "apex_macros.h"
+
+/* Longest latency of a functional unit, also the number of completion
+ * slots EX keeps for instructions in flight */
+#define FU_MAX_LATENCY 32
+
+/* Latencies the original single-cycle EX stage had */
+#define FU_DEFAULT_MUL_LATENCY 1
+#define FU_DEFAULT_DIV_LATENCY 1
+
+/* Execute stage functional units */
+typedef struct APEX_FU
+{
+    int mul_latency;   /* Cycles from a MUL entering EX to its result */
+    int div_latency;   /* Cycles from a DIV entering EX to its result */
+    int last_complete; /* Cycle the youngest instruction issued to EX leaves it */
+    int div_free;      /* First cycle the divider accepts a DIV */
+    int in_flight;     /* Instructions waiting in their completion slot */
+} APEX_FU;
+
+/* Cycles an instruction spends in EX */
+static inline int
+fu_latency(const APEX_FU *fu, int opcode)
+{
+    if (opcode == OPCODE_MUL)
+    {
+        return fu->mul_latency;
+    }
+    if (opcode == OPCODE_DIV)
+    {
+        return fu->div_latency;
+    }
+    return 1;
+}
+
+/*
+ * Returns TRUE if an instruction in D/RF at cycle clock cannot enter EX
+ * next cycle, because it would complete no later than an older instruction
+ * or because the divider is still busy
+ */
+static inline int
+fu_must_stall(const APEX_FU *fu, int opcode, int clock)
+{
+    if (clock + fu_latency(fu, opcode) <= fu->last_complete)
+    {
+        return TRUE;
+    }
+
+    return opcode == OPCODE_DIV && clock + 1 < fu->div_free;
+}
+
+/* Books the functional unit of an instruction D/RF hands to EX at clock */
+static inline void
+fu_issue(APEX_FU *fu, int opcode, int clock)
+{
+    fu->last_complete = clock + fu_latency(fu, opcode);
+    if (opcode == OPCODE_DIV)
+    {
+        fu->div_free = clock + 1 + fu->div_latency;
+    }
+}
+
+/* Quotient of a DIV; division by zero gives zero */
+static inline int
+fu_divide(int dividend, int divisor)
+{
+    if (divisor == 0)
+    {
+        return 0;
+    }
+    if (divisor == -1)
+    {
+        return (int)(0u - (unsigned)dividend);
+    }
+    return dividend / divisor;
+}
+
+void APEX_fu_reset(APEX_FU *fu);
+int APEX_fu_configure(APEX_FU *fu, int mul_latency, int div_latency);
+#endif
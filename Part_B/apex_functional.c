@@ -0,0 +1,291 @@
+/*
+ * apex_functional.c
+ * Contains APEX functional (ISA-only) execution implementation
+ *
+ * Every instruction updates the registers, memory and flags exactly as it
+ * does by the time it leaves writeback of the pipeline, so the pipeline
+ * can resume from cpu->pc with empty latches and see the same state.
+ */
+#include "apex_cpu.h"
+#include "apex_functional.h"
+#include "apex_scoreboard.h"
+
+/* Writes an arithmetic result and sets the zero flag from it, as EX does */
+static inline void
+write_result(APEX_CPU *cpu, int rd, int result)
+{
+    cpu->regs[rd] = result;
+    cpu->zero_flag = result == 0 ? TRUE : FALSE;
+}
+
+/* Writes a data word, first telling store what it overwrites unless store
+ * is NULL */
+static inline int
+store_word(APEX_Memory *mem, int addr, int value, APEX_Functional_Store *store)
+{
+    if (store)
+    {
+        if (!APEX_mem_read(mem, addr, &store->old_value))
+        {
+            return FALSE;
+        }
+        store->stored = TRUE;
+        store->addr = addr;
+    }
+
+    return APEX_mem_write(mem, addr, value);
+}
+
+/*
+ * Executes the instruction at *pc_p and moves *pc_p on to the next one.
+ * Returns FALSE, changing nothing, if *pc_p is outside code memory or
+ * holds HALT, or if the instruction accesses memory outside the address
+ * space
+ */
+static inline int
+execute_insn(APEX_CPU *cpu, int *pc_p, APEX_Functional_Store *store)
+{
+    const APEX_Instruction *insn;
+    int *regs = cpu->regs;
+    APEX_Memory *mem = &cpu->data_memory;
+    int pc = *pc_p;
+    int idx, addr, value;
+
+    idx = (pc - 4000) / 4;
+    if (pc < 4000 || (pc - 4000) % 4 || idx >= cpu->code_memory_size)
+    {
+        return FALSE;
+    }
+
+    insn = &cpu->code_memory[idx];
+    if (insn->opcode == OPCODE_HALT)
+    {
+        return FALSE;
+    }
+
+    if (store)
+    {
+        store->stored = FALSE;
+    }
+
+    switch (insn->opcode)
+    {
+    case OPCODE_ADD:
+    {
+        write_result(cpu, insn->rd, regs[insn->rs1] + regs[insn->rs2]);
+        pc += 4;
+        break;
+    }
+
+    case OPCODE_ADDL:
+    {
+        write_result(cpu, insn->rd, regs[insn->rs1] + insn->imm);
+        pc += 4;
+        break;
+    }
+
+    case OPCODE_SUB:
+    {
+        write_result(cpu, insn->rd, regs[insn->rs1] - regs[insn->rs2]);
+        pc += 4;
+        break;
+    }
+
+    case OPCODE_SUBL:
+    {
+        write_result(cpu, insn->rd, regs[insn->rs1] - insn->imm);
+        pc += 4;
+        break;
+    }
+
+    case OPCODE_MUL:
+    {
+        write_result(cpu, insn->rd, regs[insn->rs1] * regs[insn->rs2]);
+        pc += 4;
+        break;
+    }
+
+    case OPCODE_DIV:
+    {
+        write_result(cpu, insn->rd, fu_divide(regs[insn->rs1], regs[insn->rs2]));
+        pc += 4;
+        break;
+    }
+
+    case OPCODE_AND:
+    {
+        write_result(cpu, insn->rd, regs[insn->rs1] & regs[insn->rs2]);
+        pc += 4;
+        break;
+    }
+
+    case OPCODE_OR:
+    {
+        write_result(cpu, insn->rd, regs[insn->rs1] | regs[insn->rs2]);
+        pc += 4;
+        break;
+    }
+
+    case OPCODE_EXOR:
+    {
+        write_result(cpu, insn->rd, regs[insn->rs1] ^ regs[insn->rs2]);
+        pc += 4;
+        break;
+    }
+
+    case OPCODE_MOVC:
+    {
+        write_result(cpu, insn->rd, insn->imm);
+        pc += 4;
+        break;
+    }
+
+    case OPCODE_LOAD:
+    {
+        if (!APEX_mem_read(mem, regs[insn->rs1] + insn->imm, &value))
+        {
+            return FALSE;
+        }
+        regs[insn->rd] = value;
+        pc += 4;
+        break;
+    }
+
+    case OPCODE_STORE:
+    {
+        if (!store_word(mem, regs[insn->rs2] + insn->imm, regs[insn->rs1], store))
+        {
+            return FALSE;
+        }
+        pc += 4;
+        break;
+    }
+
+    case OPCODE_LDI:
+    {
+        /* The flag follows the effective address, as in EX, and the
+         * base register update wins when rd == rs1, as in WB */
+        addr = regs[insn->rs1] + insn->imm;
+        if (!APEX_mem_read(mem, addr, &value))
+        {
+            return FALSE;
+        }
+        cpu->zero_flag = addr == 0 ? TRUE : FALSE;
+        regs[insn->rd] = value;
+        regs[insn->rs1] += 4;
+        pc += 4;
+        break;
+    }
+
+    case OPCODE_STI:
+    {
+        addr = regs[insn->rs1] + insn->imm;
+        if (!store_word(mem, addr, regs[insn->rs2], store))
+        {
+            return FALSE;
+        }
+        if (addr == 0)
+        {
+            cpu->zero_flag = TRUE;
+        }
+        else
+        {
+            cpu->pos_flag = TRUE;
+        }
+        regs[insn->rs1] += 4;
+        pc += 4;
+        break;
+    }
+
+    case OPCODE_CMP:
+    {
+        cpu->zero_flag = regs[insn->rs1] == regs[insn->rs2] ? TRUE : FALSE;
+        cpu->pos_flag = regs[insn->rs1] > regs[insn->rs2] ? TRUE : FALSE;
+        pc += 4;
+        break;
+    }
+
+    case OPCODE_BZ:
+    {
+        pc += cpu->zero_flag == TRUE ? insn->imm : 4;
+        break;
+    }
+
+    case OPCODE_BNZ:
+    {
+        pc += cpu->zero_flag == FALSE ? insn->imm : 4;
+        break;
+    }
+
+    case OPCODE_BP:
+    {
+        pc += cpu->pos_flag == TRUE ? insn->imm : 4;
+        break;
+    }
+
+    case OPCODE_BNP:
+    {
+        pc += cpu->pos_flag == FALSE ? insn->imm : 4;
+        break;
+    }
+
+    case OPCODE_JUMP:
+    {
+        pc = regs[insn->rs1] + insn->imm;
+        break;
+    }
+
+    default:
+    {
+        /* NOP */
+        pc += 4;
+        break;
+    }
+    }
+
+    *pc_p = pc;
+    return TRUE;
+}
+
+/*
+ * Executes instructions from cpu->pc until max_insns have completed, the
+ * next instruction is at stop_pc, or the next instruction is HALT (which
+ * is left for the pipeline to retire), or the next instruction accesses
+ * memory outside the address space (which is left for the pipeline to
+ * report). Must be called while the pipeline
+ * is empty; on return fetch resumes at the next instruction. Returns the
+ * number of instructions executed.
+ */
+long long
+APEX_functional_run(APEX_CPU *cpu, long long max_insns, int stop_pc)
+{
+    int pc = cpu->pc;
+    long long count = 0;
+
+    while (count < max_insns && pc != stop_pc && execute_insn(cpu, &pc, NULL))
+    {
+        count++;
+    }
+
+    /* Hand the architectural state to an empty pipeline */
+    cpu->pc = pc;
+    cpu->fetch.has_insn = TRUE;
+    cpu->fetch.isStalled = 0;
+    cpu->fetch_from_next_cycle = FALSE;
+    scoreboard_reset(cpu);
+
+    return count;
+}
+
+/*
+ * Executes the one instruction at *pc on the architectural state of cpu,
+ * without touching the pipeline, and moves *pc on to the next one. Returns
+ * FALSE, changing nothing, where APEX_functional_run() would stop short of
+ * it. Unless store is NULL, a store reports in it the word it overwrote
+ * and the old value, so the caller can take the store back
+ */
+int
+APEX_functional_step(APEX_CPU *cpu, int *pc, APEX_Functional_Store *store)
+{
+    return execute_insn(cpu, pc, store);
+}
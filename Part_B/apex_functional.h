@@ -0,0 +1,31 @@
+/*
+ * apex_functional.h
+ * Contains APEX functional (ISA-only) execution declarations
+ *
+ * The functional engine executes instructions one at a time on the
+ * architectural state of an APEX_CPU (regs, data_memory and the flags)
+ * with no latches, stalls or forwarding. It is used to fast-forward a
+ * program to its region of interest before the cycle-accurate pipeline
+ * takes over, and one instruction at a time by the loop accelerator.
+ */
+#ifndef _APEX_FUNCTIONAL_H_
+#define _APEX_FUNCTIONAL_H_
+
+/* stop_pc value for APEX_functional_run that never matches */
+#define FF_NO_STOP_PC -1
+
+struct APEX_CPU;
+
+/* Data word a functionally executed store overwrote */
+typedef struct APEX_Functional_Store
+{
+    int stored;    /* The instruction was a store */
+    int addr;
+    int old_value;
+} APEX_Functional_Store;
+
+long long APEX_functional_run(struct APEX_CPU *cpu, long long max_insns,
+                              int stop_pc);
+int APEX_functional_step(struct APEX_CPU *cpu, int *pc,
+                         APEX_Functional_Store *store);
+#endif
@@ -0,0 +1,249 @@
+/*
+ * apex_image.c
+ * Contains functions to load a program from an .asm listing or from an
+ * assembled .apexbin image, and to write such images
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "apex_cpu.h"
+#include "apex_image.h"
+
+/*
+ * Checks that a mapped image is complete and that every instruction names
+ * a known opcode and valid registers, so the pipeline can index its tables
+ * and register file with it directly
+ */
+static int
+validate_image(const APEX_Image_Header *hdr, size_t len)
+{
+    const APEX_Instruction *code;
+    uint64_t code_end, data_end;
+    uint32_t i;
+
+    if (hdr->version != APEX_IMAGE_VERSION || hdr->code_size == 0
+        || hdr->code_offset % sizeof(APEX_Instruction) != 0
+        || hdr->data_offset % sizeof(int32_t) != 0)
+    {
+        return FALSE;
+    }
+
+    code_end = (uint64_t)hdr->code_offset
+               + (uint64_t)hdr->code_size * sizeof(APEX_Instruction);
+    data_end = (uint64_t)hdr->data_offset
+               + (uint64_t)hdr->data_size * sizeof(int32_t);
+    if (code_end > len || (hdr->data_size && data_end > len)
+        || (uint64_t)hdr->data_base + hdr->data_size > MEM_ADDRESS_SPACE)
+    {
+        return FALSE;
+    }
+
+    code = (const APEX_Instruction *)((const char *)hdr + hdr->code_offset);
+    for (i = 0; i < hdr->code_size; ++i)
+    {
+        if (strcmp(get_opcode_str(code[i].opcode), "???") == 0
+            || code[i].rd >= REG_FILE_SIZE || code[i].rs1 >= REG_FILE_SIZE
+            || code[i].rs2 >= REG_FILE_SIZE)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Points a program at the code and data sections of a valid image */
+static void
+use_image(const APEX_Image_Header *hdr, APEX_Program *prog)
+{
+    prog->code = (const APEX_Instruction *)((const char *)hdr + hdr->code_offset);
+    prog->code_size = hdr->code_size;
+    if (hdr->data_size)
+    {
+        prog->data = (const int32_t *)((const char *)hdr + hdr->data_offset);
+        prog->data_base = hdr->data_base;
+        prog->data_size = hdr->data_size;
+    }
+}
+
+/*
+ * Maps an .apexbin image read-only; the code and data sections are used in
+ * place
+ */
+static int
+map_program_image(int fd, APEX_Program *prog)
+{
+    struct stat st;
+    const APEX_Image_Header *hdr;
+    void *map;
+
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(APEX_Image_Header))
+    {
+        return FALSE;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        return FALSE;
+    }
+
+    hdr = map;
+    if (!validate_image(hdr, st.st_size))
+    {
+        fprintf(stderr, "APEX_Error: Invalid program image\n");
+        munmap(map, st.st_size);
+        return FALSE;
+    }
+
+    prog->map = map;
+    prog->map_len = st.st_size;
+    use_image(hdr, prog);
+    return TRUE;
+}
+
+/*
+ * Loads a program, detecting from the first bytes of the file whether it
+ * is an assembled image or an .asm listing
+ */
+int
+APEX_program_load(const char *filename, APEX_Program *prog)
+{
+    char magic[sizeof(((APEX_Image_Header *)0)->magic)];
+    int fd, is_image, ok;
+
+    memset(prog, 0, sizeof(*prog));
+    if (!filename)
+    {
+        return FALSE;
+    }
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        return FALSE;
+    }
+
+    is_image = read(fd, magic, sizeof(magic)) == sizeof(magic)
+               && memcmp(magic, APEX_IMAGE_MAGIC, sizeof(magic)) == 0;
+    if (is_image)
+    {
+        ok = map_program_image(fd, prog);
+        close(fd);
+        return ok;
+    }
+    close(fd);
+
+    prog->code = create_code_memory(filename, &prog->code_size);
+    return prog->code != NULL;
+}
+
+/*
+ * Loads a program held in memory, an .apexbin image or an .asm listing
+ * told apart as by APEX_program_load. The buffer is not referenced once
+ * this returns
+ */
+int
+APEX_program_load_buffer(const void *buf, size_t len, APEX_Program *prog)
+{
+    memset(prog, 0, sizeof(*prog));
+    if (!buf)
+    {
+        return FALSE;
+    }
+
+    if (len >= sizeof(APEX_Image_Header)
+        && memcmp(buf, APEX_IMAGE_MAGIC, sizeof(APEX_IMAGE_MAGIC)) == 0)
+    {
+        /* Copy the image so its sections are aligned and owned */
+        prog->copy = malloc(len);
+        if (!prog->copy)
+        {
+            return FALSE;
+        }
+        memcpy(prog->copy, buf, len);
+        if (!validate_image(prog->copy, len))
+        {
+            APEX_program_unload(prog);
+            return FALSE;
+        }
+        use_image(prog->copy, prog);
+        return TRUE;
+    }
+
+    prog->code = create_code_memory_from_buffer(buf, len, &prog->code_size);
+    return prog->code != NULL;
+}
+
+/* Releases a program returned by APEX_program_load or
+ * APEX_program_load_buffer */
+void
+APEX_program_unload(APEX_Program *prog)
+{
+    if (prog->map)
+    {
+        munmap(prog->map, prog->map_len);
+    }
+    else if (prog->copy)
+    {
+        free(prog->copy);
+    }
+    else
+    {
+        free((void *)prog->code);
+    }
+    memset(prog, 0, sizeof(*prog));
+}
+
+/*
+ * Writes an assembled program image with an optional initial data section
+ */
+int
+APEX_image_write(const char *filename, const APEX_Instruction *code,
+                 int code_size, const int32_t *data, uint32_t data_base,
+                 int data_size)
+{
+    APEX_Image_Header hdr;
+    FILE *fp;
+    int ok;
+
+    if (code_size <= 0 || data_size < 0
+        || (uint64_t)data_base + data_size > MEM_ADDRESS_SPACE)
+    {
+        return FALSE;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, APEX_IMAGE_MAGIC, sizeof(APEX_IMAGE_MAGIC));
+    hdr.version = APEX_IMAGE_VERSION;
+    hdr.code_size = code_size;
+    hdr.code_offset = sizeof(hdr);
+    hdr.data_base = data_base;
+    hdr.data_size = data_size;
+    hdr.data_offset = hdr.code_offset + code_size * sizeof(APEX_Instruction);
+
+    fp = fopen(filename, "wb");
+    if (!fp)
+    {
+        return FALSE;
+    }
+
+    ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1
+         && fwrite(code, sizeof(APEX_Instruction), code_size, fp)
+                == (size_t)code_size
+         && (!data_size
+             || fwrite(data, sizeof(int32_t), data_size, fp)
+                    == (size_t)data_size);
+
+    if (fclose(fp) != 0)
+    {
+        ok = FALSE;
+    }
+
+    return ok;
+}
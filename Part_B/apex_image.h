@@ -0,0 +1,54 @@
+/*
+ * apex_image.h
+ * Contains APEX program loading and binary program image declarations
+ *
+ * An assembled program image (.apexbin) is a fixed header followed by the
+ * code section, an array of packed APEX_Instruction records, and an
+ * optional initial data section of 32-bit words. All fields are stored in
+ * host byte order. The simulator maps the image and executes the code
+ * section in place, so loading it involves no parsing at all.
+ */
+#ifndef _APEX_IMAGE_H_
+#define _APEX_IMAGE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct APEX_Instruction;
+
+#define APEX_IMAGE_MAGIC "APEXBIN"
+#define APEX_IMAGE_VERSION 1
+
+/* Header at offset 0 of a .apexbin image */
+typedef struct APEX_Image_Header
+{
+    char magic[8];        /* APEX_IMAGE_MAGIC, NUL terminated */
+    uint32_t version;     /* APEX_IMAGE_VERSION */
+    uint32_t code_size;   /* Number of instructions in the code section */
+    uint32_t code_offset; /* File offset of the code section */
+    uint32_t data_base;   /* Data memory address of the first data word */
+    uint32_t data_size;   /* Number of words in the data section, may be 0 */
+    uint32_t data_offset; /* File offset of the data section */
+} APEX_Image_Header;
+
+/* A program loaded from an .asm listing or a mapped .apexbin image */
+typedef struct APEX_Program
+{
+    const struct APEX_Instruction *code; /* Code memory */
+    int code_size;                /* Number of instructions */
+    const int32_t *data;          /* Initial data memory words, may be NULL */
+    uint32_t data_base;           /* Address of data[0] */
+    int data_size;                /* Number of words in data */
+    void *map;                    /* Image mapping, NULL for .asm listings */
+    size_t map_len;
+    void *copy;                   /* Image copied from memory, instead of a mapping */
+} APEX_Program;
+
+int APEX_program_load(const char *filename, APEX_Program *prog);
+int APEX_program_load_buffer(const void *buf, size_t len, APEX_Program *prog);
+void APEX_program_unload(APEX_Program *prog);
+int APEX_image_write(const char *filename,
+                     const struct APEX_Instruction *code,
+                     int code_size, const int32_t *data, uint32_t data_base,
+                     int data_size);
+#endif
@@ -0,0 +1,827 @@
+/*
+ * apex_loop.c
+ * Contains APEX steady-state loop accelerator implementation
+ *
+ * At a probe the pipeline holds the tail of one iteration: instructions
+ * that have left EX (in MEM or WB), instructions issued to EX and still
+ * waiting in it, and instructions not yet issued. The first two groups
+ * are the only ones holding data. Skipping n iterations keeps every latch
+ * as it is, shifted by n iterations of tags and cycles, and recomputes
+ * that data from a functional run of the iterations, which also leaves
+ * the registers, flags and memory as they are after the last instruction
+ * that has left EX. The registers those instructions still have to write
+ * back are never read from the register file before they do, and the
+ * stores still in MEM write memory again with the same value, so the
+ * pipeline carries on exactly as if it had simulated every cycle.
+ */
+#include <limits.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_functional.h"
+#include "apex_loop.h"
+#include "apex_memo.h"
+
+/* Returns TRUE if the timing of the CPU's model depends on no data value
+ * but the outcome of a branch, so that loops can be extrapolated */
+int
+APEX_loop_supported(const APEX_CPU *cpu)
+{
+    /* A branch resolving in D/RF reads the flags before a MUL or DIV still
+     * in EX sets them, which the functional run cannot follow */
+    if (cpu->branch_stage == STAGE_DECODE
+        && (cpu->fu.mul_latency > 1 || cpu->fu.div_latency > 1))
+    {
+        return FALSE;
+    }
+
+    /* Cache hits depend on the addresses */
+    return !cpu->dcache.config.size && !cpu->icache.config.size;
+}
+
+/* Forgets every loop seen and releases the accelerator, which the next
+ * probe allocates again */
+void
+APEX_loop_reset(APEX_CPU *cpu)
+{
+    if (cpu->loop)
+    {
+        free(cpu->loop->profile);
+        free(cpu->loop->records);
+        free(cpu->loop);
+        cpu->loop = NULL;
+    }
+    APEX_memo_reset(cpu);
+    cpu->loop_probe = FALSE;
+    cpu->loop_recording = FALSE;
+}
+
+/* Cycles from now until a functional unit timestamp, 0 if it has passed */
+static int
+ahead(int cycle, int now)
+{
+    return cycle > now ? cycle - now : 0;
+}
+
+static void
+capture_latch(Loop_Latch *latch, const CPU_Stage *stage, int issue_tag)
+{
+    latch->pc = stage->pc;
+    latch->tag = stage->tag - issue_tag;
+    latch->pred_pc = stage->pred_pc;
+    latch->has_insn = stage->has_insn;
+    latch->isStalled = stage->isStalled;
+    latch->resolved = stage->resolved;
+}
+
+/* Reduces the pipeline to its signature and returns the bytes of it that
+ * are in use */
+size_t
+APEX_loop_capture(const APEX_CPU *cpu, Loop_Signature *sig)
+{
+    const CPU_Stage *stages[] = {&cpu->fetch, &cpu->decode, &cpu->execute,
+                                 &cpu->memory, &cpu->writeback};
+    const CPU_Stage *slot;
+    uint32_t pending = cpu->scoreboard.pending;
+    int i, reg;
+
+    memset(sig, 0, offsetof(Loop_Signature, ring));
+    sig->pc = cpu->pc;
+    sig->fetch_from_next_cycle = cpu->fetch_from_next_cycle;
+    sig->in_flight = cpu->fu.in_flight;
+    sig->last_complete = ahead(cpu->fu.last_complete, cpu->pipe_clock);
+    sig->div_free = ahead(cpu->fu.div_free, cpu->pipe_clock);
+    sig->pending = pending;
+    sig->not_ready = cpu->scoreboard.not_ready;
+    while (pending)
+    {
+        reg = __builtin_ctz(pending);
+        sig->producer_stage[reg] = cpu->scoreboard.producer_stage[reg];
+        sig->ready_cycle[reg] = cpu->scoreboard.ready_cycle[reg] - cpu->pipe_clock;
+        sig->fdata[reg] = cpu->fdata[reg] - cpu->issue_tag;
+        pending &= pending - 1;
+    }
+
+    for (i = 0; i < 5; ++i)
+    {
+        capture_latch(&sig->stages[i], stages[i], cpu->issue_tag);
+    }
+
+    if (!cpu->fu.in_flight)
+    {
+        return offsetof(Loop_Signature, ring);
+    }
+
+    memset(sig->ring, 0, sizeof(sig->ring));
+    for (i = 0; i < FU_MAX_LATENCY; ++i)
+    {
+        slot = &cpu->fu_ring[(cpu->pipe_clock + i) % FU_MAX_LATENCY];
+        if (slot->has_insn)
+        {
+            capture_latch(&sig->ring[i], slot, cpu->issue_tag);
+        }
+    }
+
+    return sizeof(*sig);
+}
+
+/* FNV-1a over the words of a signature */
+uint64_t
+APEX_loop_hash(const Loop_Signature *sig, size_t bytes)
+{
+    const uint32_t *words = (const uint32_t *)sig;
+    uint64_t hash = 14695981039346656037ull;
+    size_t i;
+
+    for (i = 0; i < bytes / sizeof(uint32_t); ++i)
+    {
+        hash = (hash ^ words[i]) * 1099511628211ull;
+    }
+
+    return hash;
+}
+
+/* Entry holding a signature, or a new one taking the place of the least
+ * recently used entry; the entry being measured is never replaced */
+static Loop_Entry *
+find_entry(APEX_Loop *loop, const Loop_Signature *sig, uint64_t hash,
+           size_t bytes)
+{
+    Loop_Entry *entry, *victim = NULL;
+    int i;
+
+    for (i = 0; i < LOOP_ENTRIES; ++i)
+    {
+        entry = &loop->entries[i];
+        if (entry->used && entry->hash == hash
+            && memcmp(&entry->sig, sig, bytes) == 0)
+        {
+            entry->last_use = ++loop->uses;
+            return entry;
+        }
+        if (entry != loop->measured
+            && (!victim || !entry->used
+                || (victim->used && entry->last_use < victim->last_use)))
+        {
+            victim = entry;
+        }
+    }
+
+    memcpy(&victim->sig, sig, bytes);
+    victim->hash = hash;
+    victim->used = TRUE;
+    victim->last_use = ++loop->uses;
+    victim->repeats = -1;
+    victim->need = LOOP_REPEATS;
+    return victim;
+}
+
+/* Remembers where the CPU is, for the distance to the next visit */
+static void
+visit(const APEX_CPU *cpu, Loop_Entry *entry)
+{
+    entry->clock = cpu->clock;
+    entry->insns = cpu->insn_completed;
+    entry->tag = cpu->issue_tag;
+}
+
+/* Makes a loop that failed to extrapolate wait twice as long for the next
+ * attempt */
+static void
+back_off(Loop_Entry *entry)
+{
+    entry->repeats = 0;
+    if (entry->need < LOOP_MAX_REPEATS)
+    {
+        entry->need *= 2;
+    }
+}
+
+/* Returns TRUE unless the CPU must simulate every cycle for now: it has
+ * faulted, or a checkpoint still to be written is taken by the pipeline
+ * itself */
+int
+APEX_loop_may_skip(const APEX_CPU *cpu)
+{
+    return !cpu->fault
+           && !(cpu->checkpoint_path && cpu->clock <= cpu->checkpoint_cycle);
+}
+
+/* Starts measuring the iteration from the probe of entry on */
+static void
+start_measuring(APEX_CPU *cpu, APEX_Loop *loop, Loop_Entry *entry)
+{
+    if (!loop->profile)
+    {
+        loop->profile = malloc(cpu->code_memory_size * sizeof(APEX_Profile_Entry));
+        if (!loop->profile)
+        {
+            return;
+        }
+    }
+
+    memcpy(loop->profile, cpu->profile,
+           cpu->code_memory_size * sizeof(APEX_Profile_Entry));
+    loop->counters = cpu->counters;
+    loop->bpred = cpu->bpred.state;
+    loop->clock = cpu->clock;
+    loop->pipe_clock = cpu->pipe_clock;
+    loop->insns = cpu->insn_completed;
+    loop->tag = cpu->issue_tag;
+    loop->path_len = 0;
+    loop->measured = entry;
+}
+
+/* Applies the register writes writeback makes for a latch, with value as
+ * the result of rd */
+static void
+write_back(APEX_CPU *cpu, const CPU_Stage *stage, int value)
+{
+    if (stage->operands & OPND_RD)
+    {
+        cpu->regs[stage->rd] = value;
+    }
+    if (stage->operands & OPND_RS1_DST)
+    {
+        cpu->regs[stage->rs1] = stage->resetting_buffer;
+    }
+}
+
+/*
+ * Completes the instructions that have left EX on the architectural
+ * state, the one in WB and then the one in MEM, whose load or store is
+ * done here. Returns FALSE if that access faults
+ */
+int
+APEX_loop_complete(APEX_CPU *cpu, CPU_Stage *const *done, int n_done)
+{
+    const CPU_Stage *stage;
+    int i, value;
+
+    for (i = 0; i < n_done; ++i)
+    {
+        stage = done[i];
+        value = stage->result_buffer;
+        if (stage == &cpu->memory)
+        {
+            if (stage->operands & OPND_RD_MEM)
+            {
+                if (!APEX_mem_read(&cpu->data_memory, stage->memory_address, &value))
+                {
+                    return FALSE;
+                }
+            }
+            else if (stage->opcode == OPCODE_STORE || stage->opcode == OPCODE_STI)
+            {
+                value = stage->opcode == OPCODE_STORE ? stage->rs1_value
+                                                      : stage->rs2_value;
+                if (!APEX_mem_write(&cpu->data_memory, stage->memory_address, value))
+                {
+                    return FALSE;
+                }
+            }
+        }
+        write_back(cpu, stage, value);
+    }
+
+    return TRUE;
+}
+
+/* Sets the source operands a latch read in D/RF */
+static void
+refill_sources(CPU_Stage *stage, const Loop_Record *rec)
+{
+    if (stage->operands & OPND_RS1)
+    {
+        stage->rs1_value = rec->regs[stage->rs1];
+    }
+    if (stage->operands & OPND_RS2)
+    {
+        stage->rs2_value = rec->regs[stage->rs2];
+    }
+}
+
+/*
+ * Rebuilds a latch that has left EX: its sources, then whatever its
+ * execute handler computed and forwarded, then for a load past MEM the
+ * word it read. A control transfer computes nothing once resolved
+ */
+static void
+refill_executed(APEX_CPU *cpu, CPU_Stage *stage, const Loop_Record *rec)
+{
+    CPU_Stage execute;
+
+    refill_sources(stage, rec);
+    if (!(stage->operands & OPND_CONTROL))
+    {
+        execute = cpu->execute;
+        cpu->execute = *stage;
+        stage->exec(cpu);
+        *stage = cpu->execute;
+        cpu->execute = execute;
+    }
+
+    if (stage == &cpu->writeback && (stage->operands & OPND_RD_MEM))
+    {
+        stage->result_buffer = rec->loaded;
+        cpu->forwardedDataBuffer[stage->rd] = rec->loaded;
+    }
+}
+
+/* Takes back instructions from the newest executed down to first, and
+ * returns the registers and flags to the state before first */
+void
+APEX_loop_take_back(APEX_CPU *cpu, const APEX_Loop *loop, long long executed,
+                    long long first)
+{
+    const int mask = loop->record_slots - 1;
+    const Loop_Record *rec;
+    long long i;
+
+    for (i = executed - 1; i >= first; --i)
+    {
+        rec = &loop->records[i & mask];
+        if (rec->store.stored)
+        {
+            APEX_mem_write(&cpu->data_memory, rec->store.addr, rec->store.old_value);
+        }
+    }
+
+    if (first < executed)
+    {
+        rec = &loop->records[first & mask];
+        memcpy(cpu->regs, rec->regs, sizeof(cpu->regs));
+        cpu->zero_flag = rec->zero_flag;
+        cpu->pos_flag = rec->pos_flag;
+    }
+}
+
+/* Adds n times the change since start to every 64-bit counter of a
+ * structure made of nothing else */
+static void
+extrapolate_counters(uint64_t *now, const uint64_t *start, size_t count,
+                     long long n)
+{
+    size_t i;
+
+    for (i = 0; i < count; ++i)
+    {
+        now[i] += (now[i] - start[i]) * (uint64_t)n;
+    }
+}
+
+/* Cycles the CPU can move on without stopping at a cycle limit before the
+ * instructions now in MEM and WB have written back, as a skip has them do
+ * already */
+long long
+APEX_loop_cycles_left(const APEX_CPU *cpu)
+{
+    long long limit = cpu->stop_clock;
+
+    if (!cpu->showMem && cpu->opCycles < limit)
+    {
+        limit = cpu->opCycles;
+    }
+
+    return limit - cpu->clock - 2;
+}
+
+/* Largest number of iterations the CPU can move on without passing a cycle
+ * limit or overflowing a count */
+static long long
+iterations_left(const APEX_CPU *cpu, int cycles, int insns, int tags)
+{
+    long long n = APEX_loop_cycles_left(cpu) / cycles;
+
+    if (n > (INT_MAX - (long long)cpu->insn_completed) / insns)
+    {
+        n = (INT_MAX - (long long)cpu->insn_completed) / insns;
+    }
+    if (n > (INT_MAX - (long long)cpu->issue_tag) / tags)
+    {
+        n = (INT_MAX - (long long)cpu->issue_tag) / tags;
+    }
+
+    return n;
+}
+
+/* Returns FALSE for an instruction the functional run cannot stand in
+ * for: an LDI loading its own base register is written back in an order
+ * the functional run does not follow */
+int
+APEX_loop_replayable(const APEX_CPU *cpu, int pc)
+{
+    const APEX_Instruction *insn = &cpu->code_memory[(pc - 4000) / 4];
+
+    return !(insn->opcode == OPCODE_LDI && insn->rd == insn->rs1);
+}
+
+/*
+ * Lists the latches holding data, oldest first: the instructions that
+ * have left EX (WB, then MEM) in done and those issued to EX and still in
+ * it (the completion slots from pipe_clock on, then EX) in issued.
+ * Returns the PC of the oldest instruction still to leave EX, where a
+ * functional run takes over
+ */
+int
+APEX_loop_window(APEX_CPU *cpu, CPU_Stage **done, int *n_done,
+                 CPU_Stage **issued, int *n_issued)
+{
+    CPU_Stage *slot;
+    int i;
+
+    *n_done = 0;
+    if (cpu->writeback.has_insn)
+    {
+        done[(*n_done)++] = &cpu->writeback;
+    }
+    if (cpu->memory.has_insn)
+    {
+        done[(*n_done)++] = &cpu->memory;
+    }
+
+    *n_issued = 0;
+    for (i = 0; cpu->fu.in_flight && i < FU_MAX_LATENCY; ++i)
+    {
+        slot = &cpu->fu_ring[(cpu->pipe_clock + i) % FU_MAX_LATENCY];
+        if (slot->has_insn)
+        {
+            issued[(*n_issued)++] = slot;
+        }
+    }
+    if (cpu->execute.has_insn)
+    {
+        issued[(*n_issued)++] = &cpu->execute;
+    }
+
+    if (*n_issued)
+    {
+        return issued[0]->pc;
+    }
+    if (cpu->decode.has_insn)
+    {
+        return cpu->decode.pc;
+    }
+    if (cpu->fetch.has_insn && cpu->fetch.isStalled)
+    {
+        return cpu->fetch.pc;
+    }
+    return cpu->pc;
+}
+
+/* Makes room for the records of a functional run of insns instructions
+ * and the window around them. Returns FALSE if memory runs out */
+int
+APEX_loop_reserve(APEX_Loop *loop, int insns)
+{
+    Loop_Record *records;
+    int slots = 1;
+
+    while (slots < insns + 2 * FU_MAX_LATENCY)
+    {
+        slots <<= 1;
+    }
+    if (slots > loop->record_slots)
+    {
+        records = realloc(loop->records, slots * sizeof(Loop_Record));
+        if (!records)
+        {
+            return FALSE;
+        }
+        loop->records = records;
+        loop->record_slots = slots;
+    }
+
+    return TRUE;
+}
+
+/* Executes the instruction at *pc functionally as the executed-th of a
+ * run, keeping the record to rebuild its latch from and take it back.
+ * Returns FALSE, changing nothing, if it cannot be executed */
+int
+APEX_loop_step(APEX_CPU *cpu, APEX_Loop *loop, long long executed, int *pc)
+{
+    Loop_Record *rec = &loop->records[executed & (loop->record_slots - 1)];
+    const int rd = cpu->code_memory[(*pc - 4000) / 4].rd;
+
+    memcpy(rec->regs, cpu->regs, sizeof(rec->regs));
+    rec->zero_flag = cpu->zero_flag;
+    rec->pos_flag = cpu->pos_flag;
+    if (!APEX_functional_step(cpu, pc, &rec->store))
+    {
+        return FALSE;
+    }
+    rec->loaded = cpu->regs[rd];
+    return TRUE;
+}
+
+/*
+ * Rebuilds the data of the latches in a window from a functional run
+ * taken back to its first-th instruction: done holds the instructions
+ * before it, issued that one and those after it. Their execute handlers
+ * leave the flags as the functional run has them
+ */
+void
+APEX_loop_refill(APEX_CPU *cpu, const APEX_Loop *loop, CPU_Stage *const *done,
+                 int n_done, CPU_Stage *const *issued, int n_issued,
+                 long long first)
+{
+    const int mask = loop->record_slots - 1;
+    const int zero_flag = cpu->zero_flag, pos_flag = cpu->pos_flag;
+    int i;
+
+    for (i = 0; i < n_done; ++i)
+    {
+        refill_executed(cpu, done[i], &loop->records[(first - n_done + i) & mask]);
+    }
+    for (i = 0; i < n_issued; ++i)
+    {
+        refill_sources(issued[i], &loop->records[(first + i) & mask]);
+    }
+    cpu->zero_flag = zero_flag;
+    cpu->pos_flag = pos_flag;
+}
+
+/*
+ * The measured iteration has just ended in the signature it started from.
+ * Executes the iterations that follow functionally while they take the
+ * measured path and moves the pipeline on by all but the last of them.
+ * Returns TRUE if the CPU was moved on
+ */
+static int
+extrapolate(APEX_CPU *cpu, APEX_Loop *loop)
+{
+    const int cycles = cpu->clock - loop->clock;
+    const int insns = cpu->insn_completed - loop->insns;
+    const int tags = cpu->issue_tag - loop->tag;
+    CPU_Stage *done[2], *issued[FU_MAX_LATENCY + 1], ring[FU_MAX_LATENCY];
+    CPU_Stage *stages[] = {&cpu->fetch, &cpu->decode, &cpu->execute,
+                           &cpu->memory, &cpu->writeback};
+    int regs[REG_FILE_SIZE], zero_flag = cpu->zero_flag, pos_flag = cpu->pos_flag;
+    int n_done, n_issued, pc, shift, reg, i, j;
+    long long max, executed, valid, n, first;
+    uint32_t pending;
+
+    /* Each iteration must run the same instructions in the same cycles
+     * with the predictor trained the same way */
+    if (cycles <= 0 || insns <= 0 || tags <= 0 || insns > LOOP_MAX_PATH
+        || loop->path_len != insns || cpu->pipe_clock - loop->pipe_clock != cycles
+        || memcmp(&loop->bpred, &cpu->bpred.state, sizeof(loop->bpred)) != 0)
+    {
+        return FALSE;
+    }
+
+    for (i = 0; i < insns; ++i)
+    {
+        if (!APEX_loop_replayable(cpu, loop->path[i]))
+        {
+            return FALSE;
+        }
+    }
+
+    max = iterations_left(cpu, cycles, insns, tags);
+    if (max < 1)
+    {
+        return FALSE;
+    }
+
+    /* The functional run starts with the oldest instruction still to
+     * leave EX */
+    pc = APEX_loop_window(cpu, done, &n_done, issued, &n_issued);
+    if (pc != loop->path[0] || !APEX_loop_reserve(loop, insns))
+    {
+        return FALSE;
+    }
+
+    memcpy(regs, cpu->regs, sizeof(regs));
+    if (!APEX_loop_complete(cpu, done, n_done))
+    {
+        memcpy(cpu->regs, regs, sizeof(regs));
+        return FALSE;
+    }
+
+    /* Run whole iterations on the measured path, and the instructions
+     * issued to EX at the end of the last one */
+    max = max * insns + n_issued;
+    for (executed = 0, j = 0; executed < max && pc == loop->path[j]; ++executed)
+    {
+        if (!APEX_loop_step(cpu, loop, executed, &pc))
+        {
+            break;
+        }
+        if (++j == insns)
+        {
+            j = 0;
+        }
+    }
+
+    /* An instruction only stays on the path if the next one does */
+    valid = executed && pc != loop->path[j] ? executed - 1 : executed;
+    n = valid >= n_issued ? (valid - n_issued) / insns : 0;
+    first = n * insns;
+    if (n < 1 || first < n_done)
+    {
+        APEX_loop_take_back(cpu, loop, executed, 0);
+        memcpy(cpu->regs, regs, sizeof(regs));
+        cpu->zero_flag = zero_flag;
+        cpu->pos_flag = pos_flag;
+        return FALSE;
+    }
+
+    /* The latches now hold the same instructions n iterations on */
+    APEX_loop_take_back(cpu, loop, executed, first);
+    APEX_loop_refill(cpu, loop, done, n_done, issued, n_issued, first);
+
+    shift = n * cycles;
+    for (i = 0; i < 5; ++i)
+    {
+        stages[i]->tag += n * tags;
+    }
+    memcpy(ring, cpu->fu_ring, sizeof(ring));
+    for (i = 0; i < FU_MAX_LATENCY; ++i)
+    {
+        if (ring[i].has_insn)
+        {
+            ring[i].tag += n * tags;
+        }
+        cpu->fu_ring[(i + shift) % FU_MAX_LATENCY] = ring[i];
+    }
+
+    pending = cpu->scoreboard.pending;
+    while (pending)
+    {
+        reg = __builtin_ctz(pending);
+        cpu->scoreboard.ready_cycle[reg] += shift;
+        cpu->fdata[reg] += n * tags;
+        pending &= pending - 1;
+    }
+    if (cpu->fu.last_complete > cpu->pipe_clock)
+    {
+        cpu->fu.last_complete += shift;
+    }
+    if (cpu->fu.div_free > cpu->pipe_clock)
+    {
+        cpu->fu.div_free += shift;
+    }
+
+    cpu->clock += shift;
+    cpu->pipe_clock += shift;
+    cpu->insn_completed += n * insns;
+    cpu->issue_tag += n * tags;
+    extrapolate_counters((uint64_t *)&cpu->counters, (const uint64_t *)&loop->counters,
+                         sizeof(cpu->counters) / sizeof(uint64_t), n);
+    extrapolate_counters((uint64_t *)cpu->profile, (const uint64_t *)loop->profile,
+                         cpu->code_memory_size * sizeof(APEX_Profile_Entry) / sizeof(uint64_t),
+                         n);
+
+    loop->iterations += n;
+    loop->cycles += shift;
+    return TRUE;
+}
+
+/*
+ * Follows the loops through a probe with the given signature, measuring
+ * an iteration once one repeats. Returns TRUE if the CPU has been moved
+ * on by whole loop iterations
+ */
+static int
+follow_loops(APEX_CPU *cpu, APEX_Loop *loop, const Loop_Signature *sig,
+             uint64_t hash, size_t bytes)
+{
+    Loop_Entry *entry;
+    int moved;
+
+    /* Only the signature the measured iteration started from ends it */
+    entry = loop->measured;
+    if (entry)
+    {
+        if (entry->hash == hash && memcmp(&entry->sig, sig, bytes) == 0)
+        {
+            loop->measured = NULL;
+            moved = APEX_loop_may_skip(cpu) && extrapolate(cpu, loop);
+            if (moved)
+            {
+                entry->repeats = 0;
+                entry->need = LOOP_REPEATS;
+            }
+            else
+            {
+                back_off(entry);
+            }
+            visit(cpu, entry);
+            return moved;
+        }
+        if (loop->path_len > LOOP_MAX_PATH)
+        {
+            loop->measured = NULL;
+            back_off(entry);
+        }
+        return FALSE;
+    }
+
+    entry = find_entry(loop, sig, hash, bytes);
+    if (entry->repeats < 0)
+    {
+        /* First visit */
+        entry->repeats = 0;
+        entry->cycles = 0;
+    }
+    else if (entry->cycles == cpu->clock - entry->clock
+             && entry->insn_delta == cpu->insn_completed - entry->insns
+             && entry->tag_delta == cpu->issue_tag - entry->tag)
+    {
+        entry->repeats++;
+    }
+    else
+    {
+        entry->repeats = 1;
+        entry->cycles = cpu->clock - entry->clock;
+        entry->insn_delta = cpu->insn_completed - entry->insns;
+        entry->tag_delta = cpu->issue_tag - entry->tag;
+    }
+    visit(cpu, entry);
+
+    if (entry->repeats >= entry->need && APEX_loop_may_skip(cpu))
+    {
+        start_measuring(cpu, loop, entry);
+    }
+
+    return FALSE;
+}
+
+/*
+ * Probes the pipeline at the start of a cycle after fetch went backwards,
+ * for the loop accelerator and the block memo (apex_memo.h). Returns TRUE
+ * if the CPU has been moved on to the start of a later cycle
+ */
+int
+APEX_loop_probe(APEX_CPU *cpu)
+{
+    APEX_Loop *loop = cpu->loop;
+    Loop_Signature sig;
+    uint64_t hash;
+    size_t bytes;
+    Loop_Entry *measured;
+    int moved = FALSE, going_on;
+
+    if (!loop)
+    {
+        loop = calloc(1, sizeof(*loop));
+        if (!loop)
+        {
+            cpu->loop_accel = FALSE;
+            cpu->block_memo = FALSE;
+            return FALSE;
+        }
+        cpu->loop = loop;
+    }
+
+    bytes = APEX_loop_capture(cpu, &sig);
+    hash = APEX_loop_hash(&sig, bytes);
+
+    going_on = cpu->block_memo && APEX_memo_goes_on(cpu);
+    if (cpu->block_memo && !going_on)
+    {
+        APEX_memo_end_block(cpu, &sig);
+    }
+
+    measured = loop->measured;
+    if (cpu->loop_accel)
+    {
+        moved = follow_loops(cpu, loop, &sig, hash, bytes);
+    }
+
+    /* The block being recorded runs on through the probe, unless the loops
+     * have taken its path over */
+    if (going_on)
+    {
+        if (!moved && loop->measured == measured)
+        {
+            return FALSE;
+        }
+        APEX_memo_drop_block(cpu);
+    }
+
+    /* A block replayed ends at the next probe point, so the memo probes
+     * again there at once */
+    if (!moved && cpu->block_memo && APEX_memo_replay(cpu, &sig, bytes, hash))
+    {
+        cpu->loop_probe = TRUE;
+        return TRUE;
+    }
+
+    /* The path starts again at every probe, unless an iteration is being
+     * measured */
+    if (!loop->measured)
+    {
+        loop->path_len = 0;
+    }
+    if (cpu->block_memo)
+    {
+        APEX_memo_start_block(cpu, &sig, bytes, hash, moved);
+    }
+    cpu->loop_recording = loop->measured || cpu->memo_recording;
+
+    return moved;
+}
@@ -0,0 +1,152 @@
+/*
+ * apex_loop.h
+ * Contains APEX steady-state loop accelerator declarations
+ *
+ * Quiet runs probe the pipeline at the start of the cycle after fetch was
+ * sent backwards. A probe reduces the timing state of the pipeline (latch
+ * occupancy, stall flags, scoreboard and functional unit timing relative
+ * to the clock, tags relative to the last one handed out) to a signature.
+ * Once a signature has come back LOOP_REPEATS times the same number of
+ * cycles apart, the accelerator measures one more iteration: the
+ * instructions EX executes, the counters and the profile. If that
+ * iteration ends in the same signature with the predictor unchanged, every
+ * later iteration executing the same instructions takes exactly the same
+ * cycles. The accelerator then executes the following iterations
+ * functionally for as long as they stay on that path, rebuilds the data
+ * held in the latches and moves the clocks, tags, counters and profile on
+ * by whole iterations. The pipeline simulates the iteration leaving the
+ * loop as usual. The same probes drive the block memo (apex_memo.h).
+ *
+ * Only timing models in which no data value other than a branch outcome
+ * affects timing are accelerated: no caches, and no MUL or DIV still in
+ * EX while a branch resolves in D/RF.
+ */
+#ifndef _APEX_LOOP_H_
+#define _APEX_LOOP_H_
+
+#include "apex_cpu.h"
+#include "apex_functional.h"
+
+#define LOOP_ENTRIES 16       /* Signatures followed at once */
+#define LOOP_REPEATS 3        /* Equal cycle deltas before an iteration is measured */
+#define LOOP_MAX_REPEATS 4096 /* Limit of the back-off after failed attempts */
+#define LOOP_MAX_PATH 4096    /* Instructions in the longest iteration measured */
+
+/* Timing state of a stage latch; the rest of it follows from the PC */
+typedef struct Loop_Latch
+{
+    int pc;
+    int tag;     /* Less the last tag handed out */
+    int pred_pc;
+    uint8_t has_insn;
+    uint8_t isStalled;
+    uint8_t resolved;
+    uint8_t unused;
+} Loop_Latch;
+
+/* Timing state of the pipeline at a probe. The completion slots come last
+ * and are only compared while a MUL or DIV is in flight */
+typedef struct Loop_Signature
+{
+    int pc;
+    int fetch_from_next_cycle;
+    int in_flight;
+    int last_complete;                     /* Cycles ahead of pipe_clock, 0 if not */
+    int div_free;                          /* Likewise */
+    uint32_t pending;
+    uint32_t not_ready;
+    uint8_t producer_stage[REG_FILE_SIZE]; /* Of pending registers only */
+    int ready_cycle[REG_FILE_SIZE];        /* Less pipe_clock, pending only */
+    int fdata[REG_FILE_SIZE];              /* Less issue_tag, pending only */
+    Loop_Latch stages[5];                  /* Fetch to writeback */
+    Loop_Latch ring[FU_MAX_LATENCY];       /* By slot from pipe_clock on */
+} Loop_Signature;
+
+/* A signature seen at a probe, with the last distance between two visits */
+typedef struct Loop_Entry
+{
+    Loop_Signature sig;
+    uint64_t hash;
+    int used;
+    unsigned last_use;
+    int clock;   /* At the last visit */
+    int insns;
+    int tag;
+    int cycles;  /* Distance between the last two visits */
+    int insn_delta;
+    int tag_delta;
+    int repeats; /* Visits in a row at that distance */
+    int need;    /* Repeats before an iteration is measured */
+} Loop_Entry;
+
+/* Register state before an instruction executed functionally, to rebuild
+ * latches from and to take the instruction back */
+typedef struct Loop_Record
+{
+    int regs[REG_FILE_SIZE];
+    int zero_flag;
+    int pos_flag;
+    int loaded; /* Destination register afterwards, the word a load read */
+    APEX_Functional_Store store;
+} Loop_Record;
+
+/* Loop accelerator of a CPU */
+typedef struct APEX_Loop
+{
+    Loop_Entry entries[LOOP_ENTRIES];
+    unsigned uses;
+
+    /* Iteration being measured */
+    Loop_Entry *measured;
+    int clock;
+    int pipe_clock;
+    int insns;
+    int tag;
+    APEX_Counters counters;
+    APEX_Bpred_State bpred;
+    APEX_Profile_Entry *profile; /* Profile at the start, then its change */
+
+    /* PCs EX executed, in order, since the iteration being measured or,
+     * without one, the last probe started */
+    int path[LOOP_MAX_PATH];
+    int path_len;
+
+    Loop_Record *records; /* Ring of the last instructions executed functionally */
+    int record_slots;
+
+    long long iterations; /* Iterations extrapolated */
+    long long cycles;     /* Cycles extrapolated */
+} APEX_Loop;
+
+/* Notes an instruction EX executes in the iteration being measured */
+static inline void
+APEX_loop_record(APEX_Loop *loop, int pc)
+{
+    if (loop->path_len < LOOP_MAX_PATH)
+    {
+        loop->path[loop->path_len] = pc;
+    }
+    loop->path_len++;
+}
+
+int APEX_loop_supported(const APEX_CPU *cpu);
+int APEX_loop_probe(APEX_CPU *cpu);
+void APEX_loop_reset(APEX_CPU *cpu);
+
+/* Signatures and functional runs, shared with the block memo */
+size_t APEX_loop_capture(const APEX_CPU *cpu, Loop_Signature *sig);
+uint64_t APEX_loop_hash(const Loop_Signature *sig, size_t bytes);
+int APEX_loop_may_skip(const APEX_CPU *cpu);
+long long APEX_loop_cycles_left(const APEX_CPU *cpu);
+int APEX_loop_replayable(const APEX_CPU *cpu, int pc);
+int APEX_loop_window(APEX_CPU *cpu, CPU_Stage **done, int *n_done,
+                     CPU_Stage **issued, int *n_issued);
+int APEX_loop_complete(APEX_CPU *cpu, CPU_Stage *const *done, int n_done);
+int APEX_loop_reserve(APEX_Loop *loop, int insns);
+int APEX_loop_step(APEX_CPU *cpu, APEX_Loop *loop, long long executed, int *pc);
+void APEX_loop_take_back(APEX_CPU *cpu, const APEX_Loop *loop, long long executed,
+                         long long first);
+void APEX_loop_refill(APEX_CPU *cpu, const APEX_Loop *loop, CPU_Stage *const *done,
+                      int n_done, CPU_Stage *const *issued, int n_issued,
+                      long long first);
+#endif
@@ -12,9 +12,6 @@
 #define FALSE 0x0
 #define TRUE 0x1
 
-/* Integers */
-#define DATA_MEMORY_SIZE 4096
-
 /* Size of integer register file */
 #define REG_FILE_SIZE 16
 
@@ -42,10 +39,51 @@
 #define OPCODE_BNP 0x14
 #define OPCODE_CMP 0x15
 
-/* Set this flag to 1 to enable debug messages */
-#define ENABLE_DEBUG_MESSAGES 1
+/* One past the largest opcode, for tables indexed by opcode */
+#define OPCODE_COUNT 0x17
+
+/* Operand usage flags of an opcode */
+#define OPND_RS1 0x1     /* Reads rs1 */
+#define OPND_RS2 0x2     /* Reads rs2 */
+#define OPND_RD 0x4      /* Writes rd */
+#define OPND_RS1_DST 0x8 /* Writes rs1 back (LDI/STI address increment) */
+#define OPND_RD_MEM 0x10 /* rd is produced in MEM instead of EX */
+#define OPND_SETS_FLAGS 0x20  /* Sets the zero/positive flags in EX */
+#define OPND_READS_FLAGS 0x40 /* Conditional branch on the flags */
+#define OPND_CONTROL 0x80     /* Control transfer (branch or JUMP) */
+
+/* Pipeline stage identifiers */
+#define STAGE_FETCH 0x0
+#define STAGE_DECODE 0x1
+#define STAGE_EXECUTE 0x2
+#define STAGE_MEMORY 0x3
+#define STAGE_WRITEBACK 0x4
+
+/* Run loop variants, picked once from the operation at startup */
+#define RUN_QUIET 0x0       /* Final statistics only */
+#define RUN_TRACE 0x1       /* Stage reports as binary trace records */
+#define RUN_TEXT 0x2        /* Stage reports as text (display, simulate) */
+#define RUN_INTERACTIVE 0x3 /* Text plus register file and a prompt every cycle */
+#define RUN_TIMELINE 0x4    /* Instruction lifetimes to a timeline file */
 
-/* Set this flag to 1 to enable cycle single-step mode */
-#define ENABLE_SINGLE_STEP 1
+/* Reasons a run loop returns */
+#define STOP_BUDGET 0x0      /* Cycle budget of APEX_cpu_step used up */
+#define STOP_HALT 0x1        /* HALT retired */
+#define STOP_CYCLE_LIMIT 0x2 /* Cycle count given on the command line reached */
+#define STOP_FAULT 0x3       /* Data memory fault */
+#define STOP_QUIT 0x4        /* Quit at the single step prompt */
+
+/* Forwarding networks into D/RF, from none to full bypass. Each one gets
+ * its own compiled copy of the run loop */
+#define FWD_NONE 0x0   /* Register file only, written by WB before D/RF reads */
+#define FWD_EX 0x1     /* EX->D: an ALU result in the cycle EX computes it */
+#define FWD_EX_MEM 0x2 /* EX+MEM->D: ALU results from EX and from the EX/MEM latch */
+#define FWD_FULL 0x3   /* Full bypass: adds load data in the cycle MEM reads it */
+#define FWD_COUNT 0x4
+
+/* Forwarding network of a CPU unless --forwarding picks another */
+#ifndef APEX_DEFAULT_FORWARDING
+#define APEX_DEFAULT_FORWARDING FWD_FULL
+#endif
 
 #endif
@@ -0,0 +1,671 @@
+/*
+ * apex_memo.c
+ * Contains APEX block memo implementation
+ *
+ * A block is only kept if replaying it can rebuild everything it leaves
+ * behind: the instructions in MEM and WB at its end must be ones EX
+ * executed in it, so their data comes from the functional run, and its
+ * branches must have left the predictor tables as they were. The latches
+ * at the end are copied whole, so those holding no data come back exactly
+ * as simulated.
+ */
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_memo.h"
+
+/* Releases a block and what it holds */
+static void
+free_block(Memo_Block *block)
+{
+    if (block)
+    {
+        free(block->ring);
+        free(block->profile);
+        free(block->pcs);
+        free(block);
+    }
+}
+
+/* Forgets every block and releases the memo */
+void
+APEX_memo_reset(APEX_CPU *cpu)
+{
+    APEX_Memo *memo = cpu->memo;
+    int i;
+
+    if (memo)
+    {
+        for (i = 0; i < MEMO_SETS * MEMO_WAYS; ++i)
+        {
+            free_block(memo->blocks[i]);
+        }
+        free(memo->shadow);
+        free(memo->stamp);
+        free(memo);
+        cpu->memo = NULL;
+    }
+    cpu->memo_recording = FALSE;
+}
+
+/* First way of the set of blocks starting from a signature */
+static Memo_Block **
+set_of(APEX_Memo *memo, uint64_t hash, uint32_t history)
+{
+    return &memo->blocks[((uint32_t)(hash ^ (hash >> 32)) ^ history)
+                         % MEMO_SETS * MEMO_WAYS];
+}
+
+/* Returns TRUE if block starts from the pipeline at a probe */
+static int
+starts_here(const APEX_CPU *cpu, const Memo_Block *block, const Loop_Signature *sig,
+            size_t bytes, uint64_t hash)
+{
+    return block && block->hash == hash
+           && block->history == cpu->bpred.state.history
+           && block->bpred_version == cpu->bpred.version
+           && block->entry_bytes == bytes
+           && memcmp(&block->entry, sig, bytes) == 0;
+}
+
+/* Allocates the memo with a copy of the profile to follow */
+static APEX_Memo *
+new_memo(APEX_CPU *cpu)
+{
+    APEX_Memo *memo = calloc(1, sizeof(*memo));
+
+    if (!memo)
+    {
+        return NULL;
+    }
+
+    memo->shadow = malloc(cpu->code_memory_size * sizeof(APEX_Profile_Entry));
+    memo->stamp = calloc(cpu->code_memory_size, sizeof(unsigned));
+    if (!memo->shadow || !memo->stamp)
+    {
+        free(memo->shadow);
+        free(memo->stamp);
+        free(memo);
+        return NULL;
+    }
+    memo->shadow_stale = TRUE;
+    memo->length = MEMO_MIN_CYCLES;
+
+    return memo;
+}
+
+/* Starts recording the block that runs from a probe to the next one. A
+ * loop moved on at the probe has changed the profile all over */
+void
+APEX_memo_start_block(APEX_CPU *cpu, const Loop_Signature *sig, size_t bytes,
+                      uint64_t hash, int moved)
+{
+    APEX_Memo *memo = cpu->memo;
+
+    if (!memo)
+    {
+        memo = new_memo(cpu);
+        if (!memo)
+        {
+            cpu->block_memo = FALSE;
+            return;
+        }
+        cpu->memo = memo;
+    }
+
+    if (moved || memo->shadow_stale)
+    {
+        memcpy(memo->shadow, cpu->profile,
+               cpu->code_memory_size * sizeof(APEX_Profile_Entry));
+        memo->shadow_stale = FALSE;
+    }
+
+    memcpy(&memo->entry, sig, bytes);
+    memo->entry_bytes = bytes;
+    memo->hash = hash;
+    memo->history = cpu->bpred.state.history;
+    memo->bpred_version = cpu->bpred.version;
+    memo->clock = cpu->clock;
+    memo->pipe_clock = cpu->pipe_clock;
+    memo->insns = cpu->insn_completed;
+    memo->tag = cpu->issue_tag;
+    memo->counters = cpu->counters;
+    memo->path_start = cpu->loop->path_len;
+    memo->fetched_len = 0;
+    cpu->memo_recording = TRUE;
+}
+
+/* Returns TRUE if the block being recorded runs on through a probe: it
+ * is shorter than it is to be and can still be kept */
+int
+APEX_memo_goes_on(const APEX_CPU *cpu)
+{
+    const APEX_Memo *memo = cpu->memo;
+
+    return cpu->memo_recording && !cpu->fault
+           && cpu->clock - memo->clock < memo->length
+           && memo->fetched_len <= MEMO_MAX_FETCHED
+           && cpu->loop->path_len <= LOOP_MAX_PATH
+           && cpu->bpred.version == memo->bpred_version;
+}
+
+/* Stops recording the block, whose path the loop accelerator has taken
+ * over, without keeping it */
+void
+APEX_memo_drop_block(APEX_CPU *cpu)
+{
+    cpu->memo_recording = FALSE;
+    cpu->memo->shadow_stale = TRUE;
+}
+
+/* Takes the profile change of one instruction in, once per block, and
+ * returns the number of changes kept in the scratch list */
+static int
+take_profile(APEX_CPU *cpu, APEX_Memo *memo, int pc, int kept)
+{
+    const int index = (pc - 4000) / 4;
+    uint64_t *now, *then, *delta;
+    size_t i;
+    int changed = FALSE;
+
+    if (pc < 4000 || (pc - 4000) % 4 || index >= cpu->code_memory_size
+        || memo->stamp[index] == memo->block_id)
+    {
+        return kept;
+    }
+    memo->stamp[index] = memo->block_id;
+
+    now = (uint64_t *)&cpu->profile[index];
+    then = (uint64_t *)&memo->shadow[index];
+    delta = (uint64_t *)&memo->scratch[kept].delta;
+    for (i = 0; i < sizeof(APEX_Profile_Entry) / sizeof(uint64_t); ++i)
+    {
+        delta[i] = now[i] - then[i];
+        changed |= delta[i] != 0;
+    }
+    memo->shadow[index] = cpu->profile[index];
+
+    if (!changed)
+    {
+        return kept;
+    }
+    memo->scratch[kept].index = index;
+    return kept + 1;
+}
+
+/* Collects the profile change of the block being recorded into the
+ * scratch list and returns its length. Only the instructions in the
+ * latches at the start and those fetched since can have changed */
+static int
+collect_profile(APEX_CPU *cpu, APEX_Memo *memo)
+{
+    const Loop_Signature *entry = &memo->entry;
+    int kept = 0, i;
+
+    if (++memo->block_id == 0)
+    {
+        memset(memo->stamp, 0, cpu->code_memory_size * sizeof(unsigned));
+        memo->block_id = 1;
+    }
+
+    for (i = 0; i < 5; ++i)
+    {
+        kept = take_profile(cpu, memo, entry->stages[i].pc, kept);
+    }
+    for (i = 0; entry->in_flight && i < FU_MAX_LATENCY; ++i)
+    {
+        if (entry->ring[i].has_insn)
+        {
+            kept = take_profile(cpu, memo, entry->ring[i].pc, kept);
+        }
+    }
+    for (i = 0; i < memo->fetched_len; ++i)
+    {
+        kept = take_profile(cpu, memo, memo->fetched[i], kept);
+    }
+
+    return kept;
+}
+
+/* Returns TRUE if replaying the block just recorded can rebuild the state
+ * it ends in */
+static int
+replayable(const APEX_CPU *cpu, const APEX_Memo *memo, int path_len, int n_done)
+{
+    const APEX_Loop *loop = cpu->loop;
+    int i;
+
+    if (cpu->fault || cpu->clock == memo->clock
+        || cpu->pipe_clock - memo->pipe_clock != cpu->clock - memo->clock
+        || loop->path_len > LOOP_MAX_PATH || path_len < n_done
+        || cpu->bpred.version != memo->bpred_version)
+    {
+        return FALSE;
+    }
+
+    /* The instructions completed at the start and those executed */
+    for (i = 3; i < 5; ++i)
+    {
+        if (memo->entry.stages[i].has_insn
+            && !APEX_loop_replayable(cpu, memo->entry.stages[i].pc))
+        {
+            return FALSE;
+        }
+    }
+    for (i = memo->path_start; i < loop->path_len; ++i)
+    {
+        if (!APEX_loop_replayable(cpu, loop->path[i]))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* PC of the oldest instruction not yet issued to EX, which a functional
+ * run through those issued must come to */
+static int
+next_unissued(const APEX_CPU *cpu)
+{
+    if (cpu->decode.has_insn)
+    {
+        return cpu->decode.pc;
+    }
+    if (cpu->fetch.has_insn && cpu->fetch.isStalled)
+    {
+        return cpu->fetch.pc;
+    }
+    return cpu->pc;
+}
+
+/* Returns TRUE if block is the one just recorded, already in the memo */
+static int
+same_block(const Memo_Block *block, const APEX_Memo *memo, const int *pcs,
+           int path_len, int issued, int next_pc)
+{
+    return block && block->hash == memo->hash
+           && block->history == memo->history
+           && block->bpred_version == memo->bpred_version
+           && block->entry_bytes == memo->entry_bytes
+           && block->path_len == path_len && block->issued == issued
+           && block->next_pc == next_pc
+           && memcmp(&block->entry, &memo->entry, memo->entry_bytes) == 0
+           && memcmp(block->pcs, pcs, (path_len + issued) * sizeof(int)) == 0;
+}
+
+/* Way a new block of a set goes in: a free one, or the one least
+ * recently used, emptied */
+static Memo_Block **
+victim(APEX_Memo *memo, Memo_Block **set)
+{
+    Memo_Block **lru = set;
+    int way;
+
+    for (way = 0; way < MEMO_WAYS; ++way)
+    {
+        if (!set[way])
+        {
+            return &set[way];
+        }
+        if (set[way]->last_use < (*lru)->last_use)
+        {
+            lru = &set[way];
+        }
+    }
+
+    memo->evictions++;
+    free_block(*lru);
+    *lru = NULL;
+    return lru;
+}
+
+/*
+ * Ends the block being recorded at a probe with the given signature and
+ * keeps it if it can be replayed. The profile change is taken in either
+ * way, so the copy of the profile stays in step
+ */
+void
+APEX_memo_end_block(APEX_CPU *cpu, const Loop_Signature *sig)
+{
+    APEX_Memo *memo = cpu->memo;
+    APEX_Loop *loop = cpu->loop;
+    CPU_Stage *stages[] = {&cpu->fetch, &cpu->decode, &cpu->execute,
+                           &cpu->memory, &cpu->writeback};
+    CPU_Stage *done[2], *issued[FU_MAX_LATENCY + 1];
+    Memo_Block **set, **way_of, *block;
+    int n_done, n_issued, path_len, profile_len, way, i;
+    const int next_pc = next_unissued(cpu);
+
+    if (!cpu->memo_recording)
+    {
+        return;
+    }
+    cpu->memo_recording = FALSE;
+    memo->length = MEMO_MIN_CYCLES;
+
+    if (memo->fetched_len > MEMO_MAX_FETCHED)
+    {
+        memo->shadow_stale = TRUE;
+        return;
+    }
+    profile_len = collect_profile(cpu, memo);
+
+    path_len = loop->path_len - memo->path_start;
+    APEX_loop_window(cpu, done, &n_done, issued, &n_issued);
+    if (!replayable(cpu, memo, path_len, n_done))
+    {
+        return;
+    }
+
+    /* The path continues into the instructions issued to EX */
+    for (i = 0; i < n_issued; ++i)
+    {
+        APEX_loop_record(loop, issued[i]->pc);
+    }
+    if (loop->path_len > LOOP_MAX_PATH)
+    {
+        loop->path_len -= n_issued;
+        return;
+    }
+
+    set = set_of(memo, memo->hash, memo->history);
+    for (way = 0; way < MEMO_WAYS; ++way)
+    {
+        if (same_block(set[way], memo, &loop->path[memo->path_start], path_len,
+                       n_issued, next_pc))
+        {
+            set[way]->last_use = ++memo->uses;
+            loop->path_len -= n_issued;
+            return;
+        }
+    }
+
+    way_of = victim(memo, set);
+    block = malloc(sizeof(*block));
+    if (!block)
+    {
+        loop->path_len -= n_issued;
+        return;
+    }
+    block->pcs = malloc((path_len + n_issued) * sizeof(int) + 1);
+    block->profile = malloc(profile_len * sizeof(Memo_Profile_Delta) + 1);
+    block->ring = cpu->fu.in_flight ? malloc(sizeof(cpu->fu_ring)) : NULL;
+    if (!block->pcs || !block->profile || (cpu->fu.in_flight && !block->ring))
+    {
+        free_block(block);
+        loop->path_len -= n_issued;
+        return;
+    }
+
+    memcpy(block->pcs, &loop->path[memo->path_start],
+           (path_len + n_issued) * sizeof(int));
+    loop->path_len -= n_issued;
+    block->path_len = path_len;
+    block->issued = n_issued;
+    block->next_pc = next_pc;
+
+    memcpy(block->profile, memo->scratch, profile_len * sizeof(Memo_Profile_Delta));
+    block->profile_len = profile_len;
+
+    memcpy(&block->entry, &memo->entry, memo->entry_bytes);
+    block->entry_bytes = memo->entry_bytes;
+    block->hash = memo->hash;
+    block->history = memo->history;
+    block->bpred_version = memo->bpred_version;
+    memcpy(&block->exit, sig, offsetof(Loop_Signature, ring));
+    block->exit_history = cpu->bpred.state.history;
+
+    for (i = 0; i < 5; ++i)
+    {
+        block->stages[i] = *stages[i];
+        block->stages[i].tag -= cpu->issue_tag;
+    }
+    for (i = 0; block->ring && i < FU_MAX_LATENCY; ++i)
+    {
+        block->ring[i] = cpu->fu_ring[(cpu->pipe_clock + i) % FU_MAX_LATENCY];
+        block->ring[i].tag -= cpu->issue_tag;
+    }
+    block->last_complete = cpu->fu.last_complete - cpu->pipe_clock;
+    block->div_free = cpu->fu.div_free - cpu->pipe_clock;
+
+    block->cycles = cpu->clock - memo->clock;
+    block->insns = cpu->insn_completed - memo->insns;
+    block->tags = cpu->issue_tag - memo->tag;
+    block->counters = cpu->counters;
+    for (i = 0; i < (int)(sizeof(APEX_Counters) / sizeof(uint64_t)); ++i)
+    {
+        ((uint64_t *)&block->counters)[i] -= ((const uint64_t *)&memo->counters)[i];
+    }
+
+    block->last_use = ++memo->uses;
+    *way_of = block;
+}
+
+/* Returns TRUE if the functional run, executed instructions in, is
+ * through the whole of a block */
+static int
+at_end(const Memo_Block *block, long long executed, int pc)
+{
+    return executed == block->path_len + block->issued && pc == block->next_pc;
+}
+
+/* Returns TRUE if a block shares the first executed PCs of another and
+ * continues with pc */
+static int
+follows(const Memo_Block *block, const Memo_Block *from, long long executed, int pc)
+{
+    return executed < block->path_len + block->issued && block->pcs[executed] == pc
+           && memcmp(block->pcs, from->pcs, executed * sizeof(int)) == 0;
+}
+
+/* Puts the CPU in the state at the end of block, the functional run
+ * through it taken back to the instructions still in EX */
+static void
+apply_block(APEX_CPU *cpu, APEX_Memo *memo, const Memo_Block *block)
+{
+    CPU_Stage *stages[] = {&cpu->fetch, &cpu->decode, &cpu->execute,
+                           &cpu->memory, &cpu->writeback};
+    CPU_Stage *done[2], *issued[FU_MAX_LATENCY + 1], *slot;
+    const Loop_Signature *exit = &block->exit;
+    const int tag = cpu->issue_tag + block->tags;
+    const int pipe_clock = cpu->pipe_clock + block->cycles;
+    APEX_Profile_Entry *entry;
+    uint64_t *counters = (uint64_t *)&cpu->counters;
+    uint32_t pending;
+    int n_done, n_issued, reg, i, k;
+
+    cpu->clock += block->cycles;
+    cpu->pipe_clock = pipe_clock;
+    cpu->insn_completed += block->insns;
+    cpu->issue_tag = tag;
+    cpu->pc = exit->pc;
+    cpu->fetch_from_next_cycle = exit->fetch_from_next_cycle;
+    cpu->bpred.state.history = block->exit_history;
+
+    for (i = 0; i < 5; ++i)
+    {
+        *stages[i] = block->stages[i];
+        stages[i]->tag += tag;
+    }
+    for (i = 0; i < FU_MAX_LATENCY; ++i)
+    {
+        slot = &cpu->fu_ring[(pipe_clock + i) % FU_MAX_LATENCY];
+        if (block->ring)
+        {
+            *slot = block->ring[i];
+            slot->tag += tag;
+        }
+        else
+        {
+            slot->has_insn = FALSE;
+        }
+    }
+    cpu->fu.in_flight = exit->in_flight;
+    cpu->fu.last_complete = pipe_clock + block->last_complete;
+    cpu->fu.div_free = pipe_clock + block->div_free;
+
+    APEX_loop_window(cpu, done, &n_done, issued, &n_issued);
+    APEX_loop_refill(cpu, cpu->loop, done, n_done, issued, n_issued, block->path_len);
+
+    cpu->scoreboard.pending = exit->pending;
+    cpu->scoreboard.not_ready = exit->not_ready;
+    for (reg = 0; reg < REG_FILE_SIZE; ++reg)
+    {
+        cpu->valid_bit[reg] = (exit->pending >> reg) & 1;
+    }
+    pending = exit->pending;
+    while (pending)
+    {
+        reg = __builtin_ctz(pending);
+        cpu->scoreboard.producer_stage[reg] = exit->producer_stage[reg];
+        cpu->scoreboard.ready_cycle[reg] = exit->ready_cycle[reg] + pipe_clock;
+        cpu->fdata[reg] = exit->fdata[reg] + tag;
+        pending &= pending - 1;
+    }
+
+    for (i = 0; i < (int)(sizeof(APEX_Counters) / sizeof(uint64_t)); ++i)
+    {
+        counters[i] += ((const uint64_t *)&block->counters)[i];
+    }
+    for (i = 0; i < block->profile_len; ++i)
+    {
+        entry = &cpu->profile[block->profile[i].index];
+        for (k = 0; k < (int)(sizeof(APEX_Profile_Entry) / sizeof(uint64_t)); ++k)
+        {
+            ((uint64_t *)entry)[k] += ((const uint64_t *)&block->profile[i].delta)[k];
+        }
+        memo->shadow[block->profile[i].index] = *entry;
+    }
+
+    /* An iteration being measured goes on through the block */
+    if (cpu->loop->measured)
+    {
+        for (i = 0; i < block->path_len; ++i)
+        {
+            APEX_loop_record(cpu->loop, block->pcs[i]);
+        }
+    }
+}
+
+/*
+ * Replays a block starting from the pipeline at a probe, if the memo
+ * holds one whose path the functional run follows. Returns TRUE if the
+ * CPU has been put in the state at its end
+ */
+int
+APEX_memo_replay(APEX_CPU *cpu, const Loop_Signature *sig, size_t bytes,
+                 uint64_t hash)
+{
+    APEX_Memo *memo = cpu->memo;
+    APEX_Loop *loop = cpu->loop;
+    const uint32_t history = cpu->bpred.state.history;
+    Memo_Block **set, *cand[MEMO_WAYS], *block, *swap, *through, *diverged;
+    CPU_Stage *done[2], *issued[FU_MAX_LATENCY + 1];
+    int regs[REG_FILE_SIZE], zero_flag = cpu->zero_flag, pos_flag = cpu->pos_flag;
+    int n_cand = 0, longest = 0, n_done, n_issued, pc, way, i;
+    long long left, executed = 0;
+
+    if (!memo || !APEX_loop_may_skip(cpu))
+    {
+        return FALSE;
+    }
+
+    /* Blocks from this pipeline that end in time, longest first */
+    left = APEX_loop_cycles_left(cpu);
+    set = set_of(memo, hash, history);
+    for (way = 0; way < MEMO_WAYS; ++way)
+    {
+        block = set[way];
+        if (starts_here(cpu, block, sig, bytes, hash) && block->cycles <= left
+            && block->insns <= INT_MAX - cpu->insn_completed
+            && block->tags <= INT_MAX - cpu->issue_tag)
+        {
+            for (i = n_cand++; i > 0 && cand[i - 1]->cycles < block->cycles; --i)
+            {
+                cand[i] = cand[i - 1];
+            }
+            cand[i] = block;
+            if (block->path_len + block->issued > longest)
+            {
+                longest = block->path_len + block->issued;
+            }
+        }
+    }
+
+    pc = APEX_loop_window(cpu, done, &n_done, issued, &n_issued);
+    memcpy(regs, cpu->regs, sizeof(regs));
+    if (!n_cand || !APEX_loop_reserve(loop, longest)
+        || !APEX_loop_complete(cpu, done, n_done))
+    {
+        memcpy(cpu->regs, regs, sizeof(regs));
+        memo->misses++;
+        return FALSE;
+    }
+
+    /* Follow the longest block on the path the program takes, and replay
+     * the longest one it has gone all the way through */
+    block = cand[0];
+    through = NULL;
+    diverged = NULL;
+    while (block)
+    {
+        for (i = 0; i < n_cand; ++i)
+        {
+            if (at_end(cand[i], executed, pc)
+                && memcmp(cand[i]->pcs, block->pcs, executed * sizeof(int)) == 0)
+            {
+                through = cand[i];
+            }
+        }
+
+        if (through == block)
+        {
+            break;
+        }
+        if (executed == block->path_len + block->issued || pc != block->pcs[executed])
+        {
+            swap = NULL;
+            for (i = 0; i < n_cand && !swap; ++i)
+            {
+                swap = follows(cand[i], block, executed, pc) ? cand[i] : NULL;
+            }
+            diverged = block;
+            block = swap;
+        }
+        else if (APEX_loop_step(cpu, loop, executed, &pc))
+        {
+            executed++;
+        }
+        else
+        {
+            block = NULL;
+        }
+    }
+
+    /* Replaying a block the path went on well past wastes most of the
+     * functional run, and the path left the longest blocks: simulating on
+     * records one half as long as the last */
+    block = through;
+    if (!block || executed > 2 * (block->path_len + block->issued))
+    {
+        if (diverged && executed && diverged->cycles / 2 < memo->length)
+        {
+            memo->length = diverged->cycles / 2;
+        }
+        APEX_loop_take_back(cpu, loop, executed, 0);
+        memcpy(cpu->regs, regs, sizeof(regs));
+        cpu->zero_flag = zero_flag;
+        cpu->pos_flag = pos_flag;
+        memo->misses++;
+        return FALSE;
+    }
+
+    APEX_loop_take_back(cpu, loop, executed, block->path_len);
+    apply_block(cpu, memo, block);
+    block->last_use = ++memo->uses;
+    memo->hits++;
+    memo->cycles += block->cycles;
+    return TRUE;
+}
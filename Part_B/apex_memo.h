@@ -0,0 +1,131 @@
+/*
+ * apex_memo.h
+ * Contains APEX block memo declarations
+ *
+ * The block memo remembers the timing of the blocks of code run from one
+ * probe of the loop accelerator (apex_loop.h) to a later one: loop
+ * iterations, or the code leading from one loop to the next. A block is
+ * keyed by the signature of the pipeline at its start with the branch
+ * predictor's history and table version, and holds what simulating it
+ * did: the pipeline at its end, its cycles, the change in the counters
+ * and the profile, and the instructions EX executed. Blocks from the same
+ * start differ in the path their branches took.
+ *
+ * A probe whose pipeline starts blocks in the memo executes their
+ * instructions functionally while one of their paths is followed. The CPU
+ * is then put in that block's end state, with the data in its latches
+ * rebuilt from the functional run as the loop accelerator does, without
+ * simulating any of its cycles, and probes again there. A replay costs
+ * about as much as simulating a few cycles, so a block is recorded on
+ * through probes until it is MEMO_MIN_CYCLES long, and a replay follows
+ * the longest of the blocks that start from its pipeline. When the path
+ * leaves that block well past the end of any other, as it does in the last
+ * iterations of a loop, the pipeline simulates on and records a block half
+ * as long, so the blocks from a start come to halve in length down to one
+ * the path fits. The memo is set-associative and replaces the least
+ * recently used block of a set.
+ */
+#ifndef _APEX_MEMO_H_
+#define _APEX_MEMO_H_
+
+#include "apex_cpu.h"
+#include "apex_loop.h"
+
+#define MEMO_SETS 256         /* Sets of blocks, a power of two */
+#define MEMO_WAYS 8           /* Blocks per set */
+#define MEMO_MAX_FETCHED 1024 /* Fetches in the longest block recorded */
+#define MEMO_MIN_CYCLES 256   /* A block runs on through probes until this long */
+
+/* Change in the profile entry of one instruction over a block */
+typedef struct Memo_Profile_Delta
+{
+    int index;
+    APEX_Profile_Entry delta;
+} Memo_Profile_Delta;
+
+/* A block simulated once */
+typedef struct Memo_Block
+{
+    Loop_Signature entry;   /* Pipeline at the start */
+    size_t entry_bytes;
+    uint64_t hash;          /* Of entry */
+    uint32_t history;       /* Predictor history at the start */
+    unsigned bpred_version; /* Predictor tables, which the block leaves as they are */
+    unsigned last_use;
+
+    Loop_Signature exit;    /* Pipeline at the end, but for the completion slots */
+    uint32_t exit_history;
+    CPU_Stage stages[5];    /* Latches at the end, tags less the last one handed out */
+    CPU_Stage *ring;        /* Completion slots at the end from pipe_clock on, NULL if empty */
+    int last_complete;      /* Functional unit timestamps at the end, less pipe_clock */
+    int div_free;
+
+    int cycles;
+    int insns;                   /* Retired */
+    int tags;                    /* Handed out */
+    APEX_Counters counters;      /* Change over the block */
+    Memo_Profile_Delta *profile; /* Instructions whose profile changed */
+    int profile_len;
+
+    int *pcs;    /* PCs EX executed, then those issued to EX at the end */
+    int path_len; /* Of which executed */
+    int issued;   /* Of which issued */
+    int next_pc;  /* PC of the instruction after the issued ones */
+} Memo_Block;
+
+/* Block memo of a CPU */
+typedef struct APEX_Memo
+{
+    Memo_Block *blocks[MEMO_SETS * MEMO_WAYS]; /* NULL for a free way */
+    unsigned uses;
+
+    /* Block being recorded since the last probe */
+    Loop_Signature entry;
+    size_t entry_bytes;
+    uint64_t hash;
+    uint32_t history;
+    unsigned bpred_version;
+    int clock;
+    int pipe_clock;
+    int insns;
+    int tag;
+    APEX_Counters counters;
+    int length;     /* Cycles it runs for at least */
+    int path_start; /* In the loop accelerator's path */
+    int fetched[MEMO_MAX_FETCHED];
+    int fetched_len;
+
+    /* The profile as of the last probe, so that a block's change is found
+     * from the instructions it touched alone */
+    APEX_Profile_Entry *shadow;
+    unsigned *stamp;  /* Last block that took each instruction's change in */
+    unsigned block_id;
+    int shadow_stale; /* The profile changed outside a block */
+    Memo_Profile_Delta scratch[MEMO_MAX_FETCHED + 5 + FU_MAX_LATENCY];
+
+    long long hits;      /* Probes that replayed a block */
+    long long misses;    /* Probes that simulated on */
+    long long evictions; /* Blocks replaced */
+    long long cycles;    /* Cycles replayed */
+} APEX_Memo;
+
+/* Notes an instruction fetch fetches in the block being recorded */
+static inline void
+APEX_memo_fetched(APEX_Memo *memo, int pc)
+{
+    if (memo->fetched_len < MEMO_MAX_FETCHED)
+    {
+        memo->fetched[memo->fetched_len] = pc;
+    }
+    memo->fetched_len++;
+}
+
+void APEX_memo_start_block(APEX_CPU *cpu, const Loop_Signature *sig, size_t bytes,
+                           uint64_t hash, int moved);
+void APEX_memo_end_block(APEX_CPU *cpu, const Loop_Signature *sig);
+int APEX_memo_goes_on(const APEX_CPU *cpu);
+void APEX_memo_drop_block(APEX_CPU *cpu);
+int APEX_memo_replay(APEX_CPU *cpu, const Loop_Signature *sig, size_t bytes,
+                     uint64_t hash);
+void APEX_memo_reset(APEX_CPU *cpu);
+#endif
@@ -0,0 +1,376 @@
+/*
+ * apex_memory.c
+ * Contains APEX sparse data memory implementation
+ */
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "apex_memory.h"
+
+/* Empty memory spanning the whole address space */
+void
+APEX_mem_init(APEX_Memory *mem)
+{
+    mem->dir = NULL;
+    mem->last_page = MEM_NO_PAGE;
+    mem->last_words = NULL;
+    mem->limit = MEM_ADDRESS_SPACE;
+    mem->pages = 0;
+}
+
+/* Releases every page and table, leaving empty memory with the same limit */
+void
+APEX_mem_free(APEX_Memory *mem)
+{
+    uint64_t limit = mem->limit;
+    uint32_t d, t;
+
+    if (mem->dir)
+    {
+        for (d = 0; d < MEM_DIR_ENTRIES; ++d)
+        {
+            if (!mem->dir[d])
+            {
+                continue;
+            }
+            for (t = 0; t < MEM_TABLE_ENTRIES; ++t)
+            {
+                free(mem->dir[d]->page[t]);
+            }
+            free(mem->dir[d]);
+        }
+        free(mem->dir);
+    }
+
+    APEX_mem_init(mem);
+    mem->limit = limit;
+}
+
+/*
+ * Makes addresses from limit up fault. Returns FALSE unless limit is a
+ * whole number of pages within the address space
+ */
+int
+APEX_mem_set_limit(APEX_Memory *mem, uint64_t limit)
+{
+    if (limit == 0 || limit > MEM_ADDRESS_SPACE || limit % MEM_PAGE_WORDS)
+    {
+        return FALSE;
+    }
+
+    mem->limit = limit;
+    mem->last_page = MEM_NO_PAGE;
+    mem->last_words = NULL;
+    return TRUE;
+}
+
+/* Page table walk: the words of a page, NULL if it was never written */
+static int32_t *
+find_page(const APEX_Memory *mem, uint32_t page)
+{
+    const APEX_Mem_Table *table;
+
+    if (!mem->dir)
+    {
+        return NULL;
+    }
+
+    table = mem->dir[page >> MEM_TABLE_BITS];
+    return table ? table->page[page & (MEM_TABLE_ENTRIES - 1)] : NULL;
+}
+
+/* Returns the words of a page, NULL if it was never written */
+const int32_t *
+APEX_mem_page(const APEX_Memory *mem, uint32_t page)
+{
+    return find_page(mem, page);
+}
+
+/* Returns the first page from page on that has been written, MEM_NO_PAGE
+ * if there is none */
+uint32_t
+APEX_mem_next_page(const APEX_Memory *mem, uint32_t page)
+{
+    uint32_t d, t;
+
+    if (!mem->dir)
+    {
+        return MEM_NO_PAGE;
+    }
+
+    for (d = page >> MEM_TABLE_BITS; d < MEM_DIR_ENTRIES; ++d)
+    {
+        if (!mem->dir[d])
+        {
+            continue;
+        }
+        t = d == page >> MEM_TABLE_BITS ? page & (MEM_TABLE_ENTRIES - 1) : 0;
+        for (; t < MEM_TABLE_ENTRIES; ++t)
+        {
+            if (mem->dir[d]->page[t])
+            {
+                return d << MEM_TABLE_BITS | t;
+            }
+        }
+    }
+
+    return MEM_NO_PAGE;
+}
+
+/*
+ * Returns the words of a page for writing, allocating the page and its
+ * table as needed. Returns NULL if the page is beyond the limit or cannot
+ * be allocated
+ */
+int32_t *
+APEX_mem_page_for_write(APEX_Memory *mem, uint32_t page)
+{
+    APEX_Mem_Table **table;
+    int32_t **words;
+
+    if ((uint64_t)page * MEM_PAGE_WORDS >= mem->limit)
+    {
+        return NULL;
+    }
+
+    if (!mem->dir)
+    {
+        mem->dir = calloc(MEM_DIR_ENTRIES, sizeof(*mem->dir));
+        if (!mem->dir)
+        {
+            return NULL;
+        }
+    }
+
+    table = &mem->dir[page >> MEM_TABLE_BITS];
+    if (!*table)
+    {
+        *table = calloc(1, sizeof(**table));
+        if (!*table)
+        {
+            return NULL;
+        }
+    }
+
+    words = &(*table)->page[page & (MEM_TABLE_ENTRIES - 1)];
+    if (!*words)
+    {
+        *words = calloc(MEM_PAGE_WORDS, sizeof(int32_t));
+        if (!*words)
+        {
+            return NULL;
+        }
+        mem->pages++;
+    }
+
+    return *words;
+}
+
+/* Read that missed the last page: walks the page table */
+int
+APEX_mem_read_slow(APEX_Memory *mem, uint32_t addr, int *value)
+{
+    int32_t *words;
+
+    if (addr >= mem->limit)
+    {
+        return FALSE;
+    }
+
+    words = find_page(mem, addr >> MEM_PAGE_BITS);
+    if (!words)
+    {
+        *value = 0;
+        return TRUE;
+    }
+
+    mem->last_page = addr >> MEM_PAGE_BITS;
+    mem->last_words = words;
+    *value = words[addr & (MEM_PAGE_WORDS - 1)];
+    return TRUE;
+}
+
+/* Write that missed the last page: walks the page table, allocating */
+int
+APEX_mem_write_slow(APEX_Memory *mem, uint32_t addr, int value)
+{
+    int32_t *words;
+
+    if (addr >= mem->limit)
+    {
+        return FALSE;
+    }
+
+    words = APEX_mem_page_for_write(mem, addr >> MEM_PAGE_BITS);
+    if (!words)
+    {
+        return FALSE;
+    }
+
+    mem->last_page = addr >> MEM_PAGE_BITS;
+    mem->last_words = words;
+    words[addr & (MEM_PAGE_WORDS - 1)] = value;
+    return TRUE;
+}
+
+/* Returns TRUE if one of n words is not zero */
+static int
+any_nonzero(const int32_t *words, uint32_t n)
+{
+    uint32_t i;
+
+    for (i = 0; i < n; ++i)
+    {
+        if (words[i])
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/*
+ * Copies a raw file of 32-bit words into memory from address 0, mapping the
+ * file instead of reading it, over any data already there. Only pages that
+ * get a non-zero word are allocated. Returns FALSE if the file cannot be mapped, is not a whole
+ * number of words or does not fit below the limit
+ */
+int
+APEX_mem_load_image(APEX_Memory *mem, const char *path)
+{
+    struct stat st;
+    const int32_t *words;
+    int32_t *page;
+    uint64_t addr, n, chunk;
+    void *map;
+    int fd, ok = TRUE;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return FALSE;
+    }
+
+    if (fstat(fd, &st) < 0 || st.st_size % sizeof(int32_t)
+        || (uint64_t)st.st_size / sizeof(int32_t) > mem->limit)
+    {
+        close(fd);
+        return FALSE;
+    }
+
+    if (st.st_size == 0)
+    {
+        close(fd);
+        return TRUE;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return FALSE;
+    }
+
+    words = map;
+    n = st.st_size / sizeof(int32_t);
+    for (addr = 0; ok && addr < n; addr += chunk)
+    {
+        chunk = n - addr < MEM_PAGE_WORDS ? n - addr : MEM_PAGE_WORDS;
+        if (any_nonzero(&words[addr], chunk))
+        {
+            page = APEX_mem_page_for_write(mem, addr >> MEM_PAGE_BITS);
+            ok = page != NULL;
+        }
+        else
+        {
+            /* Zeros need no page, but replace any data already there */
+            page = find_page(mem, addr >> MEM_PAGE_BITS);
+        }
+
+        if (page)
+        {
+            memcpy(page, &words[addr], chunk * sizeof(int32_t));
+        }
+    }
+
+    munmap(map, st.st_size);
+    return ok;
+}
+
+/*
+ * Writes memory to a raw file of 32-bit words from address 0 up to the last
+ * non-zero word, through a shared mapping of the file. Pages never written
+ * are left as holes in the file. Returns FALSE if the file cannot be
+ * written
+ */
+int
+APEX_mem_dump_image(const APEX_Memory *mem, const char *path)
+{
+    const int32_t *words;
+    uint64_t end = 0;
+    uint32_t page, i;
+    int32_t *map;
+    size_t len;
+    int fd, ok;
+
+    /* The file ends after the last non-zero word */
+    for (page = APEX_mem_next_page(mem, 0); page != MEM_NO_PAGE;
+         page = APEX_mem_next_page(mem, page + 1))
+    {
+        words = APEX_mem_page(mem, page);
+        i = MEM_PAGE_WORDS;
+        while (i > 0 && !words[i - 1])
+        {
+            --i;
+        }
+        if (i)
+        {
+            end = (uint64_t)page * MEM_PAGE_WORDS + i;
+        }
+    }
+    len = end * sizeof(int32_t);
+
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return FALSE;
+    }
+
+    ok = ftruncate(fd, len) == 0;
+    if (ok && len)
+    {
+        map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ok = map != MAP_FAILED;
+        for (page = APEX_mem_next_page(mem, 0);
+             ok && page != MEM_NO_PAGE && page <= (end - 1) >> MEM_PAGE_BITS;
+             page = APEX_mem_next_page(mem, page + 1))
+        {
+            /* Only the last page can reach past the end of the file */
+            words = APEX_mem_page(mem, page);
+            i = page == (end - 1) >> MEM_PAGE_BITS
+                    ? end - (uint64_t)page * MEM_PAGE_WORDS
+                    : MEM_PAGE_WORDS;
+            if (any_nonzero(words, i))
+            {
+                memcpy(&map[(uint64_t)page * MEM_PAGE_WORDS], words,
+                       i * sizeof(int32_t));
+            }
+        }
+        if (ok)
+        {
+            ok = munmap(map, len) == 0;
+        }
+    }
+
+    if (close(fd) != 0)
+    {
+        ok = FALSE;
+    }
+
+    return ok;
+}
@@ -0,0 +1,89 @@
+/*
+ * apex_memory.h
+ * Contains APEX sparse data memory declarations
+ *
+ * Data memory is an array of 32-bit words indexed by address, as before,
+ * but over a 32-bit address space. It is split into 4 KB pages that are
+ * allocated the first time they are written and found through a two-level
+ * page table: a directory of tables, each mapping MEM_TABLE_ENTRIES pages,
+ * both allocated on demand too. Reading a page never written gives zeros
+ * without allocating it, so memory use follows what a program stores to.
+ * Accesses go through the page used last without a table walk. Addresses
+ * from the limit up fault instead of touching memory.
+ *
+ * A memory image is a raw file of 32-bit words in host byte order, the
+ * word at offset 4 * n being address n.
+ */
+#ifndef _APEX_MEMORY_H_
+#define _APEX_MEMORY_H_
+
+#include <stdint.h>
+
+#include "apex_macros.h"
+
+/* Page geometry: a 32-bit address is directory, table and word index */
+#define MEM_PAGE_BITS 10
+#define MEM_TABLE_BITS 11
+#define MEM_DIR_BITS 11
+#define MEM_PAGE_WORDS (1u << MEM_PAGE_BITS)     /* 4 KB of words */
+#define MEM_TABLE_ENTRIES (1u << MEM_TABLE_BITS)
+#define MEM_DIR_ENTRIES (1u << MEM_DIR_BITS)
+
+/* Size of the address space, and page number of no page */
+#define MEM_ADDRESS_SPACE (1ull << 32)
+#define MEM_NO_PAGE UINT32_MAX
+
+/* Second-level table: the pages of one directory entry */
+typedef struct APEX_Mem_Table
+{
+    int32_t *page[MEM_TABLE_ENTRIES]; /* NULL until written */
+} APEX_Mem_Table;
+
+/* Sparse data memory */
+typedef struct APEX_Memory
+{
+    APEX_Mem_Table **dir; /* MEM_DIR_ENTRIES tables, NULL until memory is written */
+    uint32_t last_page;   /* Page number of last_words, MEM_NO_PAGE for none */
+    int32_t *last_words;  /* Page used last */
+    uint64_t limit;       /* Addresses from here up fault, a multiple of MEM_PAGE_WORDS */
+    uint32_t pages;       /* Pages allocated */
+} APEX_Memory;
+
+int APEX_mem_read_slow(APEX_Memory *mem, uint32_t addr, int *value);
+int APEX_mem_write_slow(APEX_Memory *mem, uint32_t addr, int value);
+
+/* Reads the word at addr into value. Returns FALSE on a fault */
+static inline int
+APEX_mem_read(APEX_Memory *mem, uint32_t addr, int *value)
+{
+    if (addr >> MEM_PAGE_BITS == mem->last_page)
+    {
+        *value = mem->last_words[addr & (MEM_PAGE_WORDS - 1)];
+        return TRUE;
+    }
+
+    return APEX_mem_read_slow(mem, addr, value);
+}
+
+/* Writes value to the word at addr. Returns FALSE on a fault */
+static inline int
+APEX_mem_write(APEX_Memory *mem, uint32_t addr, int value)
+{
+    if (addr >> MEM_PAGE_BITS == mem->last_page)
+    {
+        mem->last_words[addr & (MEM_PAGE_WORDS - 1)] = value;
+        return TRUE;
+    }
+
+    return APEX_mem_write_slow(mem, addr, value);
+}
+
+void APEX_mem_init(APEX_Memory *mem);
+void APEX_mem_free(APEX_Memory *mem);
+int APEX_mem_set_limit(APEX_Memory *mem, uint64_t limit);
+const int32_t *APEX_mem_page(const APEX_Memory *mem, uint32_t page);
+uint32_t APEX_mem_next_page(const APEX_Memory *mem, uint32_t page);
+int32_t *APEX_mem_page_for_write(APEX_Memory *mem, uint32_t page);
+int APEX_mem_load_image(APEX_Memory *mem, const char *path);
+int APEX_mem_dump_image(const APEX_Memory *mem, const char *path);
+#endif
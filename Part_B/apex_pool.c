@@ -0,0 +1,201 @@
+/*
+ * apex_pool.c
+ * Contains the work-stealing simulation thread pool implementation
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "apex_pool.h"
+
+struct Pool;
+
+/* Deque of job indices owned by a worker */
+typedef struct Pool_Worker
+{
+    pthread_mutex_t lock;
+    int *jobs;
+    int head; /* Next job a thief takes */
+    int tail; /* One past the next job the owner takes */
+    struct Pool *pool;
+    int index;
+    int has_sim; /* Created its simulator */
+} Pool_Worker;
+
+typedef struct Pool
+{
+    Pool_Worker *workers;
+    int worker_count;
+    APEX_Pool_Job job;
+    void *arg;
+} Pool;
+
+/*
+ * Number of threads to run jobs on: requested, or one per online CPU for
+ * 0, but never more than there are jobs or POOL_MAX_THREADS
+ */
+int
+APEX_pool_threads(int requested, int jobs)
+{
+    long threads = requested;
+
+    if (threads <= 0)
+    {
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (threads > POOL_MAX_THREADS)
+    {
+        threads = POOL_MAX_THREADS;
+    }
+    if (threads > jobs)
+    {
+        threads = jobs;
+    }
+
+    return threads < 1 ? 1 : threads;
+}
+
+/* Takes the job at the back of the worker's own deque, -1 if it is empty */
+static int
+pop_job(Pool_Worker *w)
+{
+    int job = -1;
+
+    pthread_mutex_lock(&w->lock);
+    if (w->head < w->tail)
+    {
+        job = w->jobs[--w->tail];
+    }
+    pthread_mutex_unlock(&w->lock);
+    return job;
+}
+
+/* Takes the job at the front of another worker's deque, -1 if all are
+ * empty. Jobs are never added once the pool starts, so empty stays empty */
+static int
+steal_job(Pool_Worker *w)
+{
+    Pool *pool = w->pool;
+    Pool_Worker *victim;
+    int i, job = -1;
+
+    for (i = 1; job < 0 && i < pool->worker_count; ++i)
+    {
+        victim = &pool->workers[(w->index + i) % pool->worker_count];
+        pthread_mutex_lock(&victim->lock);
+        if (victim->head < victim->tail)
+        {
+            job = victim->jobs[victim->head++];
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+
+    return job;
+}
+
+static void *
+worker_main(void *arg)
+{
+    Pool_Worker *w = arg;
+    APEX_Config config;
+    APEX_Sim *sim;
+    int job;
+
+    /* Without a simulator the other workers steal this one's jobs */
+    apex_config_default(&config);
+    sim = apex_create(&config);
+    if (!sim)
+    {
+        return NULL;
+    }
+    w->has_sim = TRUE;
+
+    while ((job = pop_job(w)) >= 0 || (job = steal_job(w)) >= 0)
+    {
+        w->pool->job(sim, job, w->pool->arg);
+    }
+
+    apex_destroy(sim);
+    return NULL;
+}
+
+/*
+ * Runs every job from 0 to jobs - 1 on threads workers and waits for all
+ * of them. Returns FALSE, having run nothing, if the workers cannot be
+ * started or none of them can create a simulator
+ */
+int
+APEX_pool_run(int jobs, int threads, APEX_Pool_Job job, void *arg)
+{
+    pthread_t *tids;
+    Pool_Worker *w;
+    Pool pool;
+    int i, started = 0, ok;
+
+    pool.worker_count = threads;
+    pool.job = job;
+    pool.arg = arg;
+    pool.workers = calloc(threads, sizeof(Pool_Worker));
+    tids = calloc(threads, sizeof(pthread_t));
+    ok = pool.workers && tids;
+
+    for (i = 0; ok && i < threads; ++i)
+    {
+        w = &pool.workers[i];
+        w->jobs = malloc((jobs / threads + 1) * sizeof(int));
+        w->pool = &pool;
+        w->index = i;
+        ok = w->jobs != NULL;
+    }
+
+    if (ok)
+    {
+        /* Jobs go in highest first; each owner works back to front, so it
+         * starts on its lowest job while thieves take its highest */
+        for (i = jobs - 1; i >= 0; --i)
+        {
+            w = &pool.workers[i % threads];
+            w->jobs[w->tail++] = i;
+        }
+
+        for (i = 0; i < threads; ++i)
+        {
+            pthread_mutex_init(&pool.workers[i].lock, NULL);
+        }
+
+        /* Workers that do start steal the jobs of any that do not */
+        for (; started < threads; ++started)
+        {
+            if (pthread_create(&tids[started], NULL, worker_main,
+                               &pool.workers[started]) != 0)
+            {
+                break;
+            }
+        }
+
+        /* A worker may steal from any other until it has finished */
+        for (i = 0; i < started; ++i)
+        {
+            pthread_join(tids[i], NULL);
+        }
+
+        /* One worker with a simulator runs every job the others leave */
+        ok = FALSE;
+        for (i = 0; i < started; ++i)
+        {
+            ok |= pool.workers[i].has_sim;
+        }
+        for (i = 0; i < threads; ++i)
+        {
+            pthread_mutex_destroy(&pool.workers[i].lock);
+        }
+    }
+
+    for (i = 0; pool.workers && i < threads; ++i)
+    {
+        free(pool.workers[i].jobs);
+    }
+    free(pool.workers);
+    free(tids);
+    return ok;
+}
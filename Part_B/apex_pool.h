@@ -0,0 +1,23 @@
+/*
+ * apex_pool.h
+ * Contains the work-stealing simulation thread pool declarations
+ *
+ * The pool runs a fixed set of jobs, numbered from 0, on worker threads
+ * that each own one simulator for every job they run. Jobs are dealt out
+ * round robin into a deque per worker; a worker takes jobs from the back
+ * of its own deque and, once that is empty, steals from the front of
+ * another's, so workers that draw short jobs help out with the long ones.
+ */
+#ifndef _APEX_POOL_H_
+#define _APEX_POOL_H_
+
+#include "apex.h"
+
+#define POOL_MAX_THREADS 256
+
+/* Runs job index on the worker's simulator */
+typedef void (*APEX_Pool_Job)(APEX_Sim *sim, int index, void *arg);
+
+int APEX_pool_threads(int requested, int jobs);
+int APEX_pool_run(int jobs, int threads, APEX_Pool_Job job, void *arg);
+#endif
@@ -0,0 +1,102 @@
+/*
+ * apex_profile.c
+ * Contains APEX per-PC profiler reporting
+ *
+ * The report is an annotated listing of the program sorted by cost, where
+ * the cost of an instruction is the cycles it spent in the stages plus the
+ * fetch slots every misprediction of it loses: those between F and the
+ * stage branches resolve in, as in the counters report.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "apex_cpu.h"
+#include "apex_profile.h"
+#include "apex_trace.h"
+
+/* Code memory index with its cost, the unit the report sorts */
+typedef struct Profile_Order
+{
+    uint64_t cost;
+    int index;
+} Profile_Order;
+
+static uint64_t
+entry_cost(const APEX_Profile_Entry *e, const int flush_penalty)
+{
+    uint64_t cost = e->flushes * flush_penalty;
+    int i;
+
+    for (i = 0; i <= STAGE_WRITEBACK; ++i)
+    {
+        cost += e->stage_cycles[i];
+    }
+
+    return cost;
+}
+
+/* Orders code memory indices by descending cost, then by address */
+static int
+compare_cost(const void *a, const void *b)
+{
+    const Profile_Order *oa = a, *ob = b;
+
+    if (oa->cost != ob->cost)
+    {
+        return oa->cost < ob->cost ? 1 : -1;
+    }
+
+    return oa->index - ob->index;
+}
+
+/* Prints the annotated listing, costliest instruction first */
+void
+APEX_profile_report(const APEX_CPU *cpu, FILE *out)
+{
+    const APEX_Profile_Entry *e;
+    const int flush_penalty = cpu->branch_stage - STAGE_FETCH;
+    uint64_t total = 0;
+    Profile_Order *order;
+    int i;
+
+    order = malloc(cpu->code_memory_size * sizeof(*order));
+    if (!order)
+    {
+        return;
+    }
+
+    for (i = 0; i < cpu->code_memory_size; ++i)
+    {
+        order[i].index = i;
+        order[i].cost = entry_cost(&cpu->profile[i], flush_penalty);
+        total += order[i].cost;
+    }
+
+    qsort(order, cpu->code_memory_size, sizeof(*order), compare_cost);
+
+    fprintf(out, "-------------------------------------------\n%s\n-------------------------------------------\n",
+            " PROFILE BY INSTRUCTION (sorted by cost):");
+    fprintf(out, "%-6s %8s %6s %8s %7s %7s %7s %7s %7s %7s %7s  %s\n", "pc",
+            "cost", "%", "retired", "stalls", "flushes", "F", "DRF", "EX",
+            "MEM", "WB", "instruction");
+
+    for (i = 0; i < cpu->code_memory_size; ++i)
+    {
+        e = &cpu->profile[order[i].index];
+        fprintf(out, "%-6d %8llu %5.1f%% %8llu %7llu %7llu %7llu %7llu %7llu %7llu %7llu  ",
+                4000 + 4 * order[i].index, (unsigned long long)order[i].cost,
+                total ? 100.0 * order[i].cost / total : 0.0,
+                (unsigned long long)e->retired,
+                (unsigned long long)e->stall_cycles,
+                (unsigned long long)e->flushes,
+                (unsigned long long)e->stage_cycles[STAGE_FETCH],
+                (unsigned long long)e->stage_cycles[STAGE_DECODE],
+                (unsigned long long)e->stage_cycles[STAGE_EXECUTE],
+                (unsigned long long)e->stage_cycles[STAGE_MEMORY],
+                (unsigned long long)e->stage_cycles[STAGE_WRITEBACK]);
+        APEX_format_instruction(out, &cpu->code_memory[order[i].index]);
+        fprintf(out, "\n");
+    }
+
+    free(order);
+}
@@ -0,0 +1,30 @@
+/*
+ * apex_profile.h
+ * Contains APEX per-PC profiler declarations
+ *
+ * The profile is a flat array with one entry per instruction in code
+ * memory, indexed like code memory. The stages charge each cycle they hold
+ * an instruction to its entry, so profiling costs one increment per busy
+ * stage per cycle.
+ */
+#ifndef _APEX_PROFILE_H_
+#define _APEX_PROFILE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "apex_macros.h"
+
+struct APEX_CPU;
+
+/* Cost charged to one instruction address (64 bytes) */
+typedef struct APEX_Profile_Entry
+{
+    uint64_t retired;      /* Times retired from writeback */
+    uint64_t stall_cycles; /* Cycles stalled in D/RF */
+    uint64_t flushes;      /* Mispredictions redirecting fetch */
+    uint64_t stage_cycles[STAGE_WRITEBACK + 1]; /* Cycles in each stage */
+} APEX_Profile_Entry;
+
+void APEX_profile_report(const struct APEX_CPU *cpu, FILE *out);
+#endif
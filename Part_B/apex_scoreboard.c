@@ -0,0 +1,129 @@
+/*
+ * apex_scoreboard.c
+ * Contains APEX register scoreboard implementation
+ *
+ * A register is pending from the cycle its writer leaves D/RF until that
+ * writer reaches writeback. While pending, its value is read from the
+ * forwarding buffer once the writer has produced it (EX for arithmetic,
+ * MEM for loads), and decode must stall before that.
+ */
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_scoreboard.h"
+
+/* Option names of the forwarding networks, indexed by FWD_* */
+static const char *const forwarding_names[FWD_COUNT] = {
+    [FWD_NONE] = "none",
+    [FWD_EX] = "ex",
+    [FWD_EX_MEM] = "ex-mem",
+    [FWD_FULL] = "full",
+};
+
+/* Clears all in-flight writers */
+void
+scoreboard_reset(APEX_CPU *cpu)
+{
+    memset(&cpu->scoreboard, 0, sizeof(cpu->scoreboard));
+    memset(cpu->valid_bit, 0, sizeof(cpu->valid_bit));
+    memset(cpu->fdata, 0, sizeof(cpu->fdata));
+}
+
+/* Returns the stage a source operand is forwarded from, or SB_SRC_REGFILE
+ * when it has no in-flight writer */
+int
+scoreboard_source(const APEX_CPU *cpu, int reg)
+{
+    if (!(cpu->scoreboard.pending & REG_BIT(reg)))
+    {
+        return SB_SRC_REGFILE;
+    }
+
+    return cpu->scoreboard.producer_stage[reg];
+}
+
+/* Makes the instruction with this tag the youngest writer of every register
+ * in dst_mask; older writers still in flight no longer own the register */
+void
+scoreboard_issue(APEX_CPU *cpu, uint32_t dst_mask, int tag)
+{
+    cpu->scoreboard.pending |= dst_mask;
+    cpu->scoreboard.not_ready |= dst_mask;
+
+    while (dst_mask)
+    {
+        int reg = __builtin_ctz(dst_mask);
+
+        cpu->valid_bit[reg] = 1;
+        cpu->fdata[reg] = tag;
+        cpu->scoreboard.producer_stage[reg] = STAGE_DECODE;
+        dst_mask &= dst_mask - 1;
+    }
+}
+
+/* Marks the values of dst_mask produced in stage by the instruction with this
+ * tag as forwardable, unless a younger writer has taken over the register */
+void
+scoreboard_produce(APEX_CPU *cpu, uint32_t dst_mask, int tag, int stage)
+{
+    while (dst_mask)
+    {
+        int reg = __builtin_ctz(dst_mask);
+
+        if (cpu->fdata[reg] == tag)
+        {
+            cpu->scoreboard.not_ready &= ~REG_BIT(reg);
+            cpu->scoreboard.producer_stage[reg] = stage;
+            cpu->scoreboard.ready_cycle[reg] = cpu->pipe_clock;
+        }
+        dst_mask &= dst_mask - 1;
+    }
+}
+
+/* Releases the registers of dst_mask still owned by the instruction with
+ * this tag once it has written them to the register file */
+void
+scoreboard_retire(APEX_CPU *cpu, uint32_t dst_mask, int tag)
+{
+    while (dst_mask)
+    {
+        int reg = __builtin_ctz(dst_mask);
+
+        if (cpu->fdata[reg] == tag)
+        {
+            cpu->valid_bit[reg] = 0;
+            cpu->scoreboard.pending &= ~REG_BIT(reg);
+            cpu->scoreboard.not_ready &= ~REG_BIT(reg);
+        }
+        dst_mask &= dst_mask - 1;
+    }
+}
+
+/* Returns the option name of a forwarding network */
+const char *
+scoreboard_forwarding_name(int fwd)
+{
+    if (fwd < 0 || fwd >= FWD_COUNT)
+    {
+        return "???";
+    }
+
+    return forwarding_names[fwd];
+}
+
+/* Returns the forwarding network named by an option, or -1 if there is none */
+int
+scoreboard_forwarding_parse(const char *name)
+{
+    int fwd;
+
+    for (fwd = 0; fwd < FWD_COUNT; ++fwd)
+    {
+        if (strcmp(name, forwarding_names[fwd]) == 0)
+        {
+            return fwd;
+        }
+    }
+
+    return -1;
+}
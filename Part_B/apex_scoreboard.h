@@ -0,0 +1,86 @@
+/*
+ * apex_scoreboard.h
+ * Contains APEX register scoreboard declarations
+ *
+ * The scoreboard tracks, for every register, its youngest in-flight writer
+ * (the sequence tag handed out at fetch, kept in fdata[]), the stage that
+ * produced its value and the cycle the value became forwardable. Decode asks it whether
+ * an instruction can issue and where each source operand comes from, using
+ * bitmask operations only. Whether a produced value is forwardable depends on
+ * the forwarding network (FWD_*), which the run loop passes as a constant.
+ */
+#ifndef _APEX_SCOREBOARD_H_
+#define _APEX_SCOREBOARD_H_
+
+#include <stdint.h>
+
+#include "apex_macros.h"
+
+#if REG_FILE_SIZE > 32
+#error "Scoreboard register masks hold at most 32 registers"
+#endif
+
+/* Register number to scoreboard mask bit */
+#define REG_BIT(r) (1u << (r))
+
+/* Source operand origin returned by scoreboard_source() */
+#define SB_SRC_REGFILE -1
+
+struct APEX_CPU;
+
+/* Register scoreboard */
+typedef struct APEX_Scoreboard
+{
+    uint32_t pending;   /* Register has an in-flight writer (valid_bit) */
+    uint32_t not_ready; /* Youngest writer has not produced its value yet */
+    uint8_t producer_stage[REG_FILE_SIZE]; /* Stage that produced the value */
+    int ready_cycle[REG_FILE_SIZE];        /* Cycle the value became forwardable */
+} APEX_Scoreboard;
+
+/*
+ * Returns the sources in src_mask that the fwd network cannot deliver to
+ * D/RF this cycle, zero means the instruction can issue this cycle. The EX
+ * and EX+MEM networks only carry ALU results, for one and two cycles after
+ * EX computes them; beyond that a source waits for writeback
+ */
+static inline uint32_t
+scoreboard_must_stall(const APEX_Scoreboard *sb, uint32_t src_mask,
+                      int clock, const int fwd)
+{
+    uint32_t blocked = src_mask & sb->pending;
+    uint32_t waiting;
+
+    if (fwd == FWD_NONE)
+    {
+        return blocked;
+    }
+
+    if (fwd == FWD_FULL)
+    {
+        return src_mask & sb->not_ready;
+    }
+
+    waiting = blocked;
+    while (waiting)
+    {
+        int reg = __builtin_ctz(waiting);
+
+        if (sb->producer_stage[reg] == STAGE_EXECUTE
+            && clock - sb->ready_cycle[reg] <= (fwd == FWD_EX_MEM))
+        {
+            blocked &= ~REG_BIT(reg);
+        }
+        waiting &= waiting - 1;
+    }
+
+    return blocked;
+}
+
+void scoreboard_reset(struct APEX_CPU *cpu);
+int scoreboard_source(const struct APEX_CPU *cpu, int reg);
+void scoreboard_issue(struct APEX_CPU *cpu, uint32_t dst_mask, int tag);
+void scoreboard_produce(struct APEX_CPU *cpu, uint32_t dst_mask, int tag, int stage);
+void scoreboard_retire(struct APEX_CPU *cpu, uint32_t dst_mask, int tag);
+const char *scoreboard_forwarding_name(int fwd);
+int scoreboard_forwarding_parse(const char *name);
+#endif
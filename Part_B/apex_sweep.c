@@ -0,0 +1,670 @@
+/*
+ * apex_sweep.c
+ * Design-space exploration: runs a grid of timing models over a program
+ *
+ * A sweep spec names the program and the models to try, one directive per
+ * line:
+ *
+ *   program input.asm
+ *   warmup  5000                    # cycles simulated once, then checkpointed
+ *   roi     20000                   # cycles every point simulates after that
+ *   set     --icache size=512       # fixed for warm-up and every point
+ *   vary    --forwarding none ex ex-mem full
+ *   vary    --predictor none static bimodal gshare
+ *   vary    --dcache size=256,miss=20 size=1024,miss=20
+ *   random  8 42                    # 8 points at random, seed 42
+ *
+ * Every vary line is an axis and the points are their cross product, or a
+ * random sample of it. The warm-up runs once with the fixed options and
+ * its checkpoint is restored by every point, so each point only simulates
+ * the region of interest; the CPI of a point covers the ROI alone. The
+ * points run on the work-stealing pool of apex_pool.h and the Pareto
+ * frontier of CPI against a hardware cost estimate is printed at the end.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "apex.h"
+#include "apex_pool.h"
+
+#define SWEEP_MAX_LINE 1024
+#define SWEEP_MAX_AXES 16
+#define SWEEP_MAX_VALUES 64
+#define SWEEP_MAX_POINTS 65536
+
+/* Timing model option and the values a sweep gives it */
+typedef struct Sweep_Axis
+{
+    char *option;
+    char *values[SWEEP_MAX_VALUES];
+    int count;
+} Sweep_Axis;
+
+/* One timing model of the sweep and, once it has run, its result */
+typedef struct Sweep_Point
+{
+    int value[SWEEP_MAX_AXES]; /* Index of the value each axis takes */
+    char *options;             /* The axis options of this point, as written */
+    APEX_Config config;
+    int cost;
+    int status;    /* apex_step result, -1 if the point could not run */
+    int cycles;    /* Over the ROI */
+    int instructions;
+    int pareto;    /* On the CPI/cost frontier */
+} Sweep_Point;
+
+typedef struct Sweep
+{
+    char *program;
+    APEX_Code *code;
+    int warmup;
+    int roi;
+    APEX_Config base;
+    char fixed[SWEEP_MAX_LINE]; /* The set options, as written */
+    Sweep_Axis axes[SWEEP_MAX_AXES];
+    int axis_count;
+    int random_points;
+    uint32_t seed;
+    Sweep_Point *points;
+    int point_count;
+    const char *checkpoint; /* NULL without a warm-up */
+    int warm_cycles;        /* Cycles and instructions the checkpoint holds */
+    int warm_instructions;
+} Sweep;
+
+static void *
+xmalloc(size_t size)
+{
+    void *p = malloc(size);
+
+    if (!p)
+    {
+        fprintf(stderr, "APEX_Error: Out of memory\n");
+        exit(1);
+    }
+
+    return p;
+}
+
+static char *
+xstrdup(const char *s)
+{
+    return strcpy(xmalloc(strlen(s) + 1), s);
+}
+
+/* Applies one option to a model, exiting on an invalid one */
+static void
+apply_option(APEX_Config *config, const char *name, const char *value, int line)
+{
+    switch (value ? apex_config_option(config, name, value) : APEX_ERR_OPTION)
+    {
+    case APEX_OK:
+        return;
+
+    case APEX_ERR_VALUE:
+        fprintf(stderr, "APEX_Error: Line %d: Invalid %s value %s\n", line, name, value);
+        exit(1);
+
+    default:
+        fprintf(stderr, "APEX_Error: Line %d: Unknown option %s\n", line, name);
+        exit(1);
+    }
+}
+
+/* Returns a positive number or exits */
+static int
+positive(const char *tok, const char *directive, int line)
+{
+    int n = tok ? atoi(tok) : 0;
+
+    if (n <= 0)
+    {
+        fprintf(stderr, "APEX_Error: Line %d: %s needs a positive number\n", line, directive);
+        exit(1);
+    }
+
+    return n;
+}
+
+static void
+read_spec(Sweep *sweep, const char *path)
+{
+    char buf[SWEEP_MAX_LINE], *tok, *save, *name, *value;
+    APEX_Config scratch;
+    Sweep_Axis *axis;
+    FILE *fp;
+    int line = 0;
+
+    fp = fopen(path, "r");
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open sweep spec %s\n", path);
+        exit(1);
+    }
+
+    while (fgets(buf, sizeof(buf), fp))
+    {
+        ++line;
+        buf[strcspn(buf, "#\r\n")] = '\0';
+        tok = strtok_r(buf, " \t", &save);
+        if (!tok)
+        {
+            continue;
+        }
+
+        if (strcmp(tok, "program") == 0 && (tok = strtok_r(NULL, " \t", &save)))
+        {
+            free(sweep->program);
+            sweep->program = xstrdup(tok);
+        }
+        else if (strcmp(tok, "warmup") == 0)
+        {
+            sweep->warmup = positive(strtok_r(NULL, " \t", &save), "warmup", line);
+        }
+        else if (strcmp(tok, "roi") == 0)
+        {
+            sweep->roi = positive(strtok_r(NULL, " \t", &save), "roi", line);
+        }
+        else if (strcmp(tok, "random") == 0)
+        {
+            sweep->random_points = positive(strtok_r(NULL, " \t", &save), "random", line);
+            tok = strtok_r(NULL, " \t", &save);
+            sweep->seed = tok ? strtoul(tok, NULL, 0) : 1;
+        }
+        else if (strcmp(tok, "set") == 0)
+        {
+            name = strtok_r(NULL, " \t", &save);
+            value = strtok_r(NULL, " \t", &save);
+            apply_option(&sweep->base, name ? name : "", value, line);
+            snprintf(sweep->fixed + strlen(sweep->fixed),
+                     sizeof(sweep->fixed) - strlen(sweep->fixed),
+                     "%s%s %s", sweep->fixed[0] ? " " : "", name, value);
+        }
+        else if (strcmp(tok, "vary") == 0)
+        {
+            if (sweep->axis_count == SWEEP_MAX_AXES)
+            {
+                fprintf(stderr, "APEX_Error: Line %d: More than %d vary axes\n",
+                        line, SWEEP_MAX_AXES);
+                exit(1);
+            }
+            axis = &sweep->axes[sweep->axis_count++];
+            name = strtok_r(NULL, " \t", &save);
+            axis->option = xstrdup(name ? name : "");
+            while ((value = strtok_r(NULL, " \t", &save)) && axis->count < SWEEP_MAX_VALUES)
+            {
+                /* Checked here, where the line number is known */
+                scratch = sweep->base;
+                apply_option(&scratch, axis->option, value, line);
+                axis->values[axis->count++] = xstrdup(value);
+            }
+            if (axis->count == 0 || value)
+            {
+                fprintf(stderr, "APEX_Error: Line %d: vary needs 1 to %d values\n",
+                        line, SWEEP_MAX_VALUES);
+                exit(1);
+            }
+        }
+        else
+        {
+            fprintf(stderr, "APEX_Error: Line %d: Unknown directive %s\n", line, tok);
+            exit(1);
+        }
+    }
+
+    fclose(fp);
+
+    if (!sweep->program || !sweep->roi)
+    {
+        fprintf(stderr, "APEX_Error: A sweep spec needs a program and a roi\n");
+        exit(1);
+    }
+}
+
+/*
+ * Rough hardware cost of a timing model, in bytes of storage or storage
+ * equivalent logic: cache data and tags, BTB entries and 2-bit counters,
+ * 64 per forwarding path, 32 for the early branch comparator and 256
+ * divided by the latency for each of the multiplier and divider. Memory
+ * latencies are a property of the technology rather than the design and
+ * cost nothing
+ */
+static int
+model_cost(const APEX_Config *c)
+{
+    int cost = c->forwarding * 64 + 256 / c->mul_latency + 256 / c->div_latency;
+
+    if (c->predictor != BPRED_NONE)
+    {
+        cost += c->btb_entries * 8;
+    }
+    if (c->predictor == BPRED_BIMODAL || c->predictor == BPRED_GSHARE)
+    {
+        cost += c->bht_entries / 4;
+    }
+    if (c->branch_stage == STAGE_DECODE)
+    {
+        cost += 32;
+    }
+    if (c->dcache.size)
+    {
+        cost += c->dcache.size + c->dcache.size / c->dcache.line * 4;
+    }
+    if (c->icache.size)
+    {
+        cost += c->icache.size + c->icache.size / c->icache.line * 4;
+    }
+
+    return cost;
+}
+
+static int
+compare_int(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+/*
+ * Builds the points: the whole cross product of the axes, or a random
+ * sample of it in grid order. Every model is checked before anything runs
+ */
+static void
+make_points(Sweep *sweep)
+{
+    APEX_Sim *check;
+    Sweep_Point *pt;
+    char opts[SWEEP_MAX_LINE];
+    int *grid, total = 1, i, a, rest, pick, tmp, len;
+    uint32_t rng = sweep->seed ? sweep->seed : 1;
+
+    for (a = 0; a < sweep->axis_count; ++a)
+    {
+        if (total > SWEEP_MAX_POINTS / sweep->axes[a].count)
+        {
+            fprintf(stderr, "APEX_Error: More than %d points\n", SWEEP_MAX_POINTS);
+            exit(1);
+        }
+        total *= sweep->axes[a].count;
+    }
+
+    grid = xmalloc(total * sizeof(int));
+    for (i = 0; i < total; ++i)
+    {
+        grid[i] = i;
+    }
+
+    /* Partial Fisher-Yates shuffle: the first random_points are a sample */
+    sweep->point_count = total;
+    if (sweep->random_points && sweep->random_points < total)
+    {
+        for (i = 0; i < sweep->random_points; ++i)
+        {
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            pick = i + rng % (total - i);
+            tmp = grid[i];
+            grid[i] = grid[pick];
+            grid[pick] = tmp;
+        }
+        sweep->point_count = sweep->random_points;
+        qsort(grid, sweep->point_count, sizeof(int), compare_int);
+    }
+
+    check = apex_create(&sweep->base);
+    if (!check)
+    {
+        fprintf(stderr, "APEX_Error: Invalid fixed timing model\n");
+        exit(1);
+    }
+
+    sweep->points = calloc(sweep->point_count, sizeof(Sweep_Point));
+    if (!sweep->points)
+    {
+        fprintf(stderr, "APEX_Error: Out of memory\n");
+        exit(1);
+    }
+
+    for (i = 0; i < sweep->point_count; ++i)
+    {
+        pt = &sweep->points[i];
+        pt->config = sweep->base;
+        pt->status = -1;
+
+        /* Mixed radix: the last axis varies fastest */
+        rest = grid[i];
+        for (a = sweep->axis_count - 1; a >= 0; --a)
+        {
+            pt->value[a] = rest % sweep->axes[a].count;
+            rest /= sweep->axes[a].count;
+        }
+
+        opts[0] = '\0';
+        for (a = 0, len = 0; a < sweep->axis_count; ++a)
+        {
+            const char *value = sweep->axes[a].values[pt->value[a]];
+
+            apex_config_option(&pt->config, sweep->axes[a].option, value);
+            len += snprintf(opts + len, len < (int)sizeof(opts) ? sizeof(opts) - len : 0,
+                            "%s%s %s", a ? " " : "", sweep->axes[a].option, value);
+        }
+        pt->options = xstrdup(opts);
+
+        if (apex_set_config(check, &pt->config) != APEX_OK)
+        {
+            fprintf(stderr, "APEX_Error: Invalid timing model %s\n", pt->options);
+            exit(1);
+        }
+        pt->cost = model_cost(&pt->config);
+    }
+
+    apex_destroy(check);
+    free(grid);
+}
+
+/*
+ * Runs the warm-up once with the fixed options and checkpoints it to a
+ * temporary file, which the caller removes, or to keep if one is given
+ */
+static void
+warm_up(Sweep *sweep, const char *keep)
+{
+    static char tmp_path[256];
+    APEX_Sim *sim;
+    int fd, pc;
+
+    if (keep)
+    {
+        sweep->checkpoint = keep;
+    }
+    else
+    {
+        snprintf(tmp_path, sizeof(tmp_path), "%s/apex_sweep_XXXXXX",
+                 getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp");
+        fd = mkstemp(tmp_path);
+        if (fd < 0)
+        {
+            fprintf(stderr, "APEX_Error: Unable to create a temporary checkpoint\n");
+            exit(1);
+        }
+        close(fd);
+        sweep->checkpoint = tmp_path;
+    }
+
+    sim = apex_create(&sweep->base);
+    if (!sim || apex_load_code(sim, sweep->code) != APEX_OK)
+    {
+        fprintf(stderr, "APEX_Error: Unable to initialize CPU\n");
+        exit(1);
+    }
+
+    if (apex_step(sim, sweep->warmup) != APEX_RUNNING)
+    {
+        fprintf(stderr, "APEX_Error: %s stops within the %d warm-up cycles\n",
+                sweep->program, sweep->warmup);
+        exit(1);
+    }
+
+    if (!apex_checkpoint(sim, sweep->checkpoint))
+    {
+        fprintf(stderr, "APEX_Error: Unable to create checkpoint %s\n", sweep->checkpoint);
+        exit(1);
+    }
+
+    sweep->warm_cycles = apex_cycles(sim);
+    sweep->warm_instructions = apex_instructions(sim);
+    pc = apex_pc(sim);
+    apex_destroy(sim);
+    fprintf(stderr, "APEX_Sweep: Warmed up %d cycles, %d instructions, PC = %d\n",
+            sweep->warm_cycles, sweep->warm_instructions, pc);
+}
+
+/* Runs the ROI of one point on the worker's simulator */
+static void
+run_point(APEX_Sim *sim, int index, void *arg)
+{
+    const Sweep *sweep = arg;
+    Sweep_Point *pt = &sweep->points[index];
+
+    if (apex_set_config(sim, &pt->config) != APEX_OK
+        || apex_load_code(sim, sweep->code) != APEX_OK
+        || (sweep->checkpoint && !apex_restore(sim, sweep->checkpoint)))
+    {
+        return;
+    }
+
+    pt->status = apex_step(sim, sweep->roi);
+    pt->cycles = apex_cycles(sim) - sweep->warm_cycles;
+    pt->instructions = apex_instructions(sim) - sweep->warm_instructions;
+}
+
+static double
+point_cpi(const Sweep_Point *pt)
+{
+    return pt->instructions ? (double)pt->cycles / pt->instructions : 0.0;
+}
+
+/* Orders points by cost, then CPI */
+static int
+compare_points(const void *a, const void *b)
+{
+    const Sweep_Point *p = *(Sweep_Point *const *)a;
+    const Sweep_Point *q = *(Sweep_Point *const *)b;
+
+    if (p->cost != q->cost)
+    {
+        return p->cost < q->cost ? -1 : 1;
+    }
+    return point_cpi(p) < point_cpi(q) ? -1 : point_cpi(p) > point_cpi(q);
+}
+
+/*
+ * Marks and prints the Pareto frontier: walking the points from the
+ * cheapest, every one with a lower CPI than all cheaper ones
+ */
+static void
+print_pareto(Sweep *sweep)
+{
+    Sweep_Point **order;
+    double best = 0.0;
+    int i, n = 0;
+
+    order = xmalloc(sweep->point_count * sizeof(*order));
+    for (i = 0; i < sweep->point_count; ++i)
+    {
+        if (sweep->points[i].status >= 0 && sweep->points[i].instructions)
+        {
+            order[n++] = &sweep->points[i];
+        }
+    }
+    qsort(order, n, sizeof(*order), compare_points);
+
+    printf("-------------------------------------------\n%s\n-------------------------------------------\n",
+           " PARETO FRONTIER (CPI vs COST):");
+    if (sweep->fixed[0])
+    {
+        printf("Fixed: %s\n", sweep->fixed);
+    }
+    for (i = 0; i < n; ++i)
+    {
+        if (best == 0.0 || point_cpi(order[i]) < best)
+        {
+            best = point_cpi(order[i]);
+            order[i]->pareto = TRUE;
+            printf("|\tCost = %-6d|\tCPI = %.3f\t|\tCycles = %d\t|\t%s\n",
+                   order[i]->cost, best, order[i]->cycles,
+                   order[i]->options[0] ? order[i]->options : "(fixed options only)");
+        }
+    }
+
+    free(order);
+}
+
+/* Writes s as a CSV field, quoted if it needs to be */
+static void
+write_csv_string(FILE *out, const char *s)
+{
+    if (!strpbrk(s, ",\"\n"))
+    {
+        fputs(s, out);
+        return;
+    }
+
+    fputc('"', out);
+    for (; *s; ++s)
+    {
+        if (*s == '"')
+        {
+            fputc('"', out);
+        }
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+/* Writes every point, in grid order, as CSV */
+static void
+write_csv(const Sweep *sweep, FILE *out)
+{
+    const Sweep_Point *pt;
+    int i, a;
+
+    fprintf(out, "point");
+    for (a = 0; a < sweep->axis_count; ++a)
+    {
+        fputc(',', out);
+        write_csv_string(out, sweep->axes[a].option);
+    }
+    fprintf(out, ",status,cycles,instructions,cpi,cost,pareto\n");
+
+    for (i = 0; i < sweep->point_count; ++i)
+    {
+        pt = &sweep->points[i];
+        fprintf(out, "%d", i);
+        for (a = 0; a < sweep->axis_count; ++a)
+        {
+            fputc(',', out);
+            write_csv_string(out, sweep->axes[a].values[pt->value[a]]);
+        }
+
+        fprintf(out, ",%s,%d,%d,%.4f,%d,%d\n",
+                pt->status == APEX_HALTED ? "halted"
+                : pt->status == APEX_RUNNING ? "roi"
+                : pt->status == APEX_FAULTED ? "fault" : "error",
+                pt->cycles, pt->instructions, point_cpi(pt), pt->cost, pt->pareto);
+    }
+}
+
+int
+main(int argc, char const *argv[])
+{
+    const char *spec = NULL, *out_path = NULL, *keep = NULL;
+    int threads = 0, failed = 0, i, a;
+    Sweep sweep;
+    FILE *out;
+
+    for (i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            threads = atoi(argv[++i]);
+            if (threads < 1 || threads > POOL_MAX_THREADS)
+            {
+                fprintf(stderr, "APEX_Error: Threads must be 1 to %d\n", POOL_MAX_THREADS);
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            out_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc)
+        {
+            keep = argv[++i];
+        }
+        else if (!spec && argv[i][0] != '-')
+        {
+            spec = argv[i];
+        }
+        else
+        {
+            spec = NULL;
+            break;
+        }
+    }
+
+    if (!spec)
+    {
+        fprintf(stderr, "APEX_Help: Usage %s <sweep_spec> [-j <threads>] [-o <csv_file>] "
+                        "[--checkpoint <file>]\n", argv[0]);
+        exit(1);
+    }
+
+    memset(&sweep, 0, sizeof(sweep));
+    apex_config_default(&sweep.base);
+    read_spec(&sweep, spec);
+    make_points(&sweep);
+
+    sweep.code = apex_code_load(sweep.program);
+    if (!sweep.code)
+    {
+        fprintf(stderr, "APEX_Error: Unable to load program %s\n", sweep.program);
+        exit(1);
+    }
+
+    if (sweep.warmup)
+    {
+        warm_up(&sweep, keep);
+    }
+
+    threads = APEX_pool_threads(threads, sweep.point_count);
+    fprintf(stderr, "APEX_Sweep: %d points on %d threads\n", sweep.point_count, threads);
+    if (!APEX_pool_run(sweep.point_count, threads, run_point, &sweep))
+    {
+        fprintf(stderr, "APEX_Error: Unable to start worker threads or simulators\n");
+        exit(1);
+    }
+
+    if (sweep.checkpoint && !keep)
+    {
+        remove(sweep.checkpoint);
+    }
+
+    print_pareto(&sweep);
+
+    if (out_path)
+    {
+        out = fopen(out_path, "w");
+        if (!out)
+        {
+            fprintf(stderr, "APEX_Error: Unable to create %s\n", out_path);
+            exit(1);
+        }
+        write_csv(&sweep, out);
+        if (fclose(out) != 0)
+        {
+            fprintf(stderr, "APEX_Error: Unable to write %s\n", out_path);
+            exit(1);
+        }
+    }
+
+    for (i = 0; i < sweep.point_count; ++i)
+    {
+        failed += sweep.points[i].status < 0;
+        free(sweep.points[i].options);
+    }
+    for (a = 0; a < sweep.axis_count; ++a)
+    {
+        free(sweep.axes[a].option);
+        for (i = 0; i < sweep.axes[a].count; ++i)
+        {
+            free(sweep.axes[a].values[i]);
+        }
+    }
+    free(sweep.points);
+    free(sweep.program);
+    apex_code_destroy(sweep.code);
+    return failed ? 1 : 0;
+}
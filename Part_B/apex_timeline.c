@@ -0,0 +1,267 @@
+/*
+ * apex_timeline.c
+ * Contains APEX pipeline timeline export implementation
+ *
+ * Konata: every instruction is an I/L pair when fetched, an S command on
+ * lane 0 for each stage it enters, an S/E pair on lane 1 around stalled
+ * cycles, and an R command when it retires (type 0) or is flushed
+ * (type 1). Chrome: one complete ("X") event per instruction per stage on
+ * the stage's row, a nested "stall" event for stalled cycles, and an
+ * instant event for every flush. One cycle is one microsecond.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_timeline.h"
+#include "apex_trace.h"
+
+/* Stage names, indexed by STAGE_* */
+static const char *const konata_stages[] = {
+    [STAGE_FETCH] = "F",
+    [STAGE_DECODE] = "D",
+    [STAGE_EXECUTE] = "X",
+    [STAGE_MEMORY] = "M",
+    [STAGE_WRITEBACK] = "W",
+};
+
+static const char *const chrome_stages[] = {
+    [STAGE_FETCH] = "Fetch",
+    [STAGE_DECODE] = "D/RF",
+    [STAGE_EXECUTE] = "EX",
+    [STAGE_MEMORY] = "MEM",
+    [STAGE_WRITEBACK] = "WB",
+};
+
+/* Starts a Chrome event, writing the separator before all but the first */
+static void
+chrome_begin(APEX_Timeline *tl)
+{
+    fprintf(tl->fp, tl->events++ ? ",\n" : "\n");
+}
+
+/* Writes the Chrome events of an instruction that has left a stage */
+static void
+chrome_slot_done(APEX_Timeline *tl, int stage, const APEX_Timeline_Slot *s)
+{
+    chrome_begin(tl);
+    fprintf(tl->fp, "{\"name\":\"");
+    APEX_format_instruction(tl->fp, &s->insn);
+    fprintf(tl->fp, "\",\"cat\":\"insn\",\"ph\":\"X\",\"ts\":%d,\"dur\":%d,"
+                    "\"pid\":0,\"tid\":%d,\"args\":{\"pc\":%d,\"seq\":%d,"
+                    "\"stall_cycles\":%d,\"flushed\":%d}}",
+            s->start, s->last - s->start + 1, stage, s->pc, s->seq,
+            s->stall_cycles, s->flushed);
+
+    if (s->stall_cycles)
+    {
+        chrome_begin(tl);
+        fprintf(tl->fp, "{\"name\":\"stall\",\"cat\":\"stall\",\"ph\":\"X\","
+                        "\"ts\":%d,\"dur\":%d,\"pid\":0,\"tid\":%d,"
+                        "\"args\":{\"pc\":%d,\"seq\":%d}}",
+                s->stall_start, s->stall_cycles, stage, s->pc, s->seq);
+    }
+}
+
+/* Moves the Konata clock forward to cycle, retiring the instruction that
+ * was in writeback on the way */
+static void
+konata_advance(APEX_Timeline *tl, int cycle)
+{
+    if (cycle <= tl->cycle)
+    {
+        return;
+    }
+
+    fprintf(tl->fp, "C\t%d\n", cycle - tl->cycle);
+    tl->cycle = cycle;
+
+    if (tl->pending_retire)
+    {
+        fprintf(tl->fp, "R\t%d\t%llu\t0\n", tl->pending_retire,
+                (unsigned long long)tl->retired++);
+        tl->pending_retire = 0;
+    }
+}
+
+/* Creates a timeline file. Returns NULL if it cannot be created */
+APEX_Timeline *
+APEX_timeline_open(const char *path, int format)
+{
+    APEX_Timeline *tl;
+    int i;
+
+    tl = calloc(1, sizeof(APEX_Timeline));
+    if (!tl)
+    {
+        return NULL;
+    }
+
+    tl->fp = fopen(path, "w");
+    if (!tl->fp)
+    {
+        free(tl);
+        return NULL;
+    }
+    tl->format = format;
+
+    if (format == TIMELINE_KONATA)
+    {
+        fprintf(tl->fp, "Kanata\t0004\nC=\t0\n");
+        return tl;
+    }
+
+    fprintf(tl->fp, "{\"traceEvents\":[");
+    chrome_begin(tl);
+    fprintf(tl->fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,"
+                    "\"args\":{\"name\":\"APEX pipeline\"}}");
+    for (i = 0; i <= STAGE_WRITEBACK; ++i)
+    {
+        chrome_begin(tl);
+        fprintf(tl->fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+                        "\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                i, chrome_stages[i]);
+        chrome_begin(tl);
+        fprintf(tl->fp, "{\"name\":\"thread_sort_index\",\"ph\":\"M\","
+                        "\"pid\":0,\"tid\":%d,\"args\":{\"sort_index\":%d}}",
+                i, i);
+    }
+
+    return tl;
+}
+
+/* Records that a stage holds latch's instruction in this cycle */
+void
+APEX_timeline_stage(APEX_Timeline *tl, int cycle, int stage,
+                    const CPU_Stage *latch)
+{
+    APEX_Timeline_Slot *s = &tl->slot[stage];
+    int entered = !s->valid || s->seq != latch->tag;
+
+    if (tl->format == TIMELINE_KONATA)
+    {
+        konata_advance(tl, cycle);
+    }
+    else if (entered && s->valid)
+    {
+        chrome_slot_done(tl, stage, s);
+    }
+
+    if (entered)
+    {
+        s->valid = TRUE;
+        s->seq = latch->tag;
+        s->pc = latch->pc;
+        s->insn.opcode = latch->opcode;
+        s->insn.rd = latch->rd;
+        s->insn.rs1 = latch->rs1;
+        s->insn.rs2 = latch->rs2;
+        s->insn.imm = latch->imm;
+        s->start = cycle;
+        s->stall_start = -1;
+        s->stall_cycles = 0;
+        s->stall_open = FALSE;
+        s->flushed = FALSE;
+    }
+    s->last = cycle;
+
+    if (tl->format == TIMELINE_KONATA)
+    {
+        if (entered && stage == STAGE_FETCH)
+        {
+            fprintf(tl->fp, "I\t%d\t%d\t0\nL\t%d\t0\t%d: ", s->seq, s->seq,
+                    s->seq, s->pc);
+            APEX_format_instruction(tl->fp, &s->insn);
+            fprintf(tl->fp, "\n");
+        }
+        if (entered)
+        {
+            fprintf(tl->fp, "S\t%d\t0\t%s\n", s->seq, konata_stages[stage]);
+        }
+        if (latch->isStalled && !s->stall_open)
+        {
+            fprintf(tl->fp, "S\t%d\t1\tstall\n", s->seq);
+            s->stall_open = TRUE;
+        }
+        else if (!latch->isStalled && s->stall_open)
+        {
+            fprintf(tl->fp, "E\t%d\t1\tstall\n", s->seq);
+            s->stall_open = FALSE;
+        }
+        if (stage == STAGE_WRITEBACK)
+        {
+            tl->pending_retire = s->seq;
+        }
+    }
+
+    if (latch->isStalled)
+    {
+        if (s->stall_start < 0)
+        {
+            s->stall_start = cycle;
+        }
+        s->stall_cycles++;
+    }
+}
+
+/* Records that latch's instruction was squashed in stage by a redirect */
+void
+APEX_timeline_flush(APEX_Timeline *tl, int cycle, int stage,
+                    const CPU_Stage *latch)
+{
+    int i;
+
+    if (tl->format == TIMELINE_KONATA)
+    {
+        konata_advance(tl, cycle);
+        fprintf(tl->fp, "R\t%d\t0\t1\n", latch->tag);
+        return;
+    }
+
+    for (i = 0; i <= STAGE_WRITEBACK; ++i)
+    {
+        if (tl->slot[i].valid && tl->slot[i].seq == latch->tag)
+        {
+            tl->slot[i].flushed = TRUE;
+        }
+    }
+
+    chrome_begin(tl);
+    fprintf(tl->fp, "{\"name\":\"flush\",\"ph\":\"i\",\"s\":\"p\",\"ts\":%d,"
+                    "\"pid\":0,\"tid\":%d,\"args\":{\"pc\":%d,\"seq\":%d}}",
+            cycle, stage, latch->pc, latch->tag);
+}
+
+/* Completes and closes a timeline at the final cycle. Returns FALSE if
+ * any write failed */
+int
+APEX_timeline_close(APEX_Timeline *tl, int cycle)
+{
+    int i, ok;
+
+    if (tl->format == TIMELINE_KONATA)
+    {
+        konata_advance(tl, cycle + 1);
+    }
+    else
+    {
+        for (i = 0; i <= STAGE_WRITEBACK; ++i)
+        {
+            if (tl->slot[i].valid)
+            {
+                chrome_slot_done(tl, i, &tl->slot[i]);
+            }
+        }
+        fprintf(tl->fp, "\n]}\n");
+    }
+
+    ok = !ferror(tl->fp);
+    if (fclose(tl->fp) != 0)
+    {
+        ok = FALSE;
+    }
+
+    free(tl);
+    return ok;
+}
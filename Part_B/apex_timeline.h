@@ -0,0 +1,56 @@
+/*
+ * apex_timeline.h
+ * Contains APEX pipeline timeline export declarations
+ *
+ * The timeline follows every instruction, identified by the sequence tag
+ * it was given at fetch, through the stages and writes its lifetime as
+ * Konata log commands or Chrome Trace Event JSON. Events are written as
+ * soon as they are complete; the exporter only remembers the instruction
+ * currently held by each stage, so memory use does not grow with the run.
+ */
+#ifndef _APEX_TIMELINE_H_
+#define _APEX_TIMELINE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "apex_cpu.h"
+
+/* Output formats */
+#define TIMELINE_KONATA 0x0 /* Konata/Kanata pipeline log, version 0004 */
+#define TIMELINE_CHROME 0x1 /* Chrome Trace Event JSON (chrome://tracing, Perfetto) */
+
+/* Instruction held by one stage, as last reported */
+typedef struct APEX_Timeline_Slot
+{
+    int valid;
+    int seq;              /* Sequence tag of the instruction */
+    int pc;
+    APEX_Instruction insn;
+    int start;            /* Cycle the instruction entered the stage */
+    int last;             /* Last cycle it was reported in the stage */
+    int stall_start;      /* First stalled cycle, -1 when not stalled */
+    int stall_cycles;
+    int stall_open;       /* Konata: stall marker started on lane 1 */
+    int flushed;
+} APEX_Timeline_Slot;
+
+/* Streaming timeline writer */
+typedef struct APEX_Timeline
+{
+    FILE *fp;
+    int format;           /* TIMELINE_* */
+    int cycle;            /* Cycle of the last command written */
+    int pending_retire;   /* Konata: sequence tag retiring at the next cycle, or 0 */
+    uint64_t retired;     /* Konata: retire ids handed out */
+    int events;           /* Chrome: events written, for separators */
+    APEX_Timeline_Slot slot[STAGE_WRITEBACK + 1];
+} APEX_Timeline;
+
+APEX_Timeline *APEX_timeline_open(const char *path, int format);
+void APEX_timeline_stage(APEX_Timeline *tl, int cycle, int stage,
+                         const CPU_Stage *latch);
+void APEX_timeline_flush(APEX_Timeline *tl, int cycle, int stage,
+                         const CPU_Stage *latch);
+int APEX_timeline_close(APEX_Timeline *tl, int cycle);
+#endif
@@ -0,0 +1,183 @@
+/*
+ * apex_trace.c
+ * Contains APEX pipeline trace writer and text formatter
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_trace.h"
+
+/* Name printed in front of a stage report, indexed by STAGE_* */
+static const char *const stage_names[] = {
+    [STAGE_FETCH] = "Instrn at Fetch_Stage-->",
+    [STAGE_DECODE] = "Instrn at Decode/RF_Stage-->",
+    [STAGE_EXECUTE] = "Instrn at Execute_STAGE-->",
+    [STAGE_MEMORY] = "Instrn at MEMORY_STAGE-->",
+    [STAGE_WRITEBACK] = "Instrn at WRITEBACK_Stage-->",
+};
+
+/* Creates a trace file and its writer. Returns NULL if it cannot be created */
+APEX_Trace_Writer *
+APEX_trace_open(const char *path)
+{
+    APEX_Trace_Writer *tw;
+    APEX_Trace_Header hdr;
+
+    tw = calloc(1, sizeof(APEX_Trace_Writer));
+    if (!tw)
+    {
+        return NULL;
+    }
+
+    tw->fp = fopen(path, "wb");
+    if (!tw->fp)
+    {
+        free(tw);
+        return NULL;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, APEX_TRACE_MAGIC, sizeof(APEX_TRACE_MAGIC));
+    hdr.version = APEX_TRACE_VERSION;
+    hdr.record_size = sizeof(APEX_Trace_Record);
+    fwrite(&hdr, sizeof(hdr), 1, tw->fp);
+
+    return tw;
+}
+
+/* Writes out the buffered records */
+void
+APEX_trace_flush(APEX_Trace_Writer *tw)
+{
+    fwrite(tw->buf, sizeof(APEX_Trace_Record), tw->count, tw->fp);
+    tw->count = 0;
+}
+
+/* Flushes and closes a trace. Returns FALSE if any write failed */
+int
+APEX_trace_close(APEX_Trace_Writer *tw)
+{
+    int ok;
+
+    APEX_trace_flush(tw);
+    ok = !ferror(tw->fp);
+    if (fclose(tw->fp) != 0)
+    {
+        ok = FALSE;
+    }
+
+    free(tw);
+    return ok;
+}
+
+/* Prints an instruction in assembly form, as in the stage reports */
+void
+APEX_format_instruction(FILE *out, const APEX_Instruction *insn)
+{
+    const char *name = get_opcode_str(insn->opcode);
+
+    switch (insn->opcode)
+    {
+    case OPCODE_ADD:
+    case OPCODE_SUB:
+    case OPCODE_MUL:
+    case OPCODE_DIV:
+    case OPCODE_AND:
+    case OPCODE_OR:
+    case OPCODE_EXOR:
+    {
+        fprintf(out, "%s,R%d,R%d,R%d ", name, insn->rd, insn->rs1, insn->rs2);
+        break;
+    }
+
+    case OPCODE_ADDL:
+    case OPCODE_SUBL:
+    case OPCODE_LDI:
+    case OPCODE_LOAD:
+    {
+        fprintf(out, "%s,R%d,R%d,#%d ", name, insn->rd, insn->rs1, insn->imm);
+        break;
+    }
+
+    case OPCODE_STI:
+    {
+        fprintf(out, "%s,R%d,R%d,#%d ", name, insn->rs2, insn->rs1, insn->imm);
+        break;
+    }
+
+    case OPCODE_STORE:
+    {
+        fprintf(out, "%s,R%d,R%d,#%d ", name, insn->rs1, insn->rs2, insn->imm);
+        break;
+    }
+
+    case OPCODE_CMP:
+    {
+        fprintf(out, "%s,R%d,R%d ", name, insn->rs1, insn->rs2);
+        break;
+    }
+
+    case OPCODE_NOP:
+    case OPCODE_HALT:
+    {
+        fprintf(out, "%s", name);
+        break;
+    }
+
+    case OPCODE_MOVC:
+    {
+        fprintf(out, "%s,R%d,#%d ", name, insn->rd, insn->imm);
+        break;
+    }
+
+    case OPCODE_BZ:
+    case OPCODE_BNZ:
+    case OPCODE_BP:
+    case OPCODE_BNP:
+    {
+        fprintf(out, "%s,#%d ", name, insn->imm);
+        break;
+    }
+
+    case OPCODE_JUMP:
+    {
+        fprintf(out, "%s,R%d,#%d ", name, insn->rs1, insn->imm);
+        break;
+    }
+    }
+}
+
+/* Prints a record in the simulator's text format */
+void
+APEX_trace_format(FILE *out, const APEX_Trace_Record *rec)
+{
+    APEX_Instruction insn;
+
+    if (rec->kind == TRACE_CYCLE)
+    {
+        fprintf(out, "--------------------------------------------\n");
+        fprintf(out, "Clock Cycle #: %d\n", rec->cycle);
+        fprintf(out, "--------------------------------------------\n");
+        return;
+    }
+
+    insn.opcode = rec->opcode;
+    insn.rd = rec->rd;
+    insn.rs1 = rec->rs1;
+    insn.rs2 = rec->rs2;
+    insn.imm = rec->imm;
+
+    fprintf(out, "%-15s: I%d pc(%d)", stage_names[rec->stage],
+            (rec->pc - 4000) / 4, rec->pc);
+    APEX_format_instruction(out, &insn);
+    fprintf(out, "\t R%d=%d\tR%d=%d \t R%d=%d", rec->rs1, rec->rs1_value,
+            rec->rs2, rec->rs2_value, rec->rd, rec->result);
+    if (rec->flags & TRACE_STALLED)
+    {
+        fprintf(out, " Stalled");
+    }
+
+    fprintf(out, "\n");
+}
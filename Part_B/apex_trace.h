@@ -0,0 +1,124 @@
+/*
+ * apex_trace.h
+ * Contains APEX pipeline trace declarations
+ *
+ * A trace (.apextrace) is a fixed header followed by fixed-size binary
+ * records, one per cycle header and one per stage report, in the order
+ * the simulator produced them. Records are buffered and written in
+ * blocks; text is only ever produced from records by APEX_trace_format(),
+ * which both apex_trace_dump and the live display use.
+ */
+#ifndef _APEX_TRACE_H_
+#define _APEX_TRACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+
+#define APEX_TRACE_MAGIC "APEXTRC"
+#define APEX_TRACE_VERSION 1
+
+/* Records buffered before a write */
+#define APEX_TRACE_BUF_RECORDS 4096
+
+/* Record kinds */
+#define TRACE_CYCLE 0x0 /* Start of a clock cycle */
+#define TRACE_STAGE 0x1 /* Latch content reported by a stage */
+
+/* Record flags */
+#define TRACE_STALLED 0x1
+
+/* Header at offset 0 of a trace file */
+typedef struct APEX_Trace_Header
+{
+    char magic[8];        /* APEX_TRACE_MAGIC, NUL terminated */
+    uint32_t version;     /* APEX_TRACE_VERSION */
+    uint32_t record_size; /* sizeof(APEX_Trace_Record) */
+} APEX_Trace_Header;
+
+/* One trace record (32 bytes) */
+typedef struct APEX_Trace_Record
+{
+    int32_t cycle;
+    uint8_t kind;   /* TRACE_CYCLE or TRACE_STAGE */
+    uint8_t stage;  /* STAGE_* */
+    uint8_t opcode;
+    uint8_t flags;  /* TRACE_STALLED */
+    uint8_t rd;
+    uint8_t rs1;
+    uint8_t rs2;
+    uint8_t pad;
+    int32_t pc;
+    int32_t imm;
+    int32_t rs1_value;
+    int32_t rs2_value;
+    int32_t result;
+} APEX_Trace_Record;
+
+/* Buffered trace writer */
+typedef struct APEX_Trace_Writer
+{
+    FILE *fp;
+    int count; /* Records in buf */
+    APEX_Trace_Record buf[APEX_TRACE_BUF_RECORDS];
+} APEX_Trace_Writer;
+
+APEX_Trace_Writer *APEX_trace_open(const char *path);
+void APEX_trace_flush(APEX_Trace_Writer *tw);
+int APEX_trace_close(APEX_Trace_Writer *tw);
+void APEX_trace_format(FILE *out, const APEX_Trace_Record *rec);
+void APEX_format_instruction(FILE *out, const APEX_Instruction *insn);
+
+/* Fills a record from a stage latch */
+static inline void
+trace_fill_stage(APEX_Trace_Record *rec, int cycle, int stage,
+                 const CPU_Stage *latch)
+{
+    rec->cycle = cycle;
+    rec->kind = TRACE_STAGE;
+    rec->stage = stage;
+    rec->opcode = latch->opcode;
+    rec->flags = latch->isStalled ? TRACE_STALLED : 0;
+    rec->rd = latch->rd;
+    rec->rs1 = latch->rs1;
+    rec->rs2 = latch->rs2;
+    rec->pad = 0;
+    rec->pc = latch->pc;
+    rec->imm = latch->imm;
+    rec->rs1_value = latch->rs1_value;
+    rec->rs2_value = latch->rs2_value;
+    rec->result = latch->result_buffer;
+}
+
+/* Reserves the next record in the buffer, writing the buffer out when full */
+static inline APEX_Trace_Record *
+trace_next(APEX_Trace_Writer *tw)
+{
+    if (tw->count == APEX_TRACE_BUF_RECORDS)
+    {
+        APEX_trace_flush(tw);
+    }
+
+    return &tw->buf[tw->count++];
+}
+
+/* Appends a stage report */
+static inline void
+trace_stage(APEX_Trace_Writer *tw, int cycle, int stage, const CPU_Stage *latch)
+{
+    trace_fill_stage(trace_next(tw), cycle, stage, latch);
+}
+
+/* Appends the start of a clock cycle */
+static inline void
+trace_cycle(APEX_Trace_Writer *tw, int cycle)
+{
+    APEX_Trace_Record *rec = trace_next(tw);
+
+    memset(rec, 0, sizeof(*rec));
+    rec->cycle = cycle;
+    rec->kind = TRACE_CYCLE;
+}
+#endif
@@ -0,0 +1,60 @@
+/*
+ * apex_trace_dump.c
+ * Decodes an .apextrace file into the simulator's text output
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_trace.h"
+
+int
+main(int argc, char const *argv[])
+{
+    APEX_Trace_Header hdr;
+    APEX_Trace_Record *buf;
+    size_t n, i;
+    FILE *fp;
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "APEX_Help: Usage %s <trace_file>\n", argv[0]);
+        exit(1);
+    }
+
+    fp = fopen(argv[1], "rb");
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open %s\n", argv[1]);
+        exit(1);
+    }
+
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1
+        || memcmp(hdr.magic, APEX_TRACE_MAGIC, sizeof(hdr.magic)) != 0
+        || hdr.version != APEX_TRACE_VERSION
+        || hdr.record_size != sizeof(APEX_Trace_Record))
+    {
+        fprintf(stderr, "APEX_Error: Invalid trace file %s\n", argv[1]);
+        exit(1);
+    }
+
+    buf = malloc(APEX_TRACE_BUF_RECORDS * sizeof(APEX_Trace_Record));
+    if (!buf)
+    {
+        exit(1);
+    }
+
+    while ((n = fread(buf, sizeof(APEX_Trace_Record), APEX_TRACE_BUF_RECORDS,
+                      fp)) > 0)
+    {
+        for (i = 0; i < n; ++i)
+        {
+            APEX_trace_format(stdout, &buf[i]);
+        }
+    }
+
+    free(buf);
+    fclose(fp);
+    return 0;
+}
@@ -7,7 +7,6 @@
  * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
  * State University of New York at Binghamton
  */
-#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -36,140 +35,101 @@ get_num_from_string(const char *buffer)
     return atoi(str);
 }
 
-/*
- * This function sets the numeric opcode to an instruction based on string value
- *
- * Note : you can edit this function to add new instructions
- */
+/* Parses a register operand into reg, returns FALSE if the register file has
+ * no such register */
 static int
-set_opcode_str(const char *opcode_str)
+get_reg_from_string(const char *buffer, uint8_t *reg)
 {
-    if (strcmp(opcode_str, "ADD") == 0)
-    {
-        return OPCODE_ADD;
-    }
-
-    if (strcmp(opcode_str, "SUB") == 0)
-    {
-        return OPCODE_SUB;
-    }
-
-    if (strcmp(opcode_str, "MUL") == 0)
-    {
-        return OPCODE_MUL;
-    }
-
-    if (strcmp(opcode_str, "DIV") == 0)
-    {
-        return OPCODE_DIV;
-    }
-
-    if (strcmp(opcode_str, "AND") == 0)
-    {
-        return OPCODE_AND;
-    }
-
-    if (strcmp(opcode_str, "OR") == 0)
-    {
-        return OPCODE_OR;
-    }
-
-    if (strcmp(opcode_str, "EXOR") == 0)
-    {
-        return OPCODE_EXOR;
-    }
-
-    if (strcmp(opcode_str, "MOVC") == 0)
-    {
-        return OPCODE_MOVC;
-    }
+    int num = get_num_from_string(buffer);
 
-    if (strcmp(opcode_str, "LOAD") == 0)
+    if (num < 0 || num >= REG_FILE_SIZE)
     {
-        return OPCODE_LOAD;
+        return FALSE;
     }
+    *reg = num;
 
-    if (strcmp(opcode_str, "STORE") == 0)
-    {
-        return OPCODE_STORE;
-    }
-
-    if (strcmp(opcode_str, "BZ") == 0)
-    {
-        return OPCODE_BZ;
-    }
-
-    if (strcmp(opcode_str, "BNZ") == 0)
-    {
-        return OPCODE_BNZ;
-    }
-
-    if (strcmp(opcode_str, "HALT") == 0)
-    {
-        return OPCODE_HALT;
-    }
-
-    if (strcmp(opcode_str, "BP") == 0)
-    {
-        return OPCODE_BP;
-    }
+    return TRUE;
+}
 
-    if (strcmp(opcode_str, "BNP") == 0)
-    {
-        return OPCODE_BNP;
-    }
+/* Mnemonic of every numeric opcode, only consulted when parsing and printing */
+static const char *const opcode_mnemonics[] = {
+    [OPCODE_ADD] = "ADD",
+    [OPCODE_SUB] = "SUB",
+    [OPCODE_MUL] = "MUL",
+    [OPCODE_DIV] = "DIV",
+    [OPCODE_AND] = "AND",
+    [OPCODE_OR] = "OR",
+    [OPCODE_EXOR] = "EXOR",
+    [OPCODE_MOVC] = "MOVC",
+    [OPCODE_LOAD] = "LOAD",
+    [OPCODE_STORE] = "STORE",
+    [OPCODE_BZ] = "BZ",
+    [OPCODE_BNZ] = "BNZ",
+    [OPCODE_HALT] = "HALT",
+    [OPCODE_ADDL] = "ADDL",
+    [OPCODE_SUBL] = "SUBL",
+    [OPCODE_JUMP] = "JUMP",
+    [OPCODE_LDI] = "LDI",
+    [OPCODE_STI] = "STI",
+    [OPCODE_NOP] = "NOP",
+    [OPCODE_BP] = "BP",
+    [OPCODE_BNP] = "BNP",
+    [OPCODE_CMP] = "CMP",
+};
+
+#define NUM_OPCODES (int)(sizeof(opcode_mnemonics) / sizeof(opcode_mnemonics[0]))
 
-    if (strcmp(opcode_str, "CMP") == 0)
-    {
-        return OPCODE_CMP;
-    }
-
-    if (strcmp(opcode_str, "ADDL") == 0)
-    {
-        return OPCODE_ADDL;
-    }
-    if (strcmp(opcode_str, "SUBL") == 0)
-    {
-        return OPCODE_SUBL;
-    }
-
-    if (strcmp(opcode_str, "LDI") == 0)
+/*
+ * Returns the mnemonic for a numeric opcode
+ */
+const char *
+get_opcode_str(const int opcode)
+{
+    if (opcode < 0 || opcode >= NUM_OPCODES || !opcode_mnemonics[opcode])
     {
-        return OPCODE_LDI;
+        return "???";
     }
 
-    if (strcmp(opcode_str, "STI") == 0)
-    {
-        return OPCODE_STI;
-    }
+    return opcode_mnemonics[opcode];
+}
 
-    if (strcmp(opcode_str, "JUMP") == 0)
-    {
-        return OPCODE_JUMP;
-    }
+/*
+ * This function sets the numeric opcode to an instruction based on string value,
+ * -1 if there is no such instruction
+ *
+ * Note : you can edit opcode_mnemonics to add new instructions
+ */
+static int
+set_opcode_str(const char *opcode_str)
+{
+    int opcode;
 
-    if (strcmp(opcode_str, "NOP") == 0)
+    for (opcode = 0; opcode < NUM_OPCODES; ++opcode)
     {
-        return OPCODE_NOP;
+        if (opcode_mnemonics[opcode]
+            && strcmp(opcode_str, opcode_mnemonics[opcode]) == 0)
+        {
+            return opcode;
+        }
     }
 
-    assert(0 && "Invalid opcode");
-    return 0;
+    return -1;
 }
 
 static void
 split_opcode_from_insn_string(char *buffer, char tokens[2][128])
 {
     int token_num = 0;
+    char *save = NULL;
 
-    char *token = strtok(buffer, " ");
+    char *token = strtok_r(buffer, " ", &save);
     char *new;   // to remove newline character at end of string HALT nad NOP
 
-    while (token != NULL)
+    while (token != NULL && token_num < 2)
     {
         strcpy(tokens[token_num], token);
         token_num++;
-        token = strtok(NULL, " ");
+        token = strtok_r(NULL, " ", &save);
     }
 
     new = tokens[0];
@@ -185,16 +145,18 @@ split_opcode_from_insn_string(char *buffer, char tokens[2][128])
 }
 
 /*
- * This function is related to parsing input file
+ * This function is related to parsing input file, returns FALSE for an
+ * unknown instruction or a register outside the register file
  *
  * Note : you can edit this function to add new instructions
  */
-static void
+static int
 create_APEX_instruction(APEX_Instruction *ins, char *buffer)
 {
-    int i, token_num = 0;
+    int i, opcode, token_num = 0, ok = TRUE;
     char tokens[6][128];
     char top_level_tokens[2][128];
+    char *save = NULL;
 
     for (i = 0; i < 2; ++i)
     {
@@ -203,17 +165,21 @@ create_APEX_instruction(APEX_Instruction *ins, char *buffer)
 
     split_opcode_from_insn_string(buffer, top_level_tokens);
 
-    char *token = strtok(top_level_tokens[1], ",");
+    char *token = strtok_r(top_level_tokens[1], ",", &save);
 
-    while (token != NULL)
+    while (token != NULL && token_num < 6)
     {
         strcpy(tokens[token_num], token);
         token_num++;
-        token = strtok(NULL, ",");
+        token = strtok_r(NULL, ",", &save);
     }
 
-    strcpy(ins->opcode_str, top_level_tokens[0]);
-    ins->opcode = set_opcode_str(ins->opcode_str);
+    opcode = set_opcode_str(top_level_tokens[0]);
+    if (opcode < 0)
+    {
+        return FALSE;
+    }
+    ins->opcode = opcode;
 
     switch (ins->opcode)
     {  
@@ -225,39 +191,39 @@ create_APEX_instruction(APEX_Instruction *ins, char *buffer)
         case OPCODE_OR:
         case OPCODE_EXOR:
         { //fall through all instructions having 2 src and 1 dst reg
-            ins->rd = get_num_from_string(tokens[0]);
-            ins->rs1 = get_num_from_string(tokens[1]);
-            ins->rs2 = get_num_from_string(tokens[2]);
+            ok &= get_reg_from_string(tokens[0], &ins->rd);
+            ok &= get_reg_from_string(tokens[1], &ins->rs1);
+            ok &= get_reg_from_string(tokens[2], &ins->rs2);
             break;
         }
 
         case OPCODE_MOVC:
         {  //1 dest and 1 literal
-            ins->rd = get_num_from_string(tokens[0]);
+            ok &= get_reg_from_string(tokens[0], &ins->rd);
             ins->imm = get_num_from_string(tokens[1]);
             break;
         }
 
         case OPCODE_LDI:
         { //1 src 1 dest 1 literal
-            ins->rd = get_num_from_string(tokens[0]);
-            ins->rs1 = get_num_from_string(tokens[1]);
+            ok &= get_reg_from_string(tokens[0], &ins->rd);
+            ok &= get_reg_from_string(tokens[1], &ins->rs1);
             ins->imm = get_num_from_string(tokens[2]);
             break;
         }
 
         case OPCODE_LOAD:
         { // 1 src 1 dest and 1 literal
-            ins->rd = get_num_from_string(tokens[0]);
-            ins->rs1 = get_num_from_string(tokens[1]);
+            ok &= get_reg_from_string(tokens[0], &ins->rd);
+            ok &= get_reg_from_string(tokens[1], &ins->rs1);
             ins->imm = get_num_from_string(tokens[2]);
             break;
         }
 
         case OPCODE_STORE:
         { //2 src and 1 literal
-            ins->rs1 = get_num_from_string(tokens[0]);
-            ins->rs2 = get_num_from_string(tokens[1]);
+            ok &= get_reg_from_string(tokens[0], &ins->rs1);
+            ok &= get_reg_from_string(tokens[1], &ins->rs2);
             ins->imm = get_num_from_string(tokens[2]);
             break;
         }
@@ -265,8 +231,8 @@ create_APEX_instruction(APEX_Instruction *ins, char *buffer)
         case OPCODE_SUBL:
         case OPCODE_ADDL:
         { //1 src 1 dest and 1 literal
-            ins->rd = get_num_from_string(tokens[0]);
-            ins->rs1 = get_num_from_string(tokens[1]);
+            ok &= get_reg_from_string(tokens[0], &ins->rd);
+            ok &= get_reg_from_string(tokens[1], &ins->rs1);
             ins->imm = get_num_from_string(tokens[2]);
             break;
         }
@@ -282,8 +248,8 @@ create_APEX_instruction(APEX_Instruction *ins, char *buffer)
 
         case OPCODE_CMP:
         { //2 src reg
-            ins->rs1 = get_num_from_string(tokens[0]);
-            ins->rs2 = get_num_from_string(tokens[1]);
+            ok &= get_reg_from_string(tokens[0], &ins->rs1);
+            ok &= get_reg_from_string(tokens[1], &ins->rs2);
             break;
         }
 
@@ -296,19 +262,21 @@ create_APEX_instruction(APEX_Instruction *ins, char *buffer)
 
         case OPCODE_STI:
         {  // 2src
-            ins->rs2 = get_num_from_string(tokens[0]);
-            ins->rs1 = get_num_from_string(tokens[1]);
+            ok &= get_reg_from_string(tokens[0], &ins->rs2);
+            ok &= get_reg_from_string(tokens[1], &ins->rs1);
+            ins->imm = get_num_from_string(tokens[2]);
             break;
         }
 
         case OPCODE_JUMP:
-        { //1 dest reg and 1 literal
-            ins->rd = get_num_from_string(tokens[0]);
+        { //1 src reg and 1 literal
+            ok &= get_reg_from_string(tokens[0], &ins->rs1);
             ins->imm = get_num_from_string(tokens[1]);
             break;
         }
     }
     /* Fill in rest of the instructions accordingly */
+    return ok;
 }
 
 /*
@@ -359,11 +327,74 @@ create_code_memory(const char *filename, int *size)
     rewind(fp);
     while ((nread = getline(&line, &len, fp)) != -1)
     {
-        create_APEX_instruction(&code_memory[current_instruction], line);
+        if (!create_APEX_instruction(&code_memory[current_instruction], line))
+        {
+            free(code_memory);
+            code_memory = NULL;
+            break;
+        }
         current_instruction++;
     }
 
     free(line);
     fclose(fp);
     return code_memory;
+}
+
+/*
+ * Creates code memory from an .asm listing held in memory, one instruction
+ * per line as in a file. Returns NULL if the listing is empty or has an
+ * unknown instruction or register
+ */
+APEX_Instruction *
+create_code_memory_from_buffer(const char *buf, size_t len, int *size)
+{
+    APEX_Instruction *code_memory;
+    const char *line, *end;
+    char *copy;
+    size_t i, line_len;
+    int code_memory_size = 0;
+
+    for (i = 0; i < len; ++i)
+    {
+        code_memory_size += buf[i] == '\n';
+    }
+    code_memory_size += len && buf[len - 1] != '\n';
+    *size = code_memory_size;
+    if (!code_memory_size)
+    {
+        return NULL;
+    }
+
+    code_memory = calloc(code_memory_size, sizeof(APEX_Instruction));
+    copy = malloc(len + 1);
+    if (!code_memory || !copy)
+    {
+        free(code_memory);
+        free(copy);
+        return NULL;
+    }
+
+    /* Each line is parsed from a copy, the parser writes into it */
+    for (i = 0, line = buf; i < (size_t)code_memory_size; ++i, line = end + 1)
+    {
+        end = memchr(line, '\n', buf + len - line);
+        if (!end)
+        {
+            end = buf + len;
+        }
+        line_len = end - line;
+        memcpy(copy, line, line_len);
+        copy[line_len] = '\0';
+
+        if (!create_APEX_instruction(&code_memory[i], copy))
+        {
+            free(code_memory);
+            code_memory = NULL;
+            break;
+        }
+    }
+
+    free(copy);
+    return code_memory;
 }
\ No newline at end of file
@@ -5,32 +5,334 @@
  * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
  * State University of New York at Binghamton
  */
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "apex.h"
+#include "apex_checkpoint.h"
 #include "apex_cpu.h"
+#include "apex_functional.h"
+#include "apex_timeline.h"
+#include "apex_trace.h"
+
+/* Sets the data address limit before any instruction runs */
+static void
+limit_memory(APEX_CPU *cpu, const APEX_Config *model)
+{
+    APEX_mem_set_limit(&cpu->data_memory, model->mem_limit);
+}
+
+/* Preloads data memory from an image file, if one is given */
+static void
+preload_memory(APEX_CPU *cpu, const char *path)
+{
+    if (path && !APEX_mem_load_image(&cpu->data_memory, path))
+    {
+        fprintf(stderr, "APEX_Error: Unable to load memory image %s\n", path);
+        exit(1);
+    }
+}
+
+/* Applies the timing model options to a CPU, FALSE if they are invalid */
+static int
+apply_model(APEX_CPU *cpu, const APEX_Config *model)
+{
+    switch (APEX_cpu_configure(cpu, model))
+    {
+    case APEX_OK:
+        return TRUE;
+
+    case APEX_ERR_BPRED:
+        fprintf(stderr, "APEX_Error: BTB and BHT entries must be powers of two up to %d and %d\n",
+                BPRED_MAX_BTB_ENTRIES, BPRED_MAX_BHT_ENTRIES);
+        return FALSE;
+
+    case APEX_ERR_FU:
+        fprintf(stderr, "APEX_Error: MUL and DIV latencies must be 1 to %d cycles\n",
+                FU_MAX_LATENCY);
+        return FALSE;
+
+    case APEX_ERR_DCACHE:
+        fprintf(stderr, "APEX_Error: Invalid D-cache geometry or latencies\n");
+        return FALSE;
+
+    case APEX_ERR_ICACHE:
+        fprintf(stderr, "APEX_Error: Invalid I-cache geometry or latencies\n");
+        return FALSE;
+
+    case APEX_ERR_NO_MEMORY:
+        fprintf(stderr, "APEX_Error: Out of memory\n");
+        return FALSE;
+
+    default:
+        fprintf(stderr, "APEX_Error: Invalid memory limit\n");
+        return FALSE;
+    }
+}
+
+/*
+ * Runs the program once per forwarding network, each from the same starting
+ * state, and prints the cycles of each with its speedup over no forwarding,
+ * marking runs that faulted or reached the cycle limit
+ */
+static void
+compare_forwarding(const char *filename, int cycles, long long ff_insns,
+                   int ff_pc, const char *mem_in_path, const APEX_Config *model)
+{
+    APEX_Config run_model = *model;
+    APEX_CPU *cpu;
+    int clock[FWD_COUNT], insns[FWD_COUNT], halted[FWD_COUNT], faulted[FWD_COUNT], fwd;
+
+    for (fwd = 0; fwd < FWD_COUNT; ++fwd)
+    {
+        cpu = APEX_cpu_init(filename, "quiet", cycles);
+        if (!cpu)
+        {
+            fprintf(stderr, "APEX_Error: Unable to initialize CPU\n");
+            exit(1);
+        }
+        limit_memory(cpu, &run_model);
+        preload_memory(cpu, mem_in_path);
+
+        if (ff_insns > 0 || ff_pc != FF_NO_STOP_PC)
+        {
+            APEX_functional_run(cpu, ff_insns > 0 ? ff_insns : LLONG_MAX, ff_pc);
+        }
+
+        run_model.forwarding = fwd;
+        if (!apply_model(cpu, &run_model))
+        {
+            exit(1);
+        }
+        APEX_cpu_run(cpu);
+        clock[fwd] = cpu->clock;
+        insns[fwd] = cpu->insn_completed;
+        /* A fault also stops the run short of the limit without a HALT */
+        faulted[fwd] = cpu->fault;
+        halted[fwd] = !cpu->fault && cpu->clock < cycles;
+        APEX_cpu_free(cpu);
+    }
+
+    printf("-------------------------------------------\n%s\n-------------------------------------------\n",
+           " FORWARDING NETWORK COMPARISON:");
+    for (fwd = 0; fwd < FWD_COUNT; ++fwd)
+    {
+        printf("|\t%-6s|\tCycles = %d\t|\tCPI = %.3f\t|\tSpeedup = %.2fx%s\n",
+               scoreboard_forwarding_name(fwd), clock[fwd],
+               insns[fwd] ? (double)clock[fwd] / insns[fwd] : 0.0,
+               clock[fwd] ? (double)clock[FWD_NONE] / clock[fwd] : 0.0,
+               faulted[fwd] ? " (fault)" : halted[fwd] ? "" : " (cycle limit)");
+    }
+}
 
 int
 main(int argc, char const *argv[])
 {
     APEX_CPU *cpu;
+    long long ff_insns = 0, ff_done;
+    int ff_pc = FF_NO_STOP_PC, ckpt_cycle = 0, i;
+    const char *ckpt_path = NULL, *restore_path = NULL, *trace_path = NULL;
+    const char *timeline_path = NULL, *mem_in_path = NULL, *mem_out_path = NULL;
+    int profile = FALSE, timeline_format = TIMELINE_KONATA;
+    int compare = FALSE, err;
+    APEX_Config model;
 
+    apex_config_default(&model);
     fprintf(stderr, "APEX CPU Pipeline Simulator v%0.1lf\n", VERSION);
 
-    if (argc != 4)
+    if (argc < 4)
     {
-        fprintf(stderr, "APEX_Help: Usage %s <input_file> <Operation> <No. of cycles>\n", argv[0]);
+        fprintf(stderr, "APEX_Help: Usage %s <input_file> <Operation> <No. of cycles> "
+                        "[--ff-insns <N>] [--ff-pc <PC>] "
+                        "[--checkpoint <cycle> <file>] [--restore <file>] "
+                        "[--trace <file>] [--profile] "
+                        "[--konata <file> | --chrome-trace <file>] "
+                        "[--forwarding none|ex|ex-mem|full] [--compare-forwarding] "
+                        "[--predictor none|static|bimodal|gshare] "
+                        "[--btb-entries <N>] [--bht-entries <N>] "
+                        "[--branch-resolve ex|decode] "
+                        "[--mul-latency <N>] [--div-latency <N>] "
+                        "[--dcache size=<bytes>,assoc=<N>,line=<bytes>,"
+                        "repl=lru|random,write=back|through,prefetch=none|next,"
+                        "hit=<N>,miss=<N>] "
+                        "[--icache <same settings as --dcache>] "
+                        "[--mem-limit <addresses>] "
+                        "[--mem-in <file>] [--mem-out <file>] "
+                        "[--loop-accel on|off] [--block-memo on|off]\n",
+                argv[0]);
         exit(1);
     }
+
+    /* Optional fast-forward before the pipeline starts */
+    for (i = 4; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--ff-insns") == 0 && i + 1 < argc)
+        {
+            ff_insns = atoll(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--ff-pc") == 0 && i + 1 < argc)
+        {
+            ff_pc = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--checkpoint") == 0 && i + 2 < argc)
+        {
+            ckpt_cycle = atoi(argv[++i]);
+            ckpt_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--restore") == 0 && i + 1 < argc)
+        {
+            restore_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+        {
+            trace_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--mem-in") == 0 && i + 1 < argc)
+        {
+            mem_in_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--mem-out") == 0 && i + 1 < argc)
+        {
+            mem_out_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--profile") == 0)
+        {
+            profile = TRUE;
+        }
+        else if (strcmp(argv[i], "--konata") == 0 && i + 1 < argc)
+        {
+            timeline_format = TIMELINE_KONATA;
+            timeline_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--chrome-trace") == 0 && i + 1 < argc)
+        {
+            timeline_format = TIMELINE_CHROME;
+            timeline_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--compare-forwarding") == 0)
+        {
+            compare = TRUE;
+        }
+        else if (i + 1 < argc
+                 && (err = apex_config_option(&model, argv[i], argv[i + 1])) != APEX_ERR_OPTION)
+        {
+            ++i;
+            if (err == APEX_ERR_VALUE)
+            {
+                fprintf(stderr, "APEX_Error: Invalid %s value %s\n", argv[i - 1], argv[i]);
+                exit(1);
+            }
+        }
+        else
+        {
+            fprintf(stderr, "APEX_Error: Unknown option %s\n", argv[i]);
+            exit(1);
+        }
+    }
     int n=atoi(argv[3]);
+
+    /* The comparison runs are quiet and start from the program's beginning */
+    if (compare)
+    {
+        if (restore_path || ckpt_path || trace_path || timeline_path || profile
+            || mem_out_path)
+        {
+            fprintf(stderr, "APEX_Error: --compare-forwarding only combines with fast-forward\n");
+            exit(1);
+        }
+        compare_forwarding(argv[1], n, ff_insns, ff_pc, mem_in_path, &model);
+        return 0;
+    }
+
     cpu = APEX_cpu_init(argv[1] , argv[2], n); // for input file, simulate/display/single_step, number of cycles*/);
     if (!cpu)
     {
         fprintf(stderr, "APEX_Error: Unable to initialize CPU\n");
         exit(1);
     }
+    limit_memory(cpu, &model);
+    preload_memory(cpu, mem_in_path);
+
+    if (restore_path)
+    {
+        /* Fast-forwarding needs an empty pipeline, a restored one may not be */
+        if (ff_insns > 0 || ff_pc != FF_NO_STOP_PC)
+        {
+            fprintf(stderr, "APEX_Error: --restore cannot be combined with fast-forward\n");
+            exit(1);
+        }
+        /* The checkpoint holds its own data memory */
+        if (mem_in_path)
+        {
+            fprintf(stderr, "APEX_Error: --restore cannot be combined with --mem-in\n");
+            exit(1);
+        }
+        if (!APEX_cpu_restore(cpu, restore_path))
+        {
+            fprintf(stderr, "APEX_Error: Unable to restore checkpoint %s\n", restore_path);
+            exit(1);
+        }
+        fprintf(stderr, "APEX_CPU: Restored %s at cycle %d, PC = %d\n",
+                restore_path, cpu->clock, cpu->pc);
+    }
+    else if (ff_insns > 0 || ff_pc != FF_NO_STOP_PC)
+    {
+        /* With only a PC given, run until it is reached (or HALT) */
+        ff_done = APEX_functional_run(cpu, ff_insns > 0 ? ff_insns : LLONG_MAX,
+                                      ff_pc);
+        fprintf(stderr, "APEX_CPU: Fast-forwarded %lld instructions, PC = %d\n",
+                ff_done, cpu->pc);
+    }
+
+    cpu->show_profile = profile;
+    if (!apply_model(cpu, &model))
+    {
+        exit(1);
+    }
+    cpu->checkpoint_path = ckpt_path;
+    cpu->checkpoint_cycle = ckpt_cycle;
+
+    /* Stage reports go to the trace instead of stdout */
+    if (trace_path)
+    {
+        cpu->trace = APEX_trace_open(trace_path);
+        if (!cpu->trace)
+        {
+            fprintf(stderr, "APEX_Error: Unable to create trace %s\n", trace_path);
+            exit(1);
+        }
+    }
+
+    if (timeline_path)
+    {
+        cpu->timeline = APEX_timeline_open(timeline_path, timeline_format);
+        if (!cpu->timeline)
+        {
+            fprintf(stderr, "APEX_Error: Unable to create timeline %s\n", timeline_path);
+            exit(1);
+        }
+    }
 
     APEX_cpu_run(cpu);
+
+    if (cpu->timeline && !APEX_timeline_close(cpu->timeline, cpu->clock))
+    {
+        fprintf(stderr, "APEX_Error: Unable to write timeline %s\n", timeline_path);
+    }
+    cpu->timeline = NULL;
+
+    if (cpu->trace && !APEX_trace_close(cpu->trace))
+    {
+        fprintf(stderr, "APEX_Error: Unable to write trace %s\n", trace_path);
+    }
+    cpu->trace = NULL;
+
+    if (mem_out_path && !APEX_mem_dump_image(&cpu->data_memory, mem_out_path))
+    {
+        fprintf(stderr, "APEX_Error: Unable to write memory image %s\n", mem_out_path);
+    }
     APEX_cpu_stop(cpu);
     return 0;
-}
\ No newline at end of file
+}
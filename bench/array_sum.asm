@@ -0,0 +1,18 @@
+MOVC R1,#0
+MOVC R2,#100
+MOVC R3,#1
+STORE R3,R1,#0
+ADDL R3,R3,#1
+ADDL R1,R1,#4
+SUBL R2,R2,#1
+BNZ #-16
+MOVC R1,#0
+MOVC R2,#100
+MOVC R4,#0
+LOAD R5,R1,#0
+ADD R4,R4,R5
+ADDL R1,R1,#4
+SUBL R2,R2,#1
+BNZ #-16
+STORE R4,R1,#0
+HALT
@@ -0,0 +1,21 @@
+MOVC R1,#0
+MOVC R2,#16
+STORE R2,R1,#0
+ADDL R1,R1,#4
+SUBL R2,R2,#1
+BNZ #-12
+MOVC R6,#15
+MOVC R1,#0
+MOVC R7,#15
+LOAD R3,R1,#0
+LOAD R4,R1,#4
+CMP R3,R4
+BNP #12
+STORE R4,R1,#0
+STORE R3,R1,#4
+ADDL R1,R1,#4
+SUBL R7,R7,#1
+BNZ #-32
+SUBL R6,R6,#1
+BNZ #-48
+HALT
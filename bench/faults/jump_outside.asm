@@ -0,0 +1,3 @@
+MOVC R0,#1
+JUMP R0,#0
+HALT
@@ -0,0 +1,2 @@
+MOVC R0,#1
+ADD R1,R0,R0
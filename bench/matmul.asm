@@ -0,0 +1,39 @@
+MOVC R1,#0
+MOVC R2,#16
+MOVC R3,#1
+STORE R3,R1,#0
+ADDL R4,R3,#1
+STORE R4,R1,#256
+ADDL R3,R3,#1
+ADDL R1,R1,#4
+SUBL R2,R2,#1
+BNZ #-24
+MOVC R14,#4
+MOVC R5,#0
+MOVC R10,#512
+MOVC R11,#4
+MOVC R6,#256
+MOVC R12,#4
+MOVC R9,#0
+ADDL R7,R5,#0
+ADDL R8,R6,#0
+MOVC R13,#4
+LOAD R1,R7,#0
+LOAD R2,R8,#0
+MUL R3,R1,R2
+ADD R9,R9,R3
+ADDL R7,R7,#4
+ADDL R8,R8,#16
+SUBL R13,R13,#1
+BNZ #-28
+STORE R9,R10,#0
+ADDL R10,R10,#4
+ADDL R6,R6,#4
+SUBL R12,R12,#1
+BNZ #-64
+ADDL R5,R5,#16
+SUBL R11,R11,#1
+BNZ #-84
+SUBL R14,R14,#1
+BNZ #-104
+HALT
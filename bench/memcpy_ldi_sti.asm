@@ -0,0 +1,16 @@
+MOVC R1,#0
+MOVC R2,#64
+MOVC R3,#3
+STORE R3,R1,#0
+ADDL R3,R3,#3
+ADDL R1,R1,#4
+SUBL R2,R2,#1
+BNZ #-16
+MOVC R1,#0
+MOVC R2,#1024
+MOVC R3,#64
+LDI R4,R1,#0
+STI R4,R2,#0
+SUBL R3,R3,#1
+BNZ #-12
+HALT
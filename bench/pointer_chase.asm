@@ -0,0 +1,17 @@
+MOVC R1,#0
+MOVC R2,#256
+MOVC R5,#1023
+ADDL R3,R1,#68
+AND R3,R3,R5
+STORE R3,R1,#0
+ADDL R1,R1,#4
+SUBL R2,R2,#1
+BNZ #-20
+MOVC R1,#0
+MOVC R2,#512
+LOAD R1,R1,#0
+SUBL R2,R2,#1
+BNZ #-8
+MOVC R4,#2048
+STORE R1,R4,#0
+HALT
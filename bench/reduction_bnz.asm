@@ -0,0 +1,8 @@
+MOVC R1,#1000
+MOVC R2,#0
+ADD R2,R2,R1
+SUBL R1,R1,#1
+BNZ #-8
+MOVC R3,#0
+STORE R2,R3,#0
+HALT
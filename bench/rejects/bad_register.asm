@@ -0,0 +1,3 @@
+MOVC R0,#1
+ADD R20,R0,R0
+HALT
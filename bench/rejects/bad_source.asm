@@ -0,0 +1,3 @@
+MOVC R0,#1
+STORE R0,R99,#0
+HALT
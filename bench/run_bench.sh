@@ -0,0 +1,129 @@
+#!/bin/bash
+#
+# run_bench.sh
+# Runs every kernel on Part_A and Part_B, checks the simulated cycle and
+# instruction counts against expected.txt and reports CPI and host-side
+# simulation speed, then checks that the programs in faults/ stop with a
+# fetch fault and those in rejects/ fail to load, instead of crashing, and
+# that apex_batch reports such jobs in their rows of a batch, and that runs
+# with caches resume from a checkpoint exactly
+#
+# Usage: run_bench.sh [<repeat>]   (runs each kernel <repeat> times for timing)
+
+cd "$(dirname "$0")"
+
+REPEAT=${1:-20}
+LIMIT=100000
+status=0
+
+printf "%-16s %-4s %9s %9s %6s %10s %14s\n" kernel part cycles insns CPI expected "Mcycles/sec"
+for asm in *.asm; do
+    kernel=${asm%.asm}
+    for part in A B; do
+        sim=../Part_$part/apex_sim
+
+        line=$($sim $asm quiet $LIMIT 2>/dev/null | grep "Simulation Complete")
+        cycles=$(echo "$line" | sed 's/.*cycles = \([0-9]*\).*/\1/')
+        insns=$(echo "$line" | sed 's/.*instructions = \([0-9]*\).*/\1/')
+
+        # A run that reaches the cycle limit never retired HALT
+        if [ "$cycles" = "$LIMIT" ]; then
+            cycles=-
+            insns=-
+            cpi=-
+        else
+            cpi=$(awk -v c=$cycles -v i=$insns 'BEGIN { printf "%.3f", c / i }')
+        fi
+
+        expected=$(awk -v k=$kernel -v p=$part '$1 == k && $2 == p { print $3, $4 }' expected.txt)
+        if [ "$expected" = "$cycles $insns" ]; then
+            result=ok
+        else
+            result="FAIL($expected)"
+            status=1
+        fi
+
+        start=$(date +%s%N)
+        for ((r = 0; r < REPEAT; r++)); do
+            $sim $asm quiet $LIMIT >/dev/null 2>&1
+        done
+        end=$(date +%s%N)
+
+        total=${cycles/-/$LIMIT}
+        speed=$(awk -v c=$total -v n=$REPEAT -v t=$((end - start)) \
+                'BEGIN { printf "%.2f", c * n / (t / 1000.0) }')
+
+        printf "%-16s %-4s %9s %9s %6s %10s %14s\n" $kernel $part $cycles $insns $cpi "$result" $speed
+    done
+done
+
+# Fetching outside code memory must stop the run cleanly
+for asm in faults/*.asm; do
+    for part in A B; do
+        sim=../Part_$part/apex_sim
+        if $sim $asm quiet $LIMIT 2>/dev/null | grep -q "Stopped by a fetch fault"; then
+            result=ok
+        else
+            result=FAIL
+            status=1
+        fi
+        printf "%-16s %-4s %9s\n" $(basename $asm .asm) $part "fault $result"
+    done
+done
+
+# A listing naming a register past R15 must be refused at load
+for asm in rejects/*.asm; do
+    for part in A B; do
+        sim=../Part_$part/apex_sim
+        $sim $asm quiet $LIMIT >/dev/null 2>&1
+        if [ $? -eq 1 ]; then
+            result=ok
+        else
+            result=FAIL
+            status=1
+        fi
+        printf "%-16s %-4s %9s\n" $(basename $asm .asm) $part "reject $result"
+    done
+done
+
+# A run restored from a checkpoint must end as the run taken in one go,
+# with the I-cache and D-cache lines it was checkpointed with
+caches="--icache size=512,line=32,prefetch=next --dcache size=1024,assoc=4"
+ckpt=$(mktemp)
+for asm in *.asm; do
+    full=$(../Part_B/apex_sim $asm quiet $LIMIT $caches 2>/dev/null | grep -v -i restor)
+    ../Part_B/apex_sim $asm quiet $LIMIT $caches --checkpoint 500 $ckpt >/dev/null 2>&1
+    restored=$(../Part_B/apex_sim $asm quiet $LIMIT $caches --restore $ckpt 2>/dev/null | grep -v -i restor)
+    if [ -n "$full" ] && [ "$full" = "$restored" ]; then
+        result=ok
+    else
+        result=FAIL
+        status=1
+    fi
+    printf "%-16s %-4s %9s\n" ${asm%.asm} B "checkpoint $result"
+done
+rm -f $ckpt
+
+# A faulting or unloadable job must not stop the jobs around it
+statuses=$(../Part_B/apex_batch faults/batch.txt -j 2 2>/dev/null | awk -F, 'NR > 1 { printf "%s ", $5 }')
+if [ "$statuses" = "halted fault error halted " ]; then
+    result=ok
+else
+    result="FAIL($statuses)"
+    status=1
+fi
+printf "%-16s %-4s %9s\n" batch B "rows $result"
+
+# A manifest line too long to read whole must be refused, not split into jobs
+manifest=$(mktemp)
+printf 'array_sum.asm 100000%1100s\n' '' > $manifest
+if ../Part_B/apex_batch $manifest > /dev/null 2>&1; then
+    result=FAIL
+    status=1
+else
+    result=ok
+fi
+rm -f $manifest
+printf "%-16s %-4s %9s\n" batch B "long line $result"
+
+exit $status